@@ -0,0 +1,19 @@
+#!/bin/bash
+
+# Measures the simulation speed of worlds/benchmark_capture.wbt with the cameras rendering only the captured steps
+# ('window') and every step ('always'). The scene director quits after 60 simulated seconds and reports the
+# simulated seconds per wall-clock second.
+
+WEBOTS_PATH="/Applications/Webots.app/Contents/MacOS/webots"
+WORLDS_DIR="worlds"
+WORLD="benchmark_capture"
+
+for mode in "window" "always"; do
+  wbt="$WORLDS_DIR/${WORLD}_$mode.wbt"
+  sed "s|\"window\"|\"$mode\"|g" "$WORLDS_DIR/$WORLD.wbt" > "$wbt"
+
+  echo "=== Camera rendering: $mode ==="
+  "$WEBOTS_PATH" --batch --mode=fast --no-rendering --minimize --stdout "$wbt" | grep "simulated seconds per second"
+
+  rm -f "$wbt"
+done
@@ -0,0 +1,43 @@
+#!/bin/bash
+
+# Measures the end-to-end throughput of the capture pipeline on worlds/benchmark_pipeline.wbt: fixed seed, gesture
+# and camera resolution, 60 simulated seconds in batch mode. It runs once with the full frames encoded by Webots
+# ('webots') and once by the camera robots ('library'), selected through WEREF_ENCODER so that the tracked world is
+# left untouched. Each controller appends its time per stage to a profile file, and the script prints the saved frames
+# and simulated seconds per wall-clock second, and the share of each stage for the scene director and the camera
+# robots. The profiles are kept in benchmark_results/.
+
+WEBOTS_PATH="/Applications/Webots.app/Contents/MacOS/webots"
+WORLDS_DIR="worlds"
+WORLD="benchmark_pipeline"
+RESULTS_DIR="benchmark_results"
+IMAGES_DIR="controllers/nao_soccer_player/benchmark_images"
+
+summarize() {
+  awk -F'\t' '
+    NR == 1 { for (i = 6; i <= NF; i++) stage[i] = $i; last = NF; next }
+    $1 == "scene_director" { simulated = $3; wall = $4; for (i = 6; i <= NF; i++) director[i] = $i; next }
+    { camera_wall += $4; frames += $5; for (i = 6; i <= NF; i++) camera[i] += $i }
+    END {
+      if (wall <= 0 || camera_wall <= 0) { print "No profile of the scene director and the camera robots."; exit 1 }
+      printf "%d frames in %.2f s: %.2f frames per second, %.2f simulated seconds per second\n", frames, wall,
+             frames / wall, simulated / wall
+      printf "  %-11s %9s %9s\n", "stage", "director", "cameras"
+      for (i = 6; i <= last; i++)
+        printf "  %-11s %8.1f%% %8.1f%%\n", stage[i], 100 * director[i] / wall, 100 * camera[i] / camera_wall
+    }' "$1"
+}
+
+mkdir -p "$RESULTS_DIR"
+for encoder in "webots" "library"; do
+  profile="$RESULTS_DIR/${WORLD}_$encoder.tsv"
+  printf "controller\trobot\tsimulated\twall\tframes\tstep\tsupervisor\tcapture\tencode\twrite\tsave_image\n" > "$profile"
+  rm -rf "$IMAGES_DIR"
+
+  echo "=== Full frame encoder: $encoder ==="
+  WEREF_ENCODER="$encoder" WEREF_PROFILE="$PWD/$profile" "$WEBOTS_PATH" --batch --mode=fast --no-rendering --minimize \
+    --stdout "$WORLDS_DIR/$WORLD.wbt" > /dev/null
+  summarize "$profile"
+
+  rm -rf "$IMAGES_DIR"
+done
@@ -18,6 +18,8 @@
  #include <webots/robot.h>
  #include <webots/skin.h>
  #include <webots/supervisor.h>
+ #include <weref/referee_pose.h>
+ #include <weref/trace.h>
  
  #include <math.h>
  #include <stdio.h>
@@ -38,6 +40,20 @@
    printf("  -l: loop motion without resetting to initial position.\n");
  }
  
+ // Converts a position relative to the Skin node to world coordinates, with the 4x4 world pose of the Skin node.
+ static void skin_to_world(const double *skin_pose, const double *position, double *world) {
+   int i;
+   for (i = 0; i < 3; ++i)
+     world[i] = skin_pose[4 * i] * position[0] + skin_pose[4 * i + 1] * position[1] +
+                skin_pose[4 * i + 2] * position[2] + skin_pose[4 * i + 3];
+ }
+ 
+ // wb_robot_step(), traced as a whole: the simulation, the rendering and the other controllers.
+ static int robot_step(int duration) {
+   WEREF_TRACE_SCOPE("wb_robot_step");
+   return wb_robot_step(duration);
+ }
+ 
  int main(int argc, char **argv) {
    wb_robot_init();
  
@@ -82,6 +98,9 @@
      return 1;
    }
  
+   // hot-path trace of the run, when built with WEREF_TRACE_ENABLED
+   WEREF_TRACE_START(getenv("WEREF_TRACE"), "bvh_animation", wb_robot_get_name());
+ 
    WbDeviceTag skin = wb_robot_get_device(skin_device_name);
  
    // Open a BVH animation file.
@@ -175,27 +194,65 @@
    } else
      end_frame_index = bvh_frame_count;
  
-   while (wb_robot_step(TIME_STEP) != -1) {
-     for (i = 0; i < skin_bone_count; ++i) {
-       if (index_skin_to_bvh[i] < 0)
-         continue;
+   // The world pose of the Skin node converts the bone and keypoint positions to world coordinates.
+   WbNodeRef skin_node = wb_supervisor_node_get_from_device(skin);
+   static WerefRefereePose pose;
+   pose.frame = -1;
+   pose.bone_count = skin_bone_count < WEREF_REFEREE_MAX_BONES ? skin_bone_count : WEREF_REFEREE_MAX_BONES;
+   // The keypoints are the BVH joints animating a Skin bone, published as their bone index: their positions are the
+   // ones of the displayed skin, which follow its T pose and proportions.
+   pose.keypoint_count = 0;
+   for (i = 0; i < pose.bone_count && pose.keypoint_count < WEREF_REFEREE_MAX_KEYPOINTS; ++i) {
+     if (index_skin_to_bvh[i] < 0)
+       continue;
+     pose.keypoint_bones[pose.keypoint_count] = i;
+     snprintf(pose.keypoint_names[pose.keypoint_count++], WEREF_KEYPOINT_NAME_LENGTH, "%s",
+              wbu_bvh_get_joint_name(bvh_motion, index_skin_to_bvh[i]));
+   }
+   static char pose_data[WEREF_REFEREE_POSE_MAX_LENGTH];
  
-       // Get joint rotation for each joint.
-       // Note that we need to pass the joint index according to BVH file.
-       const double *orientation = wbu_bvh_get_joint_rotation(bvh_motion, index_skin_to_bvh[i]);
-       wb_skin_set_bone_orientation(skin, i, orientation, false);
+   while (robot_step(TIME_STEP) != -1) {
+     WEREF_TRACE_SCOPE("animation_step");
+     // Publish the displayed frame with its bone positions and keypoint bones in customData: the scene director logs
+     // the frame to check its replays and the camera robots project the bones to label the referee's bounding box and
+     // the keypoints to label its skeleton. The pose set before the step is the one displayed now.
+     {
+       WEREF_TRACE_SCOPE("publish_referee_pose");
+       const double *skin_pose = skin_node ? wb_supervisor_node_get_pose(skin_node, NULL) : NULL;
+       for (i = 0; i < pose.bone_count && skin_pose; ++i)
+         skin_to_world(skin_pose, wb_skin_get_bone_position(skin, i, true), pose.bones[i]);
+       if (!skin_pose)
+         pose.bone_count = pose.keypoint_count = 0;
+       if (weref_referee_pose_encode(&pose, pose_data, sizeof(pose_data)))
+         wb_robot_set_custom_data(pose_data);
      }
  
-     // Offset the position by a desired value if needed.
      const double *root_position;
-     if (root_bone_index >= 0) {
-       root_position = wbu_bvh_get_root_translation(bvh_motion);
-       double position[3];
-       for (i = 0; i < 3; ++i)
-         position[i] = root_position[i] + root_position_offset[i];
-       wb_skin_set_bone_position(skin, root_bone_index, position, false);
+     {
+       WEREF_TRACE_SCOPE("update_skin");
+       for (i = 0; i < skin_bone_count; ++i) {
+         if (index_skin_to_bvh[i] < 0)
+           continue;
+ 
+         // Get joint rotation for each joint.
+         // Note that we need to pass the joint index according to BVH file.
+         const double *orientation = wbu_bvh_get_joint_rotation(bvh_motion, index_skin_to_bvh[i]);
+         wb_skin_set_bone_orientation(skin, i, orientation, false);
+       }
+ 
+       // Offset the position by a desired value if needed.
+       if (root_bone_index >= 0) {
+         root_position = wbu_bvh_get_root_translation(bvh_motion);
+         double position[3];
+         for (i = 0; i < 3; ++i)
+           position[i] = root_position[i] + root_position_offset[i];
+         wb_skin_set_bone_position(skin, root_bone_index, position, false);
+       }
      }
  
+     // frame displayed during the next step, published with its bones and keypoints after it
+     pose.frame = wbu_bvh_get_frame_index(bvh_motion);
+ 
      // Fetch the next animation frame.
      // The simulation update rate is lower than the BVH frame rate, so 4 BVH motion frames are fetched.
      const int current_frame_index = wbu_bvh_get_frame_index(bvh_motion);
@@ -219,6 +276,8 @@
      }
    }
  
+   WEREF_TRACE_STOP();
+ 
    // Cleanup
    for (i = 0; i < skin_bone_count; ++i)
      free(joint_name_list[i]);
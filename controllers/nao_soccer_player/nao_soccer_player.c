@@ -1,16 +1,25 @@
 #include <assert.h>
 #include <dirent.h>
-#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>
+#include <unistd.h>
 #include <webots/camera.h>
 #include <webots/led.h>
 #include <webots/motor.h>
 #include <webots/robot.h>
 #include <webots/supervisor.h>
 #include <webots/utils/motion.h>
+#include <weref/completion_manifest.h>
+#include <weref/dataset_writer.h>
+#include <weref/frame_ring.h>
+#include <weref/label_manifest.h>
+#include <weref/metrics.h>
+#include <weref/referee_pose.h>
+#include <weref/roi_crop.h>
+#include <weref/scene_message.h>
+#include <weref/stage_profile.h>
+#include <weref/trace.h>
 
 #ifdef _MSC_VER
 #define snprintf sprintf_s
@@ -19,811 +28,858 @@
 // --- Global Variables ---
 static int time_step = -1;
 static int frame_count = 0;
-static const char *gesture = "";
-static const char *clothName = "Cloth2";
-static int obstacle_flag = -1; // -1: unknown, 0: absent, 1: present
+
+// Dataset output
+static WerefOutputMode output_mode = WEREF_OUTPUT_TREE;
+static const char *output_root = "images";
+static long shard_size = 256L * 1024 * 1024;
+static WerefDatasetWriter dataset_writer = NULL;
+
+// Shared-memory output (-o ring): frames go to a local consumer instead of the disk
+#define RING_WAIT_TIMEOUT_MS 1000
+static bool ring_output = false;
+static int ring_slot_count = 16;
+static WerefFrameRing frame_ring = NULL;
+static bool ring_stalled = false;  // a write timed out: the next ones don't wait until a slot is free again
+
+// Label manifest: one record per saved frame, written in batches
+#define MANIFEST_FLUSH_INTERVAL 64
+static WerefLabelManifest label_manifest = NULL;
+static int sample_index = -1;  // index of the current randomized scene
+static int sample_frame = 0;   // frames saved since the last randomization
+
+// Completion manifest of the collection (-M): progress of the cells of this camera robot, one per presence of the
+// obstacle robot (indexed by its flag + 1), recorded per sample
+static const char *completion_path = NULL;
+static WerefCompletionRecord completions[3];
+static int sample_presence = -1;    // obstacle flag of the current sample
+static int full_sample_frames = 0;  // frames of the complete samples, a last sample with less is not counted
+
+// Cameras saved on each captured step, selected with -c
+#define CAPTURE_TOP 1
+#define CAPTURE_BOTTOM 2
+static int capture_cameras = CAPTURE_TOP;
+// Whether the cameras render every step, or only for the steps the scene director captures
+static bool always_render = false;
+static bool cameras_enabled = false;
+
+// Images saved per frame, selected with -O: the full frame and/or a fixed-size crop around the referee
+#define OUTPUT_FULL 1
+#define OUTPUT_CROP 2
+#define CROP_QUALITY 90
+static int image_outputs = OUTPUT_FULL;
+static int crop_size = 0;           // side of the crops [pixels], 0 for the smaller side of the camera image
+static double crop_padding = 0.2;   // margin around the referee's bounding box, relative to its largest side
+static unsigned char *crop_buffer = NULL;
+static int crop_buffer_size = 0;
+
+// Encoding of the full frames, selected with -E: by Webots in wb_camera_save_image(), or by the controller like the
+// crops, so that the capture, the encoding and the write are timed apart
+#define FULL_QUALITY 100
+static bool library_encoder = false;
+static unsigned char *frame_buffer = NULL;  // RGB full frame
+static int frame_buffer_size = 0;
+static WerefEncodedImage encoded_image;
+
+// Wall-clock time per pipeline stage, printed at the end of the run and appended to the profile results file (-p)
+static WerefStageProfile profile;
+static const char *profile_path = NULL;
+static double stage_start = 0.0;  // clock at the end of the previous stage
+
+// Live metrics of the run, rewritten every METRICS_INTERVAL wall-clock seconds in the metrics directory (-x), and
+// per-frame logs (-v)
+#define METRICS_INTERVAL 5.0  // [s]
+static WerefMetrics metrics = NULL;
+static int metric_frames, metric_dropped, metric_queue_depth, metric_bytes, metric_step_time, metric_simulated_time,
+  metric_sample;
+static double metrics_clock = 0.0;  // clock of the previous metrics update
+static int metrics_sample = -1;     // sample of the cell labels of 'metric_sample'
+static bool verbose = false;
+
+// Referee bounding box, projected from the bones the referee publishes in its customData field
+#define REFEREE_BONE_RADIUS 0.08  // body radius around a bone [m]
+static WbFieldRef referee_custom_data = NULL;
+static WerefRefereePose referee_pose;
+static double referee_pose_time = -1.0;  // time of the step 'referee_pose' was read at
+static bool store_keypoints = false;     // whether the referee keypoints are stored next to each image
 
 // Webots Devices & Motion References
 static WbDeviceTag CameraTop, CameraBottom;
 static WbMotionRef currently_playing = NULL;
 
-// Linked list structure for storing loaded motions
+// Motion registry: the .motion files of the motion directory, hashed by name and loaded on first use
+#define MOTION_DIR "../../motions"
+#define MOTION_BUCKET_COUNT 64
 struct Motion {
   char *name;
-  WbMotionRef ref;
+  WbMotionRef ref;  // NULL until the motion is first started
+  bool loaded;      // whether loading was attempted, to report a failed load only once
   struct Motion *next;
-} *motion_list = NULL;
+} *motion_buckets[MOTION_BUCKET_COUNT];
 
 // --- Function Implementations ---
 
 /**
- * @brief Saves the current camera frame to a structured directory.
+ * @brief Accounts the time since the end of the previous stage to 'stage'.
  */
-static void store_frame_image(WbDeviceTag camera, int frame_index,
-                              const char *gesture_name,
-                              const char *referee_model,
-                              const char *cloth_name,
-                              const char *background,
-                              int obstacleFlag,
-                              const char *angle_position) {
-  const char *presence_label;
-  if (obstacleFlag == 1)
-    presence_label = "presence_robot";
-  else if (obstacleFlag == 0)
-    presence_label = "presence_norobot";
-  else
-    presence_label = "presence_unknown";
-
-  char dir_path[512];
-  snprintf(dir_path, sizeof(dir_path),
-           "images/%s/%s_%s/%s/%s/%s",
-           gesture_name, referee_model, cloth_name,
-           background, presence_label, angle_position);
-
-  char mk_command[1024];
-  snprintf(mk_command, sizeof(mk_command), "mkdir -p \"%s\"", dir_path);
-  system(mk_command);
-
-  char file_path[512];
-  snprintf(file_path, sizeof(file_path), "%s/frame_%d.jpg", dir_path, frame_index);
-
-  printf("Saving image to: %s\n", file_path);
-  wb_camera_save_image(camera, file_path, 100);
+static void end_stage(WerefStage stage) {
+  stage_start = weref_stage_add(&profile, stage, stage_start);
 }
 
-// ----------------------------------------------------------
-// Camera / Motion Management
-// ----------------------------------------------------------
-
 /**
- * @brief Gets device tags for cameras and enables them.
+ * @brief wb_robot_step(), traced as a whole: the simulation, the rendering and the other controllers.
  */
-static void enable_cameras() {
-  CameraTop = wb_robot_get_device("CameraTop");
-  CameraBottom = wb_robot_get_device("CameraBottom");
-  wb_camera_enable(CameraTop, time_step);
-  wb_camera_enable(CameraBottom, time_step);
+static int robot_step() {
+  WEREF_TRACE_SCOPE("wb_robot_step");
+  return wb_robot_step(time_step);
 }
 
 /**
- * @brief Loads all .motion files from the "../../motions" directory into a linked list.
+ * @brief Finds the customData field of the referee, the robot running the 'bvh_animation' controller.
  */
-static void load_motion_list() {
-  const char *motion_dir = "../../motions";
-  DIR *d = opendir(motion_dir);
-  if (d) {
-    const struct dirent *dir;
-    struct Motion *current_motion = NULL;
-    while ((dir = readdir(d)) != NULL) {
-      const char *name = dir->d_name;
-      if (name[0] != '.') {
-        struct Motion *new_motion = (struct Motion *)malloc(sizeof(struct Motion));
-        if (current_motion == NULL)
-          motion_list = new_motion;
-        else
-          current_motion->next = new_motion;
-        current_motion = new_motion;
-        current_motion->name = (char *)malloc(strlen(name) + 1);
-        strcpy(current_motion->name, name);
-        for (int i = 0; current_motion->name[i]; i++) {
-          if (current_motion->name[i] == '.') {
-            current_motion->name[i] = '\0';
-            break;
-          }
-        }
-        char filename[256];
-        snprintf(filename, sizeof(filename), "%s/%s.motion", motion_dir, current_motion->name);
-        current_motion->ref = wbu_motion_new(filename);
-        current_motion->next = NULL;
-      }
-    }
-    closedir(d);
-  } else {
-       perror("Could not open motion directory");
+static WbFieldRef find_referee_custom_data() {
+  WbFieldRef children = wb_supervisor_node_get_field(wb_supervisor_node_get_root(), "children");
+  const int count = wb_supervisor_field_get_count(children);
+  for (int i = 0; i < count; i++) {
+    WbNodeRef node = wb_supervisor_field_get_mf_node(children, i);
+    WbFieldRef controller = wb_supervisor_node_get_field(node, "controller");
+    if (controller && strcmp(wb_supervisor_field_get_sf_string(controller), "bvh_animation") == 0)
+      return wb_supervisor_node_get_field(node, "customData");
   }
+  fprintf(stderr, "Warning: Could not find the referee, frames are labeled without its bounding box.\n");
+  return NULL;
 }
 
 /**
- * @brief Frees the memory allocated for the motion list.
+ * @brief Labels the bounding box of the referee in the current frame of a camera, by projecting the bones of the
+ * referee into it. The pose of the referee is read once per step.
  */
-static void free_motion_list() {
-  while (motion_list) {
-    free(motion_list->name);
-    struct Motion *next = motion_list->next;
-    free(motion_list);
-    motion_list = next;
+static void label_referee_box(WbDeviceTag camera, WerefBoundingBox *box) {
+  if (referee_pose_time != wb_robot_get_time()) {
+    referee_pose_time = wb_robot_get_time();
+    if (!referee_custom_data ||
+        !weref_referee_pose_decode(wb_supervisor_field_get_sf_string(referee_custom_data), &referee_pose))
+      referee_pose.bone_count = 0;
   }
-}
-
-/**
- * @brief Finds a loaded motion by its name.
- * @param name The name of the motion (without extension).
- * @return WbMotionRef if found, NULL otherwise.
- */
-static WbMotionRef find_motion(const char *name) {
-  struct Motion *motion = motion_list;
-  while (motion) {
-    if (strcmp(motion->name, name) == 0)
-      return motion->ref;
-    motion = motion->next;
+  WbNodeRef camera_node = referee_pose.bone_count > 0 ? wb_supervisor_node_get_from_device(camera) : NULL;
+  if (!camera_node) {
+    memset(box, 0, sizeof(*box));
+    box->visible = -1;
+    return;
   }
-  fprintf(stderr, "Motion not found: %s\n", name);
-  return NULL;
+  weref_referee_pose_project(&referee_pose, wb_supervisor_node_get_pose(camera_node, NULL), wb_camera_get_fov(camera),
+                             wb_camera_get_width(camera), wb_camera_get_height(camera), REFEREE_BONE_RADIUS, box);
 }
 
 /**
- * @brief Starts playing a motion by name, stopping any currently playing motion.
- * @param name The name of the motion to play.
+ * @brief Writes the 3D and 2D keypoints of the referee in the current frame of a camera next to its image, as
+ * '<key>.keypoints.json': for each BVH joint, its world and camera frame positions [m], its pixel coordinates and
+ * whether it projects inside the image. Occlusions are not taken into account.
  */
-static void start_motion(const char *name) {
-  WbMotionRef motion = find_motion(name);
-  if (currently_playing)
-    wbu_motion_stop(currently_playing);
+static void store_referee_keypoints(WbDeviceTag camera, const char *key) {
+  WbNodeRef camera_node = referee_pose.keypoint_count > 0 ? wb_supervisor_node_get_from_device(camera) : NULL;
+  if (!camera_node)
+    return;
+  const double *camera_pose = wb_supervisor_node_get_pose(camera_node, NULL);
+  const double fov = wb_camera_get_fov(camera);
+  const int width = wb_camera_get_width(camera);
+  const int height = wb_camera_get_height(camera);
 
-  wbu_motion_play(motion);
-  currently_playing = motion;
+  const char *file_path = weref_dataset_writer_begin(dataset_writer, key, ".keypoints.json");
+  if (!file_path)
+    return;
+  FILE *file = fopen(file_path, "w");
+  if (!file) {
+    fprintf(stderr, "Error: could not create '%s'.\n", file_path);
+    return;
+  }
+  fprintf(file, "{\"frame\": %d, \"width\": %d, \"height\": %d, \"keypoints\": [", referee_pose.frame, width, height);
+  for (int i = 0; i < referee_pose.keypoint_count; i++) {
+    const double *world = referee_pose.bones[referee_pose.keypoint_bones[i]];
+    double camera_point[3], pixel[2];
+    const bool in_image = weref_project_point(camera_pose, fov, width, height, world, camera_point, pixel);
+    fprintf(file,
+            "%s\n  {\"name\": \"%s\", \"world\": [%.4f, %.4f, %.4f], \"camera\": [%.4f, %.4f, %.4f], "
+            "\"image\": [%.1f, %.1f], \"in_image\": %d}",
+            i > 0 ? "," : "", referee_pose.keypoint_names[i], world[0], world[1], world[2], camera_point[0],
+            camera_point[1], camera_point[2], pixel[0], pixel[1], in_image ? 1 : 0);
+  }
+  fprintf(file, "\n]}\n");
+  fclose(file);
+  weref_dataset_writer_commit(dataset_writer);
 }
 
-// ----------------------------------------------------------
-// Randomization Helpers
-// ----------------------------------------------------------
-
 /**
- * @brief Generates a random double within a specified range.
+ * @brief Copies the current camera frame and its label record into the next slot of the frame ring. The frame is
+ * dropped if the consumer does not release a slot in time, and the following ones are dropped without waiting until
+ * it releases one, so a stalled consumer can't stall the simulation on every frame.
  */
-static double rand_in_range(double min, double max) {
-  return min + (max - min) * ((double)rand() / RAND_MAX);
+static bool publish_frame(WbDeviceTag camera, const WerefLabelRecord *record) {
+  WEREF_TRACE_SCOPE("publish_frame");
+  const unsigned char *image = wb_camera_get_image(camera);
+  const int width = wb_camera_get_width(camera);
+  const int height = wb_camera_get_height(camera);
+  const size_t size = (size_t)width * height * 4;
+  if (!image || size > weref_frame_ring_get_max_frame_size(frame_ring))
+    return false;
+
+  WerefFrameHeader *frame = weref_frame_ring_begin_write(frame_ring, ring_stalled ? 0 : RING_WAIT_TIMEOUT_MS);
+  if (!frame) {
+    fprintf(stderr, "Warning: frame ring full, dropped %s (%lld frames dropped).\n", record->key,
+            weref_frame_ring_get_dropped_count(frame_ring));
+    ring_stalled = true;
+    return false;
+  }
+  ring_stalled = false;
+  frame->label = *record;
+  frame->width = width;
+  frame->height = height;
+  frame->size = (uint32_t)size;
+  memcpy(weref_frame_ring_data(frame), image, size);
+  weref_frame_ring_end_write(frame_ring);
+  return true;
 }
 
 /**
- * @brief Checks if point (x, y) is within half-circle C1.
+ * @brief Saves the current camera frame as '<key>.jpg' (or '.ppm' when the library is built without libjpeg),
+ * encoded by the controller (-E library).
  */
-static int in_C1(double x, double y) {
-  double dx = x - 3.0;
-  double dist2 = dx * dx + y * y;
-  return (dist2 <= 3.8 * 3.8) && (x <= 3.0);
+static bool store_full_frame(WbDeviceTag camera, const char *key) {
+  WEREF_TRACE_SCOPE("store_full_frame");
+  const unsigned char *image = wb_camera_get_image(camera);
+  const int width = wb_camera_get_width(camera);
+  const int height = wb_camera_get_height(camera);
+  if (!image)
+    return false;
+  if (3 * width * height > frame_buffer_size) {
+    frame_buffer_size = 3 * width * height;
+    frame_buffer = (unsigned char *)realloc(frame_buffer, frame_buffer_size);
+  }
+  weref_image_bgra_to_rgb(image, width, height, frame_buffer);
+  end_stage(WEREF_STAGE_CAPTURE);
+  const bool encoded = weref_image_encode(frame_buffer, width, height, FULL_QUALITY, &encoded_image);
+  end_stage(WEREF_STAGE_ENCODE);
+  if (!encoded)
+    return false;
+
+  const char *file_path = weref_dataset_writer_begin(dataset_writer, key, weref_image_extension());
+  if (!file_path)
+    return false;
+  if (verbose)
+    printf("Saving image to: %s\n", file_path);
+  const bool stored =
+    weref_encoded_image_write(file_path, &encoded_image) && weref_dataset_writer_commit(dataset_writer);
+  end_stage(WEREF_STAGE_WRITE);
+  return stored;
 }
 
 /**
- * @brief Checks if point (x, y) is within half-circle C2.
+ * @brief Saves the crop of the current camera frame around the referee as '<key>.crop.jpg', next to the full
+ * frame.
  */
-static int in_C2(double x, double y) {
-  double dx = x - 3.0;
-  double dist2 = dx * dx + y * y;
-  return (dist2 <= 2.2 * 2.2) && (x <= 3.0);
+static bool store_referee_crop(WbDeviceTag camera, const char *key, const WerefRoi *roi) {
+  WEREF_TRACE_SCOPE("store_referee_crop");
+  const unsigned char *image = wb_camera_get_image(camera);
+  if (!image || roi->size <= 0.0)
+    return false;
+  const int width = wb_camera_get_width(camera);
+  const int height = wb_camera_get_height(camera);
+  // a crop larger than the camera image would only be upsampled
+  const int size = crop_size > 0 ? crop_size : (width < height ? width : height);
+  if (3 * size * size > crop_buffer_size) {
+    crop_buffer_size = 3 * size * size;
+    crop_buffer = (unsigned char *)realloc(crop_buffer, crop_buffer_size);
+  }
+  weref_roi_crop(image, width, height, roi, size, crop_buffer);
+  end_stage(WEREF_STAGE_CAPTURE);
+  const bool encoded = weref_image_encode(crop_buffer, size, size, CROP_QUALITY, &encoded_image);
+  end_stage(WEREF_STAGE_ENCODE);
+  if (!encoded)
+    return false;
+
+  char extension[16];
+  snprintf(extension, sizeof(extension), ".crop%s", weref_image_extension());
+  const char *file_path = weref_dataset_writer_begin(dataset_writer, key, extension);
+  const bool stored = file_path && weref_encoded_image_write(file_path, &encoded_image) &&
+                      weref_dataset_writer_commit(dataset_writer);
+  end_stage(WEREF_STAGE_WRITE);
+  return stored;
 }
 
 /**
- * @brief Checks if point (x, y) is within circle C3.
+ * @brief Label of the presence of the obstacle robot in the dataset tree.
  */
-static int in_C3(double x, double y) {
-  double dist2 = x * x + y * y;
-  return (dist2 <= 0.8 * 0.8);
+static const char *presence_name(int obstacle_flag) {
+  if (obstacle_flag == 1)
+    return "presence_robot";
+  if (obstacle_flag == 0)
+    return "presence_norobot";
+  return "presence_unknown";
 }
 
 /**
- * @brief Calculates a random position for NAO RED 2.
+ * @brief Saves the current camera frame under its label path, either in the directory tree, in a shard or in the
+ * frame ring. With -O the full frame, a crop around the referee or both are saved, the label record keeps the full
+ * frame bounding box and the cropped region. Frames without a visible referee have no crop.
+ *
+ * CameraTop frames keep the historical label path, CameraBottom frames are stored next to them under a '_bottom'
+ * position label.
+ * @param message The scene message of the scene director, holding the labels and the scene state of the frame.
  */
-static void random_position_red2(double *px, double *py) {
-  while (1) {
-    double x = rand_in_range(-0.8, 3.0);
-    double y = rand_in_range(0.0, 2.0);
-    if (in_C1(x, y) && !in_C2(x, y) && !in_C3(x, y)) {
-      *px = x;
-      *py = y;
-      return;
+static void store_frame_image(WbDeviceTag camera, int frame_index, const WerefSceneMessage *message) {
+  WEREF_TRACE_SCOPE("store_frame_image");
+  const char *presence_label = presence_name(message->scene.obstacle_flag);
+  const bool bottom = camera == CameraBottom;
+  WerefLabelRecord record;
+  char *key = record.key;
+  if (snprintf(key, sizeof(record.key), "%s/%s_%s/%s/%s/%s%s/frame_%d", message->gesture, message->referee_model,
+               message->cloth, message->background, presence_label, message->position, bottom ? "_bottom" : "",
+               frame_index) >= (int)sizeof(record.key)) {
+    fprintf(stderr, "Error: the key of frame %d is longer than %d characters, the frame is skipped.\n", frame_index,
+            WEREF_LABEL_KEY_LENGTH - 1);
+    return;
+  }
+  snprintf(record.camera, sizeof(record.camera), "%s", bottom ? "CameraBottom" : "CameraTop");
+  record.time = wb_robot_get_time();
+  record.step = (int)(record.time * 1000.0 / time_step + 0.5);
+  record.seed = message->seed;
+  record.sample = sample_index;
+  record.phase = sample_frame;
+  record.scene = message->scene;
+  label_referee_box(camera, &record.referee_box);
+  memset(&record.roi, 0, sizeof(record.roi));
+  end_stage(WEREF_STAGE_SUPERVISOR);
+
+  if (ring_output) {
+    if (publish_frame(camera, &record))
+      profile.frames++;
+    end_stage(WEREF_STAGE_CAPTURE);
+    return;
+  }
+
+  bool stored = false;
+  if ((image_outputs & OUTPUT_FULL) && library_encoder)
+    stored = store_full_frame(camera, key);
+  else if (image_outputs & OUTPUT_FULL) {
+    const char *file_path = weref_dataset_writer_begin(dataset_writer, key, ".jpg");
+    if (verbose && file_path)
+      printf("Saving image to: %s\n", file_path);
+    if (file_path) {
+      WEREF_TRACE_SCOPE("wb_camera_save_image");
+      wb_camera_save_image(camera, file_path, FULL_QUALITY);
     }
+    end_stage(WEREF_STAGE_SAVE_IMAGE);
+    stored = weref_dataset_writer_commit(dataset_writer);
+    end_stage(WEREF_STAGE_WRITE);
+  }
+  if (image_outputs & OUTPUT_CROP) {
+    weref_roi_from_box(&record.referee_box, crop_padding, &record.roi);
+    if (store_referee_crop(camera, key, &record.roi))
+      stored = true;
+    else
+      memset(&record.roi, 0, sizeof(record.roi));
   }
+  if (!stored)
+    return;
+  profile.frames++;
+  weref_label_manifest_append(label_manifest, &record);
+  if (store_keypoints)
+    store_referee_keypoints(camera, key);
+  end_stage(WEREF_STAGE_WRITE);
 }
 
 /**
- * @brief Calculates a random position for NAO BLUE 4.
+ * @brief Opens the dataset writer and the label manifest once the labels of the run are known, or the frame ring in
+ * ring mode. The ring is named after the same prefix, e.g. '/weref_<gesture>_<model>_<background>_<position>'.
  */
-static void random_position_blue4(double *px, double *py) {
-  while (1) {
-    double x = rand_in_range(-0.8, 3.0);
-    double y = rand_in_range(-2.0, 0.0);
-    if (in_C1(x, y) && !in_C2(x, y) && !in_C3(x, y)) {
-      *px = x;
-      *py = y;
-      return;
+static bool open_outputs(const WerefSceneMessage *message) {
+  char output_prefix[512];
+  snprintf(output_prefix, sizeof(output_prefix), "%s_%s_%s_%s", message->gesture, message->referee_model,
+           message->background, message->position);
+  if (ring_output) {
+    int max_frame_size = 0;
+    if (capture_cameras & CAPTURE_TOP)
+      max_frame_size = wb_camera_get_width(CameraTop) * wb_camera_get_height(CameraTop) * 4;
+    if (capture_cameras & CAPTURE_BOTTOM) {
+      const int bottom_size = wb_camera_get_width(CameraBottom) * wb_camera_get_height(CameraBottom) * 4;
+      if (bottom_size > max_frame_size)
+        max_frame_size = bottom_size;
     }
+    char ring_name[520];
+    snprintf(ring_name, sizeof(ring_name), "/weref_%s", output_prefix);
+    frame_ring = weref_frame_ring_create(ring_name, ring_slot_count, max_frame_size);
+    if (frame_ring)
+      printf("Publishing frames in the shared-memory ring %s (%d slots)\n", ring_name, ring_slot_count);
+    return frame_ring != NULL;
   }
+  dataset_writer = weref_dataset_writer_new(output_mode, output_root, output_prefix, shard_size);
+  if (!dataset_writer)
+    return false;
+
+  char manifest_path[1024];
+  snprintf(manifest_path, sizeof(manifest_path), "%s/%s.labels.csv", output_root, output_prefix);
+  label_manifest = weref_label_manifest_new(manifest_path, MANIFEST_FLUSH_INTERVAL);
+  if (!label_manifest) {
+    // frames without labels would still be counted as complete by the completion manifest
+    weref_dataset_writer_cleanup(dataset_writer);
+    dataset_writer = NULL;
+    return false;
+  }
+  return true;
 }
 
 /**
- * @brief Calculates a random position for NAO RED 3.
+ * @brief Appends the progress of the run to the completion manifest, after flushing the labels of its frames. Called
+ * when a sample ends, i.e. when the next one starts, for the cell of the sample, and once the run stops, for every
+ * cell of the run.
+ * @param finished Whether the run stopped cleanly, its last sample then counts if it has all its frames.
  */
-static void random_position_red3(double *px, double *py) {
-  while (1) {
-    double x = rand_in_range(-0.8, 0.8);
-    double y = rand_in_range(-0.8, 0.8);
-    if ((x * x + y * y) <= (0.8 * 0.8)) {
-      *px = x;
-      *py = y;
-      return;
+static void record_completion(const WerefSceneMessage *message, bool finished) {
+  WEREF_TRACE_SCOPE("record_completion");
+  if (!completion_path || !dataset_writer)
+    return;
+  WerefCompletionRecord *completion = &completions[sample_presence + 1];
+  if (sample_frame > 0) {
+    if (!finished || sample_frame >= full_sample_frames)
+      completion->samples++;
+    if (sample_frame > full_sample_frames)
+      full_sample_frames = sample_frame;
+    completion->frames += sample_frame;
+    snprintf(completion->gesture, sizeof(completion->gesture), "%s", message->gesture);
+    snprintf(completion->world, sizeof(completion->world), "%s_%s", message->referee_model, message->background);
+    snprintf(completion->cloth, sizeof(completion->cloth), "%s", message->cloth);
+    snprintf(completion->presence, sizeof(completion->presence), "%s", presence_name(sample_presence));
+    snprintf(completion->position, sizeof(completion->position), "%s", message->position);
+    completion->seed = message->seed;
+  }
+  weref_label_manifest_flush(label_manifest);
+  for (int i = 0; i < 3; i++) {
+    // the cells of the other presences only get their final record
+    if (completions[i].gesture[0] && (finished || (completion == &completions[i] && sample_frame > 0))) {
+      completions[i].finished = finished;
+      weref_completion_manifest_append(completion_path, &completions[i]);
     }
   }
 }
 
 /**
- * @brief Sets the robot's rotation field to face the point (3, 0).
+ * @brief Registers the metrics of the camera robot, written in 'directory'.
  */
-static void set_facing_3_0(WbFieldRef rotation_field, double x, double y) {
-  double dx = 3.0 - x;
-  double dy = 0.0 - y;
-  double angle = atan2(dy, dx);
-  double axis_z = (y > 0.0) ? -1.0 : 1.0;
-  angle = fabs(angle);
-  double rot[4] = {0.0, 0.0, axis_z, angle};
-  wb_supervisor_field_set_sf_rotation(rotation_field, rot);
+static void open_metrics(const char *directory) {
+  metrics = weref_metrics_new(directory, "nao_soccer_player", wb_robot_get_name(), METRICS_INTERVAL);
+  metric_frames = weref_metrics_register(metrics, WEREF_METRIC_COUNTER, "weref_frames_saved_total",
+                                         "Frames saved or published in the frame ring.");
+  metric_dropped = weref_metrics_register(metrics, WEREF_METRIC_COUNTER, "weref_frames_dropped_total",
+                                          "Frames dropped because the frame ring was full.");
+  metric_queue_depth = weref_metrics_register(metrics, WEREF_METRIC_GAUGE, "weref_queue_depth",
+                                              "Frames waiting in the frame ring, or label records not written yet.");
+  metric_bytes = weref_metrics_register(metrics, WEREF_METRIC_COUNTER, "weref_bytes_written_total",
+                                        "Bytes of the images and shards written by the dataset writer.");
+  metric_step_time = weref_metrics_register(metrics, WEREF_METRIC_SUMMARY, "weref_step_seconds",
+                                            "Wall-clock time of a controller step, wb_robot_step() included.");
+  metric_simulated_time = weref_metrics_register(metrics, WEREF_METRIC_GAUGE, "weref_simulated_seconds",
+                                                 "Simulated time.");
+  metric_sample = weref_metrics_register(metrics, WEREF_METRIC_GAUGE, "weref_sample",
+                                         "Index of the current sample, labelled with its dataset cell.");
+  weref_metrics_set(metrics, metric_sample, -1);
+  metrics_clock = weref_stage_clock();
 }
 
 /**
- * @brief Randomizes the position and visibility of the obstacle robot.
+ * @brief Updates the metrics after a step, and writes them once their interval elapsed.
  */
-static void randomize_obstacle_robot() {
-  int obstacle_visible = (rand() < (RAND_MAX / 2)) ? 0 : 1;
-  obstacle_flag = obstacle_visible;
-
-  WbNodeRef obstacle_node = wb_supervisor_node_get_from_def("OBSTACLE_ROBOT");
-  if (!obstacle_node) {
-    fprintf(stderr, "Warning: Could not find node with DEF OBSTACLE_ROBOT.\n");
+static void update_metrics(const WerefSceneMessage *message) {
+  if (!metrics)
     return;
+  const double now = weref_stage_clock();
+  weref_metrics_observe(metrics, metric_step_time, now - metrics_clock);
+  metrics_clock = now;
+  weref_metrics_set(metrics, metric_simulated_time, wb_robot_get_time());
+  weref_metrics_set(metrics, metric_frames, profile.frames);
+  if (frame_ring) {
+    weref_metrics_set(metrics, metric_dropped, weref_frame_ring_get_dropped_count(frame_ring));
+    weref_metrics_set(metrics, metric_queue_depth, weref_frame_ring_get_depth(frame_ring));
+  } else if (dataset_writer) {
+    weref_metrics_set(metrics, metric_bytes, weref_dataset_writer_get_bytes_written(dataset_writer));
+    weref_metrics_set(metrics, metric_queue_depth, weref_label_manifest_get_pending_count(label_manifest));
   }
-
-  WbFieldRef translation_field = wb_supervisor_node_get_field(obstacle_node, "translation");
-  WbFieldRef rotation_field    = wb_supervisor_node_get_field(obstacle_node, "rotation");
-  if (!translation_field || !rotation_field) {
-    fprintf(stderr, "Warning: Could not get translation/rotation for OBSTACLE_ROBOT.\n");
-    return;
+  if (message && message->sample != metrics_sample) {
+    metrics_sample = message->sample;
+    char world[256];
+    snprintf(world, sizeof(world), "%s_%s", message->referee_model, message->background);
+    const char *labels[] = {"gesture",  message->gesture, "world",    world,
+                            "cloth",    message->cloth,   "presence", presence_name(message->scene.obstacle_flag),
+                            "position", message->position};
+    weref_metrics_set_labels(metrics, metric_sample, labels, 5);
+    weref_metrics_set(metrics, metric_sample, message->sample);
   }
+  weref_metrics_update(metrics);
+}
 
-  if (!obstacle_visible) {
-    double no_obs_translation[3] = {-3.0, -4.0, 0.335};
-    wb_supervisor_field_set_sf_vec3f(translation_field, no_obs_translation);
-
-    double no_obs_rot[4] = {0.0, 0.0, 1.0, 0.0};
-    wb_supervisor_field_set_sf_rotation(rotation_field, no_obs_rot);
-  } else {
-    double x, y;
-    while (1) {
-      x = rand_in_range(0.8, 3.0);
-      y = rand_in_range(-2.2, 2.2);
-      if (in_C2(x, y))
-        break;
-    }
-    double obs_translation[3] = {x, y, 0.335};
-    wb_supervisor_field_set_sf_vec3f(translation_field, obs_translation);
+// ----------------------------------------------------------
+// Camera / Motion Management
+// ----------------------------------------------------------
 
-    double angle = rand_in_range(-3.14, 3.14);
-    double obs_rot[4] = {0.0, 0.0, 1.0, angle};
-    wb_supervisor_field_set_sf_rotation(rotation_field, obs_rot);
+/**
+ * @brief Enables or disables the cameras that are captured, the others are never rendered.
+ */
+static void set_cameras_enabled(bool enabled) {
+  if (enabled == cameras_enabled)
+    return;
+  WEREF_TRACE_SCOPE("set_cameras_enabled");
+  if (capture_cameras & CAPTURE_TOP) {
+    if (enabled)
+      wb_camera_enable(CameraTop, time_step);
+    else
+      wb_camera_disable(CameraTop);
+  }
+  if (capture_cameras & CAPTURE_BOTTOM) {
+    if (enabled)
+      wb_camera_enable(CameraBottom, time_step);
+    else
+      wb_camera_disable(CameraBottom);
   }
+  cameras_enabled = enabled;
 }
 
 /**
- * @brief Helper function to get the (x, y) translation of a node by its DEF name.
+ * @brief Gets device tags for cameras. They are enabled right away in 'always' render mode, otherwise when the scene
+ * director announces a captured step.
  */
-static int get_robot_xy(const char *def_name, double *out_x, double *out_y) {
-  WbNodeRef node = wb_supervisor_node_get_from_def(def_name);
-  if (!node) return 0;
-  WbFieldRef trans_field = wb_supervisor_node_get_field(node, "translation");
-  if (!trans_field) return 0;
-  const double *vals = wb_supervisor_field_get_sf_vec3f(trans_field);
-  if (!vals) return 0;
-  *out_x = vals[0];
-  *out_y = vals[1];
-  return 1;
+static void enable_cameras() {
+  CameraTop = wb_robot_get_device("CameraTop");
+  CameraBottom = wb_robot_get_device("CameraBottom");
+  if (always_render)
+    set_cameras_enabled(true);
 }
 
 /**
- * @brief Randomizes the ball's position, ensuring it's not too close to any robot.
+ * @brief FNV-1a hash of a motion name.
  */
-static void randomize_ball_position() {
-  WbNodeRef ball_node = wb_supervisor_node_get_from_def("SOCCER_BALL");
-  if (!ball_node) {
-    fprintf(stderr, "Warning: Could not find node with DEF SOCCER_BALL.\n");
-    return;
-  }
+static unsigned int motion_hash(const char *name) {
+  unsigned int hash = 2166136261u;
+  for (; *name; name++)
+    hash = (hash ^ (unsigned char)*name) * 16777619u;
+  return hash % MOTION_BUCKET_COUNT;
+}
 
-  WbFieldRef translation_field = wb_supervisor_node_get_field(ball_node, "translation");
-  if (!translation_field) {
-    fprintf(stderr, "Warning: Could not get 'translation' field for SOCCER_BALL.\n");
+/**
+ * @brief Indexes the .motion files of the motion directory by name, without loading them.
+ */
+static void index_motions() {
+  DIR *d = opendir(MOTION_DIR);
+  if (!d) {
+    perror("Could not open motion directory");
     return;
   }
-
-  double rx[4], ry[4];
-  const char *robot_defs[4] = {"NAO RED 2", "NAO RED 3", "NAO BLUE 4", "OBSTACLE_ROBOT"};
-  int valid_count = 0;
-
-  for (int i = 0; i < 4; i++) {
-    double x, y;
-    if (get_robot_xy(robot_defs[i], &x, &y)) {
-      rx[valid_count] = x;
-      ry[valid_count] = y;
-      valid_count++;
-    }
+  const struct dirent *dir;
+  while ((dir = readdir(d)) != NULL) {
+    const char *name = dir->d_name;
+    const char *extension = strrchr(name, '.');
+    if (name[0] == '.' || !extension || strcmp(extension, ".motion") != 0)
+      continue;
+    struct Motion *motion = (struct Motion *)calloc(1, sizeof(struct Motion));
+    const size_t length = extension - name;
+    motion->name = (char *)malloc(length + 1);
+    memcpy(motion->name, name, length);
+    motion->name[length] = '\0';
+    const unsigned int bucket = motion_hash(motion->name);
+    motion->next = motion_buckets[bucket];
+    motion_buckets[bucket] = motion;
   }
+  closedir(d);
+}
 
-  double minDist = 0.3;
-  while (1) {
-    double bx = rand_in_range(-3.0, 3.0);
-    double by = rand_in_range(-4.5, 4.5);
-
-    int collide = 0;
-    for (int i = 0; i < valid_count; i++) {
-      double dx = bx - rx[i];
-      double dy = by - ry[i];
-      double dist = sqrt(dx * dx + dy * dy);
-      if (dist < minDist) {
-        collide = 1;
-        break;
-      }
-    }
-
-    if (!collide) {
-      double new_trans[3] = {bx, by, 0.07};
-      wb_supervisor_field_set_sf_vec3f(translation_field, new_trans);
-      break;
+/**
+ * @brief Frees the motion registry and the loaded motions.
+ */
+static void free_motions() {
+  for (int i = 0; i < MOTION_BUCKET_COUNT; i++) {
+    while (motion_buckets[i]) {
+      struct Motion *next = motion_buckets[i]->next;
+      if (motion_buckets[i]->ref)
+        wbu_motion_delete(motion_buckets[i]->ref);
+      free(motion_buckets[i]->name);
+      free(motion_buckets[i]);
+      motion_buckets[i] = next;
     }
   }
-
-  double zero_velocity[6] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
-  wb_supervisor_node_set_velocity(ball_node, zero_velocity);
 }
 
 /**
- * @brief Randomizes the direction and intensity (luminosity) of the background light.
+ * @brief Finds a motion by its name, loading it on first use.
+ * @param name The name of the motion (without extension).
+ * @return WbMotionRef if found and loaded, NULL otherwise.
  */
-static void randomize_background_light() {
-  WbNodeRef light_node = wb_supervisor_node_get_from_def("TEXTURED_BACKGROUND_LIGHT");
-  if (!light_node) {
-    fprintf(stderr, "Warning: Could not find node with DEF TEXTURED_BACKGROUND_LIGHT.\n");
-    return;
+static WbMotionRef find_motion(const char *name) {
+  struct Motion *motion = motion_buckets[motion_hash(name)];
+  while (motion && strcmp(motion->name, name) != 0)
+    motion = motion->next;
+  if (!motion) {
+    fprintf(stderr, "Motion not found: %s\n", name);
+    return NULL;
+  }
+  if (!motion->loaded) {
+    char filename[256];
+    snprintf(filename, sizeof(filename), "%s/%s.motion", MOTION_DIR, name);
+    motion->ref = wbu_motion_new(filename);
+    motion->loaded = true;
+    if (!motion->ref)
+      fprintf(stderr, "Could not load motion: %s\n", filename);
   }
+  return motion->ref;
+}
 
-  WbFieldRef direction_field  = wb_supervisor_node_get_field(light_node, "direction");
-  WbFieldRef luminosity_field = wb_supervisor_node_get_field(light_node, "luminosity");
-  if (!direction_field || !luminosity_field) {
-    fprintf(stderr, "Warning: Could not get direction or luminosity fields.\n");
+/**
+ * @brief Starts playing a motion by name, stopping any currently playing motion.
+ * @param name The name of the motion to play.
+ */
+static void start_motion(const char *name) {
+  WbMotionRef motion = find_motion(name);
+  if (!motion)
     return;
-  }
+  if (currently_playing)
+    wbu_motion_stop(currently_playing);
 
-  double rx = rand_in_range(-2.0, 2.0);
-  double ry = rand_in_range(-7.0, -0.7);
-  double rz = rand_in_range(-2.0, 2.0);
-  double new_luminosity = rand_in_range(0.0, 3.0);
+  wbu_motion_play(motion);
+  currently_playing = motion;
+}
 
-  double new_dir[3] = {rx, ry, rz};
-  wb_supervisor_field_set_sf_vec3f(direction_field, new_dir);
-  wb_supervisor_field_set_sf_float(luminosity_field, new_luminosity);
+/**
+ * @brief Prints the controller arguments.
+ */
+static void print_usage(const char *command) {
+  printf("Usage: %s [-o <tree|shard|ring>] [-r <output_root>] [-S <shard_size_mb>] [-N <slots>] "
+         "[-c <top|bottom|both>] [-e <window|always>] [-k] [-O <full|crop|both>] [-C <size>] [-P <padding>] "
+         "[-M <file>] [-E <webots|library>] [-p <file>] [-x <directory>] [-v]\n",
+         command);
+  printf("Options:\n");
+  printf("  -o: dataset output mode. 'tree' (default) writes one JPEG per frame, 'shard' packs frames in tar shards.\n");
+  printf("      'ring' publishes raw frames and labels in shared memory for a local consumer.\n");
+  printf("  -r: dataset root directory. Default is the WEREF_OUTPUT_ROOT environment variable, set by the\n");
+  printf("      collection runner, or 'images'.\n");
+  printf("  -S: maximum shard size in MB. Default is 256.\n");
+  printf("  -N: number of frame slots of the ring. Default is 16.\n");
+  printf("  -c: cameras saved on each captured step. Default is 'top', only the saved cameras are enabled.\n");
+  printf("  -e: camera rendering. 'window' (default) only renders the captured steps, 'always' renders every step.\n");
+  printf("  -k: store the 2D and 3D keypoints of the referee next to each image (not in 'ring' mode).\n");
+  printf("  -O: images saved per frame. 'full' (default) frame, 'crop' around the referee or 'both'.\n");
+  printf("  -C: side of the referee crops in pixels. Default is the smaller side of the camera image.\n");
+  printf("  -P: margin of the crops around the referee, relative to its size. Default is 0.2.\n");
+  printf("  -M: completion manifest of the collection, appended with the samples captured by this camera robot.\n");
+  printf("      Default is the WEREF_COMPLETION_MANIFEST environment variable, or none.\n");
+  printf("  -E: encoder of the full frames. 'webots' saves them with wb_camera_save_image(), 'library'\n");
+  printf("      encodes them in the controller like the crops: JPEG with libjpeg, PPM otherwise. Default is the\n");
+  printf("      WEREF_ENCODER environment variable, or 'webots'.\n");
+  printf("  -p: profile results file, appended with the time per pipeline stage of the run. Default is the\n");
+  printf("      WEREF_PROFILE environment variable, or none. The profile is always printed.\n");
+  printf("  -x: metrics directory, where 'nao_soccer_player_<robot>.prom' is rewritten every 5 s in the Prometheus\n");
+  printf("      text format. Default is the WEREF_METRICS environment variable, or none.\n");
+  printf("  -v: print the path of every saved image.\n");
 }
 
 // ----------------------------------------------------------
 // Controller "main"
 // ----------------------------------------------------------
-int main() {
+int main(int argc, char **argv) {
   wb_robot_init();
   time_step = wb_robot_get_basic_time_step();
 
-  srand((unsigned)(time(NULL) ^ (unsigned)clock()));
-
-  const char *name = wb_robot_get_name();
-
-  const char *full_world_path = wb_robot_get_world_path();
-  if (!full_world_path) {
-    printf("Failed to get the world path.\n");
-    wb_robot_cleanup();
-    return 1;
-  }
-
-  const char *last_slash = strrchr(full_world_path, '/');
-  const char *filename    = last_slash ? last_slash + 1 : full_world_path;
-
-  char world_name[256];
-  strncpy(world_name, filename, sizeof(world_name));
-  world_name[sizeof(world_name) - 1] = '\0';
-
-  char *dot = strrchr(world_name, '.');
-  if (dot && strcmp(dot, ".wbt") == 0)
-    *dot = '\0';
-
-  printf("World name (derived): %s\n", world_name);
-
-  char wbt_path[512];
-  snprintf(wbt_path, sizeof(wbt_path), "../../worlds/%s.wbt", world_name);
-
-  FILE *fp = fopen(wbt_path, "r");
-  if (!fp) {
-    printf("Failed to open world file: %s\n", wbt_path);
-    wb_robot_cleanup();
-    return 1;
-  }
-
-  printf("Opened world file: %s\n", wbt_path);
-
-  char gesture_found[128] = "";
-
-  char line[1024];
-  int  found_flag_line = 0;
-  while (fgets(line, sizeof(line), fp)) {
-    line[strcspn(line, "\r\n")] = '\0';
-
-    if (!found_flag_line) {
-      if (strstr(line, "-f")) {
-        found_flag_line = 1;
-      }
-    } else {
-      char *start = strstr(line, "motions/");
-      if (start) {
-        start += strlen("motions/");
-        char *end = strstr(start, ".bvh");
-        if (end) {
-          *end = '\0';
-          strncpy(gesture_found, start, sizeof(gesture_found) - 1);
-          gesture_found[sizeof(gesture_found) - 1] = '\0';
-          printf("Extracted gesture: %s\n", gesture_found);
+  if (getenv("WEREF_OUTPUT_ROOT"))
+    output_root = getenv("WEREF_OUTPUT_ROOT");
+  completion_path = getenv("WEREF_COMPLETION_MANIFEST");
+  profile_path = getenv("WEREF_PROFILE");
+  const char *metrics_directory = getenv("WEREF_METRICS");
+  const char *encoder = getenv("WEREF_ENCODER");
+  int c;
+  while ((c = getopt(argc, argv, "o:r:S:N:c:e:kO:C:P:M:E:p:x:v")) != -1) {
+    switch (c) {
+      case 'o':
+        ring_output = strcmp(optarg, "ring") == 0;
+        if (ring_output)
           break;
+        if (weref_dataset_writer_parse_mode(optarg) < 0) {
+          fprintf(stderr, "Unknown output mode `%s'.\n", optarg);
+          print_usage(argv[0]);
+          wb_robot_cleanup();
+          return 1;
         }
-      }
-      break;
-    }
-  }
-
-  fclose(fp);
-
-  if (strlen(gesture_found) == 0) {
-    printf("WARNING: Could not find a .bvh gesture name in %s\n", wbt_path);
-  } else {
-    gesture = gesture_found;
-    printf("Using gesture: %s\n", gesture);
-  }
-
-  char refereeModel[128] = "unknownReferee";
-  char background[128]   = "unknownBackground";
-  {
-    char temp[256];
-    strncpy(temp, world_name, sizeof(temp));
-    temp[sizeof(temp) - 1] = '\0';
-
-    char *underscore = strchr(temp, '_');
-    if (underscore) {
-      *underscore = '\0';
-      strncpy(refereeModel, temp, sizeof(refereeModel));
-      refereeModel[sizeof(refereeModel) - 1] = '\0';
-
-      const char *bg_part = underscore + 1;
-      strncpy(background, bg_part, sizeof(background));
-      background[sizeof(background) - 1] = '\0';
-    }
-  }
-
-  load_motion_list();
-
-  bool isRed2  = strcmp(name, "NAO RED 2")  == 0;
-  bool isRed3  = strcmp(name, "NAO RED 3")  == 0;
-  bool isBlue4 = strcmp(name, "NAO BLUE 4") == 0;
-
-  if (isRed2 || isRed3 || isBlue4) {
-    enable_cameras();
-    printf("Camera enabled for %s\n", name);
-  }
-
-  char position[16] = "";
-  if (isRed2)
-    strcpy(position, "left");
-  else if (isRed3)
-    strcpy(position, "middle");
-  else if (isBlue4)
-    strcpy(position, "right");
-
-  start_motion("static_image_collection");
-
-  double startTime = wb_robot_get_time();
-
-  const char *end_suffix = "_end";
-  int gesture_len = strlen(gesture);
-  int suffix_len = strlen(end_suffix);
-  bool is_end_pose = (gesture_len > suffix_len) && (strcmp(gesture + gesture_len - suffix_len, end_suffix) == 0);
-
-  // Check if the bvh file is a end pose static gesture
-  if (is_end_pose) {
-    while (wb_robot_get_time() < startTime + 3.0) {
-      if (wb_robot_step(time_step) == -1)
+        output_mode = weref_dataset_writer_parse_mode(optarg);
         break;
-    }
-
-    while (true) {
-      if (strcmp(name, "NAO RED 2") == 0) {
-        randomize_background_light();
-      }
-
-      if (strcmp(name, "OBSTACLE ROBOT") == 0) {
-        randomize_obstacle_robot();
-      }
-
-      if (isRed2 || isRed3 || isBlue4) {
-        WbNodeRef my_node = wb_supervisor_node_get_self();
-        if (my_node) {
-          WbFieldRef translation_field = wb_supervisor_node_get_field(my_node, "translation");
-          WbFieldRef rotation_field    = wb_supervisor_node_get_field(my_node, "rotation");
-          if (translation_field && rotation_field) {
-            double rx, ry;
-          if (isRed3) {
-              random_position_red3(&rx, &ry);
-          } else if (isRed2) {
-              random_position_red2(&rx, &ry);
-          } else {
-              random_position_blue4(&rx, &ry);
-          }
-            double new_translation[3] = {rx, ry, 0.335};
-            wb_supervisor_field_set_sf_vec3f(translation_field, new_translation);
-            set_facing_3_0(rotation_field, rx, ry);
-          }
-        }
-      }
-
-      randomize_ball_position();
-
-      if (isRed2 || isRed3 || isBlue4) {
-        WbNodeRef obs_node = wb_supervisor_node_get_from_def("OBSTACLE_ROBOT");
-        if (obs_node) {
-          WbFieldRef obs_trans_field = wb_supervisor_node_get_field(obs_node, "translation");
-          if (obs_trans_field) {
-            const double *vals = wb_supervisor_field_get_sf_vec3f(obs_trans_field);
-            if (vals) {
-              double dx = vals[0] + 3.0;
-              double dy = vals[1] + 4.0;
-              double dist = sqrt(dx * dx + dy * dy);
-              if (dist < 0.1)
-                obstacle_flag = 0;
-              else
-                obstacle_flag = 1;
-            }
-          }
-        }
-      }
-
-      if (isRed2 || isRed3 || isBlue4) {
-        store_frame_image(CameraTop,
-                          frame_count,
-                          gesture,
-                          refereeModel, clothName,
-                          background,
-                          obstacle_flag,
-                          position);
-        frame_count++;
-      }
-
-      if (wb_robot_step(time_step) == -1)
+      case 'r':
+        output_root = optarg;
         break;
-    }
-  }
-  else if (strcmp(gesture, "full_time") == 0) {
-    double nextRandomTime = startTime + 1.26;
-    const double randomInterval = 0.6;
-    bool didInitialRandom = false;
-
-    while (true) {
-      double currentTime = wb_robot_get_time();
-      if (isRed2 || isRed3 || isBlue4) {
-        WbNodeRef obs_node = wb_supervisor_node_get_from_def("OBSTACLE_ROBOT");
-        if (obs_node) {
-          WbFieldRef obs_trans_field = wb_supervisor_node_get_field(obs_node, "translation");
-          if (obs_trans_field) {
-            const double *vals = wb_supervisor_field_get_sf_vec3f(obs_trans_field);
-            if (vals) {
-              double dx = vals[0] + 3.0;
-              double dy = vals[1] + 4.0;
-              double dist = sqrt(dx * dx + dy * dy);
-              if (dist < 0.1)
-                obstacle_flag = 0;
-              else
-                obstacle_flag = 1;
-            }
-          }
-        }
-      }
-
-      if (currentTime >= nextRandomTime) {
-        if (strcmp(name, "NAO RED 2") == 0) {
-          randomize_background_light();
+      case 'S':
+        shard_size = atol(optarg) * 1024 * 1024;
+        break;
+      case 'N':
+        ring_slot_count = atoi(optarg);
+        break;
+      case 'c':
+        if (strcmp(optarg, "top") == 0)
+          capture_cameras = CAPTURE_TOP;
+        else if (strcmp(optarg, "bottom") == 0)
+          capture_cameras = CAPTURE_BOTTOM;
+        else if (strcmp(optarg, "both") == 0)
+          capture_cameras = CAPTURE_TOP | CAPTURE_BOTTOM;
+        else {
+          fprintf(stderr, "Unknown camera selection `%s'.\n", optarg);
+          print_usage(argv[0]);
+          wb_robot_cleanup();
+          return 1;
         }
-        if (strcmp(name, "OBSTACLE ROBOT") == 0) {
-          randomize_obstacle_robot();
+        break;
+      case 'e':
+        if (strcmp(optarg, "window") != 0 && strcmp(optarg, "always") != 0) {
+          fprintf(stderr, "Unknown camera rendering `%s'.\n", optarg);
+          print_usage(argv[0]);
+          wb_robot_cleanup();
+          return 1;
         }
-        if (isRed2 || isRed3 || isBlue4) {
-          WbNodeRef my_node = wb_supervisor_node_get_self();
-          if (my_node) {
-            WbFieldRef translation_field = wb_supervisor_node_get_field(my_node, "translation");
-            WbFieldRef rotation_field    = wb_supervisor_node_get_field(my_node, "rotation");
-            if (translation_field && rotation_field) {
-              double rx, ry;
-              if (isRed3)
-                random_position_red3(&rx, &ry);
-              else if (isRed2)
-                random_position_red2(&rx, &ry);
-              else
-                random_position_blue4(&rx, &ry);
-              double new_translation[3] = {rx, ry, 0.335};
-              wb_supervisor_field_set_sf_vec3f(translation_field, new_translation);
-              set_facing_3_0(rotation_field, rx, ry);
-            }
-          }
+        always_render = strcmp(optarg, "always") == 0;
+        break;
+      case 'k':
+        store_keypoints = true;
+        break;
+      case 'O':
+        if (strcmp(optarg, "full") == 0)
+          image_outputs = OUTPUT_FULL;
+        else if (strcmp(optarg, "crop") == 0)
+          image_outputs = OUTPUT_CROP;
+        else if (strcmp(optarg, "both") == 0)
+          image_outputs = OUTPUT_FULL | OUTPUT_CROP;
+        else {
+          fprintf(stderr, "Unknown image output `%s'.\n", optarg);
+          print_usage(argv[0]);
+          wb_robot_cleanup();
+          return 1;
         }
-        randomize_ball_position();
-
-        didInitialRandom = true;
-
-        nextRandomTime += randomInterval;
-      }
-
-      if ((isRed2 || isRed3 || isBlue4) && currentTime >= (startTime + 1.26) && didInitialRandom) {
-        store_frame_image(CameraTop,
-                          frame_count,
-                          gesture,
-                          refereeModel, clothName,
-                          background,
-                          obstacle_flag,
-                          position);
-        frame_count++;
-      }
-
-      if (wb_robot_step(time_step) == -1)
         break;
+      case 'C':
+        crop_size = atoi(optarg);
+        break;
+      case 'P':
+        crop_padding = atof(optarg);
+        break;
+      case 'M':
+        completion_path = optarg;
+        break;
+      case 'E':
+        encoder = optarg;
+        break;
+      case 'p':
+        profile_path = optarg;
+        break;
+      case 'x':
+        metrics_directory = optarg;
+        break;
+      case 'v':
+        verbose = true;
+        break;
+      default:
+        print_usage(argv[0]);
+        wb_robot_cleanup();
+        return 1;
     }
   }
-  else if (strcmp(gesture, "substitution") == 0) {
-    double nextRandomTime = startTime + 0.94;
-    const double randomInterval = 0.44;
-    bool didInitialRandom = false;
-
-    while (true) {
-      double currentTime = wb_robot_get_time();
-      if (isRed2 || isRed3 || isBlue4) {
-        WbNodeRef obs_node = wb_supervisor_node_get_from_def("OBSTACLE_ROBOT");
-        if (obs_node) {
-          WbFieldRef obs_trans_field = wb_supervisor_node_get_field(obs_node, "translation");
-          if (obs_trans_field) {
-            const double *vals = wb_supervisor_field_get_sf_vec3f(obs_trans_field);
-            if (vals) {
-              double dx = vals[0] + 3.0;
-              double dy = vals[1] + 4.0;
-              double dist = sqrt(dx * dx + dy * dy);
-              if (dist < 0.1)
-                obstacle_flag = 0;
-              else
-                obstacle_flag = 1;
-            }
-          }
-        }
-      }
 
-      if (currentTime >= nextRandomTime) {
-        if (strcmp(name, "NAO RED 2") == 0) {
-          randomize_background_light();
-        }
-        if (strcmp(name, "OBSTACLE ROBOT") == 0) {
-          randomize_obstacle_robot();
-        }
-        if (isRed2 || isRed3 || isBlue4) {
-          WbNodeRef my_node = wb_supervisor_node_get_self();
-          if (my_node) {
-            WbFieldRef translation_field = wb_supervisor_node_get_field(my_node, "translation");
-            WbFieldRef rotation_field    = wb_supervisor_node_get_field(my_node, "rotation");
-            if (translation_field && rotation_field) {
-              double rx, ry;
-              if (isRed3)
-                random_position_red3(&rx, &ry);
-              else if (isRed2)
-                random_position_red2(&rx, &ry);
-              else
-                random_position_blue4(&rx, &ry);
-              double new_translation[3] = {rx, ry, 0.335};
-              wb_supervisor_field_set_sf_vec3f(translation_field, new_translation);
-              set_facing_3_0(rotation_field, rx, ry);
-            }
-          }
-        }
-        randomize_ball_position();
-
-        didInitialRandom = true;
-
-        nextRandomTime += randomInterval;
-      }
-
-      if ((isRed2 || isRed3 || isBlue4) && currentTime >= (startTime + 0.94) && didInitialRandom) {
-        store_frame_image(CameraTop,
-                          frame_count,
-                          gesture,
-                          refereeModel, clothName,
-                          background,
-                          obstacle_flag,
-                          position);
-        frame_count++;
-      }
+  if (encoder && encoder[0]) {
+    if (strcmp(encoder, "webots") != 0 && strcmp(encoder, "library") != 0) {
+      fprintf(stderr, "Unknown encoder `%s'.\n", encoder);
+      print_usage(argv[0]);
+      wb_robot_cleanup();
+      return 1;
+    }
+    library_encoder = strcmp(encoder, "library") == 0;
+  }
 
-      if (wb_robot_step(time_step) == -1)
-        break;
+  if (image_outputs & OUTPUT_CROP) {
+    if (crop_size < 0) {
+      fprintf(stderr, "Invalid crop size %d.\n", crop_size);
+      wb_robot_cleanup();
+      return 1;
+    }
+    // uncompressed crops would be larger than the full frames they replace
+    if (strcmp(weref_image_extension(), ".jpg") != 0) {
+      fprintf(stderr, "Error: the referee crops need weref_util built with libjpeg (WEREF_USE_LIBJPEG).\n");
+      wb_robot_cleanup();
+      return 1;
     }
   }
-  else {
-    double nextRandomTime = startTime + 0.88;
-    const double randomInterval = 0.82;
-    const double gapInterval = 0.02;
-    bool didInitialRandom = false;
-
-    while (true) {
-      double currentTime = wb_robot_get_time();
-      if (isRed2 || isRed3 || isBlue4) {
-        WbNodeRef obs_node = wb_supervisor_node_get_from_def("OBSTACLE_ROBOT");
-        if (obs_node) {
-          WbFieldRef obs_trans_field = wb_supervisor_node_get_field(obs_node, "translation");
-          if (obs_trans_field) {
-            const double *vals = wb_supervisor_field_get_sf_vec3f(obs_trans_field);
-            if (vals) {
-              double dx = vals[0] + 3.0;
-              double dy = vals[1] + 4.0;
-              double dist = sqrt(dx * dx + dy * dy);
-              if (dist < 0.1)
-                obstacle_flag = 0;
-              else
-                obstacle_flag = 1;
-            }
-          }
-        }
-      }
 
-      if (currentTime >= nextRandomTime) {
-        if (strcmp(name, "NAO RED 2") == 0) {
-          randomize_background_light();
-        }
-        if (strcmp(name, "OBSTACLE ROBOT") == 0) {
-          randomize_obstacle_robot();
-        }
-        if (isRed2 || isRed3 || isBlue4) {
-          WbNodeRef my_node = wb_supervisor_node_get_self();
-          if (my_node) {
-            WbFieldRef translation_field = wb_supervisor_node_get_field(my_node, "translation");
-            WbFieldRef rotation_field    = wb_supervisor_node_get_field(my_node, "rotation");
-            if (translation_field && rotation_field) {
-              double rx, ry;
-              if (isRed3)
-                random_position_red3(&rx, &ry);
-              else if (isRed2)
-                random_position_red2(&rx, &ry);
-              else
-                random_position_blue4(&rx, &ry);
-              double new_translation[3] = {rx, ry, 0.335};
-              wb_supervisor_field_set_sf_vec3f(translation_field, new_translation);
-              set_facing_3_0(rotation_field, rx, ry);
-            }
-          }
-        }
-        randomize_ball_position();
+  if (metrics_directory && metrics_directory[0])
+    open_metrics(metrics_directory);
+  // hot-path trace of the run, when built with WEREF_TRACE_ENABLED
+  WEREF_TRACE_START(getenv("WEREF_TRACE"), "nao_soccer_player", wb_robot_get_name());
+  index_motions();
 
-        didInitialRandom = true;
-        nextRandomTime += randomInterval + gapInterval;
-      }
+  enable_cameras();
+  referee_custom_data = find_referee_custom_data();
+  printf("Cameras of %s render %s\n", wb_robot_get_name(), always_render ? "every step" : "the captured steps");
 
-      if ((isRed2 || isRed3 || isBlue4) && currentTime >= (startTime + 0.88) && didInitialRandom) {
-        store_frame_image(CameraTop,
-                          frame_count,
-                          gesture,
-                          refereeModel, clothName,
-                          background,
-                          obstacle_flag,
-                          position);
-        frame_count++;
-      }
+  start_motion("static_image_collection");
 
-      if (wb_robot_step(time_step) == -1)
+  // The scene director randomizes the scene and publishes it with the capture state in our customData field.
+  char last_custom_data[WEREF_SCENE_MESSAGE_MAX_LENGTH] = "";
+  WerefSceneMessage message;
+  bool has_message = false;
+
+  weref_stage_profile_start(&profile);
+  stage_start = profile.start;
+  while (robot_step() != -1) {
+    end_stage(WEREF_STAGE_STEP);
+    update_metrics(has_message ? &message : NULL);
+    const char *custom_data = wb_robot_get_custom_data();
+    if (strcmp(custom_data, last_custom_data) != 0) {
+      snprintf(last_custom_data, sizeof(last_custom_data), "%s", custom_data);
+      has_message = weref_scene_message_decode(custom_data, &message);
+      end_stage(WEREF_STAGE_SUPERVISOR);
+      if (!has_message)
+        continue;
+      if (!dataset_writer && !frame_ring && !open_outputs(&message))
         break;
+      if (message.sample != sample_index) {
+        if (sample_frame > 0)
+          record_completion(&message, false);
+        end_stage(WEREF_STAGE_WRITE);
+        sample_index = message.sample;
+        sample_presence = message.scene.obstacle_flag;
+        if (sample_presence < -1 || sample_presence > 1)
+          sample_presence = -1;
+        sample_frame = 0;
+      }
+    }
+
+    if (has_message && message.capture && cameras_enabled) {
+      if (capture_cameras & CAPTURE_TOP)
+        store_frame_image(CameraTop, frame_count, &message);
+      if (capture_cameras & CAPTURE_BOTTOM)
+        store_frame_image(CameraBottom, frame_count, &message);
+      frame_count++;
+      sample_frame++;
     }
+
+    // a camera enabled now renders at the end of the next step
+    if (has_message && !always_render)
+      set_cameras_enabled(message.render);
+    stage_start = weref_stage_clock();
   }
 
+  if (has_message)
+    record_completion(&message, true);
+  update_metrics(has_message ? &message : NULL);
+  weref_metrics_cleanup(metrics);
+  weref_stage_profile_print(&profile, wb_robot_get_name(), wb_robot_get_time());
+  if (profile_path)
+    weref_stage_profile_append(profile_path, &profile, "nao_soccer_player", wb_robot_get_name(), wb_robot_get_time());
+  WEREF_TRACE_STOP();
+  weref_frame_ring_cleanup(frame_ring);
+  weref_label_manifest_cleanup(label_manifest);
+  weref_dataset_writer_cleanup(dataset_writer);
+  free(crop_buffer);
+  free(frame_buffer);
+  weref_encoded_image_cleanup(&encoded_image);
+  free_motions();
   wb_robot_cleanup();
-  free_motion_list();
   return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,1073 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <webots/robot.h>
+#include <webots/bvh_util.h>
+#include <webots/supervisor.h>
+#include <weref/metrics.h>
+#include <weref/replay_log.h>
+#include <weref/sampler.h>
+#include <weref/schedule.h>
+#include <weref/scene_message.h>
+#include <weref/stage_profile.h>
+#include <weref/trace.h>
+
+#include "scene_handles.h"
+
+#ifdef _MSC_VER
+#define snprintf sprintf_s
+#endif
+
+// --- Global Variables ---
+static int time_step = -1;
+static const char *clothName = "Cloth2";
+
+// Supervisor node and field handles, resolved once after wb_robot_init()
+static SceneHandles scene;
+
+// Scene sampler, one point stream per robot area and one for the ball
+#define BALL_STREAM WEREF_ROBOT_COUNT
+#define BALL_MAX_ATTEMPTS 32
+#define SIDE_AREA_TABLE_SIZE 512
+static WerefSampler sampler = NULL;
+static WerefRadialTable side_area_table = NULL;
+
+// Scene written during the current randomization tick, published to the camera robots
+static WerefSceneState scene_state;
+static int sample_index = -1;
+static bool capture_state = false;
+
+// Fields written by scene_write(), identifiers of the replay log
+typedef enum {
+  SCENE_FIELD_TRANSLATION = 0,
+  SCENE_FIELD_ROTATION,
+  SCENE_FIELD_VELOCITY,
+  SCENE_FIELD_LIGHT_DIRECTION,
+  SCENE_FIELD_LIGHT_LUMINOSITY,
+  SCENE_FIELD_OBSTACLE_FLAG  // scene state only
+} SceneField;
+#define SCENE_TARGET_BALL WEREF_ROBOT_COUNT
+
+// Replay log, either recorded (-L) or replayed (-R)
+#define MAX_SAMPLE_RANGES 64
+static WerefReplayLog replay_log = NULL;
+static bool recording = false;
+static uint64_t run_seed = 0;
+static int step_write_count = 0;                     // writes of the current step
+static int sample_ranges[MAX_SAMPLE_RANGES][2];      // samples captured by the replay, all if empty
+static int n_sample_ranges = 0;
+
+// Camera robots and the position label of their captures
+static const WerefRobotId camera_robots[3] = {WEREF_ROBOT_RED_2, WEREF_ROBOT_RED_3, WEREF_ROBOT_BLUE_4};
+static const char *camera_positions[3] = {"left", "middle", "right"};
+static char published[3][WEREF_SCENE_MESSAGE_MAX_LENGTH];  // last message sent to each camera robot
+
+// Quota of the run (-q): samples still to capture for each presence of the obstacle robot (0: absent, 1: present)
+// and camera position. A sample is only captured by the camera robots whose cell of its presence is not full yet.
+static bool has_quota = false;
+static int quota[2][3];
+static bool sample_positions[3] = {true, true, true};  // camera robots capturing the current sample
+
+// Playback of the referee motion by the 'bvh_animation' controller, used by the default capture schedule
+#define REFEREE_TIME_STEP 32
+#define REFEREE_FRAMES_PER_STEP 4
+
+// Labels of the run
+static char gesture[128] = "";
+static char refereeModel[128] = "unknownReferee";
+static char background[128] = "unknownBackground";
+
+// Wall-clock time per stage of the run, printed at the end and appended to the profile results file (-p)
+static WerefStageProfile profile;
+static const char *profile_path = NULL;
+static double stage_start = 0.0;  // clock at the end of the previous stage
+
+// Live metrics of the run, rewritten every METRICS_INTERVAL wall-clock seconds in the metrics directory (-x)
+#define METRICS_INTERVAL 5.0  // [s]
+static WerefMetrics metrics = NULL;
+static int metric_steps, metric_step_time, metric_supervisor_calls, metric_simulated_time, metric_sample,
+  metric_samples_missing;
+static double metrics_clock = 0.0;  // clock of the previous metrics update
+static int metrics_sample = -1;     // sample of the cell labels of 'metric_sample'
+
+// --- Function Implementations ---
+
+/**
+ * @brief Accounts the time since the end of the previous stage to 'stage'.
+ */
+static void end_stage(WerefStage stage) {
+  stage_start = weref_stage_add(&profile, stage, stage_start);
+}
+
+/**
+ * @brief wb_robot_step(), traced as a whole: the simulation, the rendering and the other controllers.
+ */
+static int robot_step() {
+  WEREF_TRACE_SCOPE("wb_robot_step");
+  return wb_robot_step(time_step);
+}
+
+// ----------------------------------------------------------
+// Randomization Helpers
+// ----------------------------------------------------------
+
+// Field areas, centered on the referee at (3, 0):
+// C1 and C2 are the half-disks of radius 3.8 and 2.2 on the field side of the referee (x <= 3),
+// C3 is the disk of radius 0.8 around the center of the field.
+#define REFEREE_X 3.0
+#define C1_RADIUS 3.8
+#define C2_RADIUS 2.2
+#define C3_RADIUS 0.8
+#define SIDE_AREA_WIDTH 2.0  // |y| bound of the NAO RED 2 and NAO BLUE 4 areas
+
+/**
+ * @brief Angular bounds, around the referee, of the NAO RED 2 area at distance r: inside C1, outside C2 and C3,
+ * with 0 <= y <= SIDE_AREA_WIDTH.
+ */
+static void side_area_angles(double r, double *min_angle, double *max_angle) {
+  // y = r sin(angle) <= SIDE_AREA_WIDTH, with angle in [pi/2, pi]
+  *min_angle = M_PI - asin(fmin(SIDE_AREA_WIDTH / r, 1.0));
+  // outside C3: |p|^2 = REFEREE_X^2 + 2 REFEREE_X r cos(angle) + r^2 > C3_RADIUS^2
+  const double c = (C3_RADIUS * C3_RADIUS - REFEREE_X * REFEREE_X - r * r) / (2.0 * REFEREE_X * r);
+  *max_angle = c <= -1.0 ? M_PI : acos(c);
+}
+
+/**
+ * @brief Arc length of the NAO RED 2 area at distance r from the referee, i.e. the marginal density of r.
+ */
+static double side_area_density(double r) {
+  double min_angle, max_angle;
+  side_area_angles(r, &min_angle, &max_angle);
+  return max_angle > min_angle ? r * (max_angle - min_angle) : 0.0;
+}
+
+/**
+ * @brief Maps a point of the unit square to the NAO RED 2 area, NAO BLUE 4 being its mirror (y < 0).
+ */
+static void side_area_position(const double u[2], bool mirror, double *px, double *py) {
+  const double r = weref_radial_table_sample(side_area_table, u[0]);
+  double min_angle, max_angle;
+  side_area_angles(r, &min_angle, &max_angle);
+  const double angle = min_angle + u[1] * fmax(max_angle - min_angle, 0.0);
+  *px = REFEREE_X + r * cos(angle);
+  *py = (mirror ? -r : r) * sin(angle);
+}
+
+/**
+ * @brief Maps a point of the unit square to the NAO RED 3 area, the disk C3.
+ */
+static void center_area_position(const double u[2], double *px, double *py) {
+  const double r = C3_RADIUS * sqrt(u[0]);
+  const double angle = 2.0 * M_PI * u[1];
+  *px = r * cos(angle);
+  *py = r * sin(angle);
+}
+
+/**
+ * @brief Maps a point of the unit square to the obstacle area, the half-disk C2.
+ */
+static void obstacle_area_position(const double u[2], double *px, double *py) {
+  const double r = C2_RADIUS * sqrt(u[0]);
+  const double angle = M_PI_2 + M_PI * u[1];
+  *px = REFEREE_X + r * cos(angle);
+  *py = r * sin(angle);
+}
+
+// ----------------------------------------------------------
+// Quota
+// ----------------------------------------------------------
+
+/**
+ * @brief Parses '<left>,<middle>,<right>/<left>,<middle>,<right>', the samples of each camera position with the
+ * obstacle robot present and then absent.
+ */
+static bool parse_quota(const char *text) {
+  int *present = quota[1], *absent = quota[0];
+  char end;
+  if (sscanf(text, "%d,%d,%d/%d,%d,%d%c", &present[0], &present[1], &present[2], &absent[0], &absent[1], &absent[2],
+             &end) != 6)
+    return false;
+  for (int i = 0; i < 3; i++) {
+    if (present[i] < 0 || absent[i] < 0)
+      return false;
+  }
+  has_quota = true;
+  return true;
+}
+
+/**
+ * @brief Samples still needed with the obstacle robot present (1) or absent (0): every sample fills a cell of each
+ * camera position at once, so the largest of them.
+ */
+static int quota_need(int presence) {
+  int need = 0;
+  for (int i = 0; i < 3; i++)
+    need = quota[presence][i] > need ? quota[presence][i] : need;
+  return need;
+}
+
+/**
+ * @brief Whether the camera robot at 'position' may capture the next sample, whose presence is not drawn yet.
+ */
+static bool quota_position_needed(int position) {
+  return !has_quota || quota[0][position] > 0 || quota[1][position] > 0;
+}
+
+/**
+ * @brief Counts the sample that just got its last frame in the cells of the camera robots that captured it.
+ */
+static void quota_count_sample() {
+  const int presence = scene_state.obstacle_flag == 1 ? 1 : 0;
+  for (int i = 0; i < 3; i++) {
+    if (sample_positions[i] && quota[presence][i] > 0)
+      quota[presence][i]--;
+  }
+}
+
+// ----------------------------------------------------------
+// Scene Writes
+// ----------------------------------------------------------
+
+/**
+ * @brief Applies one write to the simulation and to the scene state, and records it in the replay log.
+ *
+ * Every randomizer goes through this function, so that a replay only needs to call it again with the logged values.
+ * 'target' is a WerefRobotId, or SCENE_TARGET_BALL for the ball.
+ */
+static void scene_write(SceneField field, int target, const double *values, int count) {
+  const SceneNode *node = target == SCENE_TARGET_BALL ? &scene.ball : &scene.robots[target];
+  switch (field) {
+    case SCENE_FIELD_TRANSLATION:
+      SUPERVISOR_CALL(wb_supervisor_field_set_sf_vec3f(node->translation, values));
+      if (target == SCENE_TARGET_BALL)
+        memcpy(scene_state.ball, values, sizeof(scene_state.ball));
+      else {
+        scene_state.robots[target].x = values[0];
+        scene_state.robots[target].y = values[1];
+      }
+      break;
+    case SCENE_FIELD_ROTATION:
+      SUPERVISOR_CALL(wb_supervisor_field_set_sf_rotation(node->rotation, values));
+      scene_state.robots[target].yaw = weref_rotation_to_yaw(values);
+      break;
+    case SCENE_FIELD_VELOCITY:
+      SUPERVISOR_CALL(wb_supervisor_node_set_velocity(node->node, values));
+      break;
+    case SCENE_FIELD_LIGHT_DIRECTION:
+      SUPERVISOR_CALL(wb_supervisor_field_set_sf_vec3f(scene.light_direction, values));
+      memcpy(scene_state.light_direction, values, sizeof(scene_state.light_direction));
+      break;
+    case SCENE_FIELD_LIGHT_LUMINOSITY:
+      SUPERVISOR_CALL(wb_supervisor_field_set_sf_float(scene.light_luminosity, values[0]));
+      scene_state.light_luminosity = values[0];
+      break;
+    case SCENE_FIELD_OBSTACLE_FLAG:
+      scene_state.obstacle_flag = (int)values[0];
+      break;
+  }
+  if (recording)
+    weref_replay_log_write(replay_log, field, target, values, count);
+  step_write_count++;
+}
+
+/**
+ * @brief Sets the robot's rotation field to face the point (3, 0).
+ */
+static void set_facing_3_0(WerefRobotId robot, double x, double y) {
+  double dx = 3.0 - x;
+  double dy = 0.0 - y;
+  double angle = atan2(dy, dx);
+  double axis_z = (y > 0.0) ? -1.0 : 1.0;
+  angle = fabs(angle);
+  double rot[4] = {0.0, 0.0, axis_z, angle};
+  scene_write(SCENE_FIELD_ROTATION, robot, rot, 4);
+}
+
+/**
+ * @brief Randomizes the position and visibility of the obstacle robot.
+ *
+ * With a quota, the obstacle robot is absent with the probability of the share of the absent samples in the samples
+ * still needed, so that the cells of both presences fill up together and no sample is drawn for full cells.
+ */
+static void randomize_obstacle_robot() {
+  WEREF_TRACE_SCOPE("randomize_obstacle_robot");
+  double absent_probability = 0.5;
+  if (has_quota && quota_need(0) + quota_need(1) > 0)
+    absent_probability = (double)quota_need(0) / (quota_need(0) + quota_need(1));
+  double obstacle_visible = weref_sampler_uniform(sampler, 0.0, 1.0) < absent_probability ? 0.0 : 1.0;
+  scene_write(SCENE_FIELD_OBSTACLE_FLAG, WEREF_ROBOT_OBSTACLE, &obstacle_visible, 1);
+
+  const SceneNode *obstacle = &scene.robots[WEREF_ROBOT_OBSTACLE];
+  if (!obstacle->translation || !obstacle->rotation)
+    return;
+
+  if (!obstacle_visible) {
+    double no_obs_translation[3] = {-3.0, -4.0, 0.335};
+    scene_write(SCENE_FIELD_TRANSLATION, WEREF_ROBOT_OBSTACLE, no_obs_translation, 3);
+
+    double no_obs_rot[4] = {0.0, 0.0, 1.0, 0.0};
+    scene_write(SCENE_FIELD_ROTATION, WEREF_ROBOT_OBSTACLE, no_obs_rot, 4);
+  } else {
+    double u[2], x, y;
+    weref_sampler_next_point(sampler, WEREF_ROBOT_OBSTACLE, u);
+    obstacle_area_position(u, &x, &y);
+    double obs_translation[3] = {x, y, 0.335};
+    scene_write(SCENE_FIELD_TRANSLATION, WEREF_ROBOT_OBSTACLE, obs_translation, 3);
+
+    double angle = weref_sampler_uniform(sampler, -3.14, 3.14);
+    double obs_rot[4] = {0.0, 0.0, 1.0, angle};
+    scene_write(SCENE_FIELD_ROTATION, WEREF_ROBOT_OBSTACLE, obs_rot, 4);
+  }
+}
+
+/**
+ * @brief Teleports a camera robot to a random position of its area, facing the referee.
+ */
+static void randomize_camera_robot(WerefRobotId robot) {
+  WEREF_TRACE_SCOPE("randomize_camera_robot");
+  const SceneNode *node = &scene.robots[robot];
+  if (!node->translation || !node->rotation)
+    return;
+
+  double u[2], rx, ry;
+  weref_sampler_next_point(sampler, robot, u);
+  if (robot == WEREF_ROBOT_RED_3)
+    center_area_position(u, &rx, &ry);
+  else
+    side_area_position(u, robot == WEREF_ROBOT_BLUE_4, &rx, &ry);
+  double new_translation[3] = {rx, ry, 0.335};
+  scene_write(SCENE_FIELD_TRANSLATION, robot, new_translation, 3);
+  set_facing_3_0(robot, rx, ry);
+}
+
+/**
+ * @brief Randomizes the ball's position, ensuring it's not too close to any robot.
+ *
+ * The robots must have been placed for this tick already: their new positions are taken from the scene state
+ * instead of being read back from the simulator.
+ */
+static void randomize_ball_position() {
+  WEREF_TRACE_SCOPE("randomize_ball_position");
+  if (!scene.ball.translation)
+    return;
+
+  // The first candidate comes from the ball stream, the few rejected ones are redrawn pseudo-randomly. If every
+  // attempt collides, the candidate farthest from the robots is kept.
+  const double minDist = 0.3;
+  double best[3] = {0.0, 0.0, 0.07};
+  double best_dist = -1.0;
+  for (int attempt = 0; attempt < BALL_MAX_ATTEMPTS && best_dist < minDist; attempt++) {
+    double u[2];
+    if (attempt == 0)
+      weref_sampler_next_point(sampler, BALL_STREAM, u);
+    else {
+      u[0] = weref_sampler_uniform(sampler, 0.0, 1.0);
+      u[1] = weref_sampler_uniform(sampler, 0.0, 1.0);
+    }
+    double bx = -3.0 + 6.0 * u[0];
+    double by = -4.5 + 9.0 * u[1];
+
+    double dist = INFINITY;
+    for (int i = 0; i < WEREF_ROBOT_COUNT; i++) {
+      double dx = bx - scene_state.robots[i].x;
+      double dy = by - scene_state.robots[i].y;
+      dist = fmin(dist, sqrt(dx * dx + dy * dy));
+    }
+    if (dist > best_dist) {
+      best_dist = dist;
+      best[0] = bx;
+      best[1] = by;
+    }
+  }
+  scene_write(SCENE_FIELD_TRANSLATION, SCENE_TARGET_BALL, best, 3);
+
+  double zero_velocity[6] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+  scene_write(SCENE_FIELD_VELOCITY, SCENE_TARGET_BALL, zero_velocity, 6);
+}
+
+/**
+ * @brief Randomizes the direction and intensity (luminosity) of the background light.
+ */
+static void randomize_background_light() {
+  WEREF_TRACE_SCOPE("randomize_background_light");
+  if (!scene.light_direction || !scene.light_luminosity)
+    return;
+
+  double rx = weref_sampler_uniform(sampler, -2.0, 2.0);
+  double ry = weref_sampler_uniform(sampler, -7.0, -0.7);
+  double rz = weref_sampler_uniform(sampler, -2.0, 2.0);
+  double new_luminosity = weref_sampler_uniform(sampler, 0.0, 3.0);
+
+  double new_dir[3] = {rx, ry, rz};
+  scene_write(SCENE_FIELD_LIGHT_DIRECTION, 0, new_dir, 3);
+  scene_write(SCENE_FIELD_LIGHT_LUMINOSITY, 0, &new_luminosity, 1);
+}
+
+/**
+ * @brief Performs one randomization tick: light, obstacle, the three camera robots and then the ball.
+ */
+static void randomize_scene() {
+  WEREF_TRACE_SCOPE("randomize_scene");
+  randomize_background_light();
+  randomize_obstacle_robot();
+  for (int i = 0; i < 3; i++)
+    sample_positions[i] = !has_quota || quota[scene_state.obstacle_flag == 1 ? 1 : 0][i] > 0;
+  for (int i = 0; i < 3; i++)
+    randomize_camera_robot(camera_robots[i]);
+  randomize_ball_position();
+  sample_index++;
+}
+
+// ----------------------------------------------------------
+// Camera Robots
+// ----------------------------------------------------------
+
+/**
+ * @brief Sends the current scene to the camera robots through their customData field.
+ *
+ * The message is written in the same step as the teleports, so each camera robot receives it together with the
+ * first image of the new scene. It is only rewritten when it changes.
+ * @param render Whether the next step is captured: a camera robot only enables its cameras for the steps it
+ * captures, and a camera enabled now has its first image after the next step.
+ * @param next_sample Whether the next step starts a new sample. With a quota, the camera robots that may capture it
+ * render, its presence is only drawn then.
+ */
+static void publish_scene(bool capture, bool render, bool next_sample) {
+  WEREF_TRACE_SCOPE("publish_scene");
+  capture_state = capture;
+  WerefSceneMessage message;
+  snprintf(message.gesture, sizeof(message.gesture), "%s", gesture);
+  snprintf(message.referee_model, sizeof(message.referee_model), "%s", refereeModel);
+  snprintf(message.cloth, sizeof(message.cloth), "%s", clothName);
+  snprintf(message.background, sizeof(message.background), "%s", background);
+  message.sample = sample_index;
+  message.seed = run_seed;
+  message.scene = scene_state;
+
+  for (int i = 0; i < 3; i++) {
+    WbFieldRef custom_data = scene.robots[camera_robots[i]].custom_data;
+    if (!custom_data)
+      continue;
+    snprintf(message.position, sizeof(message.position), "%s", camera_positions[i]);
+    message.capture = capture && sample_positions[i] ? 1 : 0;
+    message.render = render && (next_sample ? quota_position_needed(i) : sample_positions[i]) ? 1 : 0;
+    char text[WEREF_SCENE_MESSAGE_MAX_LENGTH];
+    if (weref_scene_message_encode(&message, text, sizeof(text)) < 0 || strcmp(text, published[i]) == 0)
+      continue;
+    SUPERVISOR_CALL(wb_supervisor_field_set_sf_string(custom_data, text));
+    strcpy(published[i], text);
+  }
+}
+
+/**
+ * @brief Puts the arms of the controller-less obstacle robot down, like the 'static_image_collection' motion.
+ */
+static void set_obstacle_posture() {
+  WbNodeRef obstacle = scene.robots[WEREF_ROBOT_OBSTACLE].node;
+  if (!obstacle)
+    return;
+  const char *shoulders[2] = {"RShoulderPitch", "LShoulderPitch"};
+  for (int i = 0; i < 2; i++) {
+    WbNodeRef joint = SUPERVISOR_CALL(wb_supervisor_node_get_from_proto_def(obstacle, shoulders[i]));
+    if (joint)
+      SUPERVISOR_CALL(wb_supervisor_node_set_joint_position(joint, 1.5, 1));
+  }
+}
+
+/**
+ * @brief Sets the proto fields of the robots that can't change during the run: the camera resolution of the camera
+ * robots (unless 'width' or 'height' is 0) and the kinematic mode of every robot. Webots regenerates their nodes,
+ * which restarts their controllers, so this must be done before any handle is resolved.
+ *
+ * A kinematic robot has no Physics node: it stays exactly where it is teleported and its motors pose its joints
+ * directly, the physics engine only simulates the ball. Physics is restored by running without the option, the
+ * world file is left untouched.
+ */
+static void configure_robots(int width, int height, bool kinematic) {
+  WEREF_TRACE_SCOPE("configure_robots");
+  for (int i = 0; i < WEREF_ROBOT_COUNT; i++) {
+    const char *def_name = scene_robot_defs[i];
+    WbNodeRef robot = wb_supervisor_node_get_from_def(def_name);
+    if (!robot) {
+      fprintf(stderr, "Warning: Could not configure %s.\n", def_name);
+      continue;
+    }
+    if (kinematic) {
+      WbFieldRef kinematic_field = wb_supervisor_node_get_field(robot, "kinematic");
+      if (kinematic_field)
+        wb_supervisor_field_set_sf_bool(kinematic_field, true);
+      else
+        fprintf(stderr, "Warning: %s has no 'kinematic' field, it keeps its physics.\n", def_name);
+    }
+    if (i == WEREF_ROBOT_OBSTACLE || width <= 0 || height <= 0)
+      continue;
+    WbFieldRef width_field = wb_supervisor_node_get_field(robot, "cameraWidth");
+    WbFieldRef height_field = wb_supervisor_node_get_field(robot, "cameraHeight");
+    if (!width_field || !height_field) {
+      fprintf(stderr, "Warning: Could not set the camera resolution of %s.\n", def_name);
+      continue;
+    }
+    wb_supervisor_field_set_sf_int32(width_field, width);
+    wb_supervisor_field_set_sf_int32(height_field, height);
+  }
+  wb_robot_step(time_step);
+  if (width > 0 && height > 0)
+    printf("Camera resolution set to %dx%d\n", width, height);
+  if (kinematic)
+    printf("Robots set to kinematic mode\n");
+}
+
+// ----------------------------------------------------------
+// Metrics
+// ----------------------------------------------------------
+
+/**
+ * @brief Registers the metrics of the director, written in 'directory'.
+ */
+static void open_metrics(const char *directory) {
+  metrics = weref_metrics_new(directory, "scene_director", wb_robot_get_name(), METRICS_INTERVAL);
+  metric_steps = weref_metrics_register(metrics, WEREF_METRIC_COUNTER, "weref_steps_total", "Simulation steps.");
+  metric_step_time = weref_metrics_register(metrics, WEREF_METRIC_SUMMARY, "weref_step_seconds",
+                                            "Wall-clock time of a controller step, wb_robot_step() included.");
+  metric_supervisor_calls = weref_metrics_register(metrics, WEREF_METRIC_SUMMARY, "weref_supervisor_calls_per_step",
+                                                   "Supervisor API calls of a step.");
+  metric_simulated_time = weref_metrics_register(metrics, WEREF_METRIC_GAUGE, "weref_simulated_seconds",
+                                                 "Simulated time.");
+  metric_sample = weref_metrics_register(metrics, WEREF_METRIC_GAUGE, "weref_sample",
+                                         "Index of the current sample, labelled with its dataset cell.");
+  metric_samples_missing = weref_metrics_register(metrics, WEREF_METRIC_GAUGE, "weref_samples_missing",
+                                                  "Samples still needed by the sample target or the quota.");
+  weref_metrics_set(metrics, metric_sample, -1);
+  metrics_clock = weref_stage_clock();
+}
+
+/**
+ * @brief Updates the metrics after a step, before its supervisor calls are reset, and writes them once their
+ * interval elapsed.
+ */
+static void update_metrics() {
+  if (!metrics)
+    return;
+  const double now = weref_stage_clock();
+  weref_metrics_observe(metrics, metric_step_time, now - metrics_clock);
+  metrics_clock = now;
+  weref_metrics_add(metrics, metric_steps, 1);
+  weref_metrics_observe(metrics, metric_supervisor_calls, supervisor_call_count);
+  weref_metrics_set(metrics, metric_simulated_time, wb_robot_get_time());
+  if (sample_index != metrics_sample) {
+    metrics_sample = sample_index;
+    char world[256];
+    snprintf(world, sizeof(world), "%s_%s", refereeModel, background);
+    const char *presence = scene_state.obstacle_flag == 1 ? "presence_robot" : "presence_norobot";
+    const char *labels[] = {"gesture", gesture, "world", world, "cloth", clothName, "presence", presence};
+    weref_metrics_set_labels(metrics, metric_sample, labels, 4);
+    weref_metrics_set(metrics, metric_sample, sample_index);
+  }
+  weref_metrics_update(metrics);
+}
+
+// ----------------------------------------------------------
+// Replay Log
+// ----------------------------------------------------------
+
+/**
+ * @brief Index of the current simulation step, counted from the simulation time so that it does not depend on when
+ * the director started stepping.
+ */
+static int step_index() {
+  return (int)(wb_robot_get_time() * 1000.0 / time_step + 0.5);
+}
+
+/**
+ * @brief Returns the motion frame published by the referee in its customData field, -1 if unknown.
+ */
+static int referee_motion_frame() {
+  if (!scene.referee.custom_data)
+    return -1;
+  const char *text = SUPERVISOR_CALL(wb_supervisor_field_get_sf_string(scene.referee.custom_data));
+  return text && text[0] ? atoi(text) : -1;
+}
+
+/**
+ * @brief Stores the writes of the step that is about to end in the replay log.
+ */
+static void record_step() {
+  WEREF_TRACE_SCOPE("record_step");
+  if (recording) {
+    WerefReplayStep step = {step_index(), sample_index, capture_state ? 1 : 0, -1};
+    if (step_write_count > 0)
+      step.motion_frame = referee_motion_frame();
+    weref_replay_log_end_step(replay_log, &step);
+  }
+  step_write_count = 0;
+}
+
+/**
+ * @brief Parses a list of sample indices and ranges, e.g. "3,10-12".
+ */
+static bool parse_sample_ranges(const char *text) {
+  char list[256];
+  snprintf(list, sizeof(list), "%s", text);
+  for (char *item = strtok(list, ","); item; item = strtok(NULL, ",")) {
+    int first, last;
+    const int n = sscanf(item, "%d-%d", &first, &last);
+    if (n < 1 || n_sample_ranges == MAX_SAMPLE_RANGES)
+      return false;
+    sample_ranges[n_sample_ranges][0] = first;
+    sample_ranges[n_sample_ranges][1] = n == 2 ? last : first;
+    n_sample_ranges++;
+  }
+  return n_sample_ranges > 0;
+}
+
+static bool is_sample_selected(int sample) {
+  if (n_sample_ranges == 0)
+    return true;
+  for (int i = 0; i < n_sample_ranges; i++) {
+    if (sample >= sample_ranges[i][0] && sample <= sample_ranges[i][1])
+      return true;
+  }
+  return false;
+}
+
+/**
+ * @brief Re-applies the logged writes step for step and only lets the camera robots capture the selected samples.
+ *
+ * The referee motion is driven by the simulation time, so the recorded motion frames are only compared to the
+ * current ones to detect a replay that diverges from its recording.
+ */
+static void run_replay() {
+  WerefReplayStep step;
+  const WerefReplayWrite *writes;
+  int n_writes;
+  bool has_step = weref_replay_log_next_step(replay_log, &step, &writes, &n_writes);
+  bool capture = false;
+  while (has_step) {
+    const int current_step = step_index();
+    while (has_step && step.step <= current_step) {
+      for (int i = 0; i < n_writes; i++)
+        scene_write(writes[i].field, writes[i].target, writes[i].values, writes[i].count);
+      sample_index = step.sample;
+      capture = step.capture && is_sample_selected(step.sample);
+      if (step.motion_frame >= 0) {
+        const int motion_frame = referee_motion_frame();
+        if (motion_frame != step.motion_frame)
+          fprintf(stderr, "Warning: Step %d replayed at referee motion frame %d instead of %d.\n", step.step,
+                  motion_frame, step.motion_frame);
+      }
+      has_step = weref_replay_log_next_step(replay_log, &step, &writes, &n_writes);
+    }
+
+    bool render = capture;
+    if (has_step && step.step == current_step + 1)
+      render = step.capture && is_sample_selected(step.sample);
+    if (sample_index >= 0 || render)
+      publish_scene(capture, render, false);
+    end_stage(WEREF_STAGE_SUPERVISOR);
+
+    step_write_count = 0;
+    if (robot_step() == -1)
+      return;
+    end_stage(WEREF_STAGE_STEP);
+    update_metrics();
+    scene_handles_end_step();
+  }
+  publish_scene(false, false, false);
+  printf("Replay finished at step %d\n", step_index());
+}
+
+// ----------------------------------------------------------
+// Capture Schedule
+// ----------------------------------------------------------
+
+/**
+ * @brief Reads the capture schedule of the gesture from the table, or derives it from the gesture BVH file.
+ */
+static bool load_schedule(const char *path, WerefSchedule *schedule) {
+  if (weref_schedule_load(path, gesture, schedule)) {
+    printf("Capture schedule of %s read from %s\n", gesture, path);
+    return true;
+  }
+
+  char bvh_path[512];
+  snprintf(bvh_path, sizeof(bvh_path), "../../motions/%s.bvh", gesture);
+  WbuBvhMotion motion = wbu_bvh_read_file(bvh_path);
+  if (!motion)
+    return false;
+  weref_schedule_default(wbu_bvh_get_frame_count(motion), REFEREE_FRAMES_PER_STEP, REFEREE_TIME_STEP, time_step,
+                         schedule);
+  wbu_bvh_cleanup(motion);
+  printf("Capture schedule of %s derived from %s\n", gesture, bvh_path);
+  return true;
+}
+
+// ----------------------------------------------------------
+// World Labels
+// ----------------------------------------------------------
+
+/**
+ * @brief Derives the gesture, referee model and background labels from the world file.
+ */
+static bool read_world_labels() {
+  const char *full_world_path = wb_robot_get_world_path();
+  if (!full_world_path) {
+    printf("Failed to get the world path.\n");
+    return false;
+  }
+
+  const char *last_slash = strrchr(full_world_path, '/');
+  const char *filename    = last_slash ? last_slash + 1 : full_world_path;
+
+  char world_name[256];
+  strncpy(world_name, filename, sizeof(world_name));
+  world_name[sizeof(world_name) - 1] = '\0';
+
+  char *dot = strrchr(world_name, '.');
+  if (dot && strcmp(dot, ".wbt") == 0)
+    *dot = '\0';
+
+  printf("World name (derived): %s\n", world_name);
+
+  // the world itself rather than ../../worlds, which may be another copy when a runner instance loads a scratch world
+  const char *wbt_path = full_world_path;
+
+  FILE *fp = fopen(wbt_path, "r");
+  if (!fp) {
+    printf("Failed to open world file: %s\n", wbt_path);
+    return false;
+  }
+
+  printf("Opened world file: %s\n", wbt_path);
+
+  char line[1024];
+  int  found_flag_line = 0;
+  while (fgets(line, sizeof(line), fp)) {
+    line[strcspn(line, "\r\n")] = '\0';
+
+    if (!found_flag_line) {
+      if (strstr(line, "-f")) {
+        found_flag_line = 1;
+      }
+    } else {
+      char *start = strstr(line, "motions/");
+      if (start) {
+        start += strlen("motions/");
+        char *end = strstr(start, ".bvh");
+        if (end) {
+          *end = '\0';
+          strncpy(gesture, start, sizeof(gesture) - 1);
+          gesture[sizeof(gesture) - 1] = '\0';
+          printf("Extracted gesture: %s\n", gesture);
+          break;
+        }
+      }
+      break;
+    }
+  }
+
+  fclose(fp);
+
+  if (strlen(gesture) == 0)
+    printf("WARNING: Could not find a .bvh gesture name in %s\n", wbt_path);
+  else
+    printf("Using gesture: %s\n", gesture);
+
+  char temp[256];
+  strncpy(temp, world_name, sizeof(temp));
+  temp[sizeof(temp) - 1] = '\0';
+
+  char *underscore = strchr(temp, '_');
+  if (underscore) {
+    *underscore = '\0';
+    strncpy(refereeModel, temp, sizeof(refereeModel));
+    refereeModel[sizeof(refereeModel) - 1] = '\0';
+
+    const char *bg_part = underscore + 1;
+    strncpy(background, bg_part, sizeof(background));
+    background[sizeof(background) - 1] = '\0';
+  }
+  return true;
+}
+
+/**
+ * @brief Prints the controller arguments.
+ */
+static void print_usage(const char *command) {
+  printf("Usage: %s [-s <seed>] [-m <random|sobol|stratified>] [-n <strata>] [-L <log> | -R <log> [-F <samples>]] "
+         "[-W <width> -H <height>] [-c <schedule>] [-t <samples> | -q <quota>] [-d <duration>] [-k] [-p <file>] "
+         "[-x <directory>]\n",
+         command);
+  printf("Options:\n");
+  printf("  -s: seed of the scene sampler. Default is derived from the clock, it is printed and saved with labels.\n");
+  printf("  -m: sampling of the robot and ball positions. 'random' (default), 'sobol' or 'stratified'.\n");
+  printf("  -n: number of cells per axis of the 'stratified' mode. Default is 8.\n");
+  printf("  -L: record the scene writes of the run in a replay log.\n");
+  printf("  -R: replay a log instead of randomizing the scene.\n");
+  printf("  -F: samples captured by the replay, e.g. '3,10-12'. Default is all of them.\n");
+  printf("  -W, -H: camera resolution of the camera robots. Default is the resolution of the world.\n");
+  printf("  -c: capture schedule table. Default is 'capture_schedule.txt'.\n");
+  printf("  -t: quit the simulation once this many samples are captured, with exit status 0. A sample is one\n");
+  printf("      scene, captured for the frames of the schedule, e.g. one gesture cycle. Default is the\n");
+  printf("      WEREF_SAMPLES environment variable, or no target.\n");
+  printf("  -q: quit the simulation once each camera position captured its samples with the obstacle robot present\n");
+  printf("      and absent, given as '<left>,<middle>,<right>/<left>,<middle>,<right>'. The presence of each sample\n");
+  printf("      is drawn in proportion to the samples still needed, and only the camera robots whose quota is not\n");
+  printf("      reached capture it. Replaces -t, not used with -R. Default is the WEREF_QUOTA environment variable.\n");
+  printf("  -d: quit the simulation after this simulated duration [s], e.g. for benchmarks, with exit status 1 if\n");
+  printf("      the -t target is not reached. Default is the WEREF_DURATION environment variable, or no limit.\n");
+  printf("  -k: remove the physics of the robots, which then only move by teleports and motors.\n");
+  printf("  -p: profile results file, appended with the time per stage of the run. Default is the WEREF_PROFILE\n");
+  printf("      environment variable, or none. The profile is always printed.\n");
+  printf("  -x: metrics directory, where 'scene_director_<robot>.prom' is rewritten every 5 s in the Prometheus\n");
+  printf("      text format. Default is the WEREF_METRICS environment variable, or none.\n");
+}
+
+// ----------------------------------------------------------
+// Controller "main"
+// ----------------------------------------------------------
+int main(int argc, char **argv) {
+  wb_robot_init();
+  time_step = wb_robot_get_basic_time_step();
+
+  uint64_t seed = weref_sampler_default_seed();
+  WerefSamplerMode sampler_mode = WEREF_SAMPLER_RANDOM;
+  int strata = 8;
+  const char *record_path = NULL;
+  const char *replay_path = NULL;
+  int camera_width = 0, camera_height = 0;
+  const char *schedule_path = "capture_schedule.txt";
+  int target_samples = getenv("WEREF_SAMPLES") ? atoi(getenv("WEREF_SAMPLES")) : 0;
+  double duration = getenv("WEREF_DURATION") ? atof(getenv("WEREF_DURATION")) : 0.0;
+  const char *quota_text = getenv("WEREF_QUOTA");
+  profile_path = getenv("WEREF_PROFILE");
+  const char *metrics_directory = getenv("WEREF_METRICS");
+  bool kinematic = false;
+  int c;
+  while ((c = getopt(argc, argv, "s:m:n:L:R:F:W:H:c:t:q:d:kp:x:")) != -1) {
+    switch (c) {
+      case 's':
+        seed = strtoull(optarg, NULL, 0);
+        break;
+      case 'm':
+        if (weref_sampler_parse_mode(optarg) < 0) {
+          fprintf(stderr, "Unknown sampler mode `%s'.\n", optarg);
+          print_usage(argv[0]);
+          wb_robot_cleanup();
+          return 1;
+        }
+        sampler_mode = weref_sampler_parse_mode(optarg);
+        break;
+      case 'n':
+        strata = atoi(optarg);
+        break;
+      case 'L':
+        record_path = optarg;
+        break;
+      case 'R':
+        replay_path = optarg;
+        break;
+      case 'F':
+        if (!parse_sample_ranges(optarg)) {
+          fprintf(stderr, "Invalid sample list `%s'.\n", optarg);
+          print_usage(argv[0]);
+          wb_robot_cleanup();
+          return 1;
+        }
+        break;
+      case 'W':
+        camera_width = atoi(optarg);
+        break;
+      case 'H':
+        camera_height = atoi(optarg);
+        break;
+      case 'c':
+        schedule_path = optarg;
+        break;
+      case 't':
+        target_samples = atoi(optarg);
+        break;
+      case 'q':
+        quota_text = optarg;
+        break;
+      case 'd':
+        duration = atof(optarg);
+        break;
+      case 'k':
+        kinematic = true;
+        break;
+      case 'p':
+        profile_path = optarg;
+        break;
+      case 'x':
+        metrics_directory = optarg;
+        break;
+      default:
+        print_usage(argv[0]);
+        wb_robot_cleanup();
+        return 1;
+    }
+  }
+  struct timespec wall_start;
+  clock_gettime(CLOCK_MONOTONIC, &wall_start);
+  weref_stage_profile_start(&profile);
+  // hot-path trace of the run, when built with WEREF_TRACE_ENABLED
+  WEREF_TRACE_START(getenv("WEREF_TRACE"), "scene_director", wb_robot_get_name());
+
+  if (record_path && replay_path) {
+    fprintf(stderr, "Options -L and -R are exclusive.\n");
+    print_usage(argv[0]);
+    wb_robot_cleanup();
+    return 1;
+  }
+  if (quota_text && quota_text[0] && !replay_path && !parse_quota(quota_text)) {
+    fprintf(stderr, "Invalid quota `%s'.\n", quota_text);
+    print_usage(argv[0]);
+    wb_robot_cleanup();
+    return 1;
+  }
+
+  if (!read_world_labels()) {
+    wb_robot_cleanup();
+    return 1;
+  }
+
+  WerefReplayHeader header;
+  memset(&header, 0, sizeof(header));
+  if (replay_path) {
+    replay_log = weref_replay_log_open(replay_path, &header);
+    if (!replay_log) {
+      wb_robot_cleanup();
+      return 1;
+    }
+    if (header.time_step != time_step || strcmp(header.gesture, gesture) != 0 ||
+        strcmp(header.referee_model, refereeModel) != 0 || strcmp(header.background, background) != 0)
+      fprintf(stderr, "Warning: %s was recorded in another world (%s_%s, gesture %s, time step %d).\n", replay_path,
+              header.referee_model, header.background, header.gesture, header.time_step);
+    run_seed = header.seed;
+    printf("Replaying %s, recorded with seed %llu\n", replay_path, (unsigned long long)run_seed);
+  } else {
+    sampler = weref_sampler_new(sampler_mode, seed, strata);
+    side_area_table = weref_radial_table_new(C2_RADIUS, C1_RADIUS, SIDE_AREA_TABLE_SIZE, side_area_density);
+    run_seed = seed;
+    printf("Scene sampler seed: %llu\n", (unsigned long long)seed);
+    if (record_path) {
+      header.seed = seed;
+      header.time_step = time_step;
+      snprintf(header.gesture, sizeof(header.gesture), "%s", gesture);
+      snprintf(header.referee_model, sizeof(header.referee_model), "%s", refereeModel);
+      snprintf(header.background, sizeof(header.background), "%s", background);
+      replay_log = weref_replay_log_create(record_path, &header);
+      recording = replay_log != NULL;
+    }
+  }
+
+  if ((camera_width > 0 && camera_height > 0) || kinematic)
+    configure_robots(camera_width, camera_height, kinematic);
+
+  scene_handles_resolve(&scene);
+  weref_scene_state_reset(&scene_state);
+  for (int i = 0; i < WEREF_ROBOT_COUNT; i++) {
+    // initial poses, used by the ball placement until every robot has been randomized
+    if (scene.robots[i].translation) {
+      const double *translation = SUPERVISOR_CALL(wb_supervisor_field_get_sf_vec3f(scene.robots[i].translation));
+      scene_state.robots[i].x = translation[0];
+      scene_state.robots[i].y = translation[1];
+    }
+  }
+  set_obstacle_posture();
+
+  WerefSchedule schedule;
+  if (!replay_path && !load_schedule(schedule_path, &schedule)) {
+    wb_robot_cleanup();
+    return 1;
+  }
+
+  if (metrics_directory && metrics_directory[0])
+    open_metrics(metrics_directory);
+  int exit_status = EXIT_SUCCESS;
+  stage_start = weref_stage_clock();
+  if (replay_path)
+    run_replay();
+  else {
+    printf("Capture schedule: start %.2f s, period %.2f s, %d frames per sample, stride %d\n", schedule.start,
+           schedule.period, schedule.frames, schedule.stride);
+    const int start_step = step_index();
+    // checked after the step of the last captured frame, so that the camera robots have saved it
+    const int target_frames = target_samples * schedule.frames;
+    int captured_frames = 0, sample_frames = 0;
+    if (has_quota)
+      printf("Quota: %d samples with the obstacle robot and %d without it\n", quota_need(1), quota_need(0));
+    while (has_quota ? quota_need(0) + quota_need(1) > 0 : target_frames <= 0 || captured_frames < target_frames) {
+      if (duration > 0.0 && wb_robot_get_time() >= duration) {
+        if (has_quota) {
+          fprintf(stderr, "Error: %d samples with the obstacle robot and %d without it still missing after %.2f s.\n",
+                  quota_need(1), quota_need(0), duration);
+          exit_status = EXIT_FAILURE;
+        } else if (target_frames > 0) {
+          fprintf(stderr, "Error: %d of %d samples captured in %.2f s.\n", captured_frames / schedule.frames,
+                  target_samples, duration);
+          exit_status = EXIT_FAILURE;
+        }
+        break;
+      }
+      const int step = step_index() - start_step;
+      const int flags = weref_schedule_step(&schedule, step, time_step);
+      const int next_flags = weref_schedule_step(&schedule, step + 1, time_step);
+      const bool render = next_flags & WEREF_SCHEDULE_CAPTURE;
+      if (flags & WEREF_SCHEDULE_NEW_SAMPLE) {
+        randomize_scene();
+        sample_frames = 0;
+      }
+      if (flags & WEREF_SCHEDULE_CAPTURE) {
+        captured_frames++;
+        if (++sample_frames == schedule.frames && has_quota)
+          quota_count_sample();
+      }
+      if (sample_index >= 0 || render)
+        publish_scene(flags & WEREF_SCHEDULE_CAPTURE, render, next_flags & WEREF_SCHEDULE_NEW_SAMPLE);
+      end_stage(WEREF_STAGE_SUPERVISOR);
+
+      record_step();
+      end_stage(WEREF_STAGE_WRITE);
+      if (robot_step() == -1)
+        break;
+      end_stage(WEREF_STAGE_STEP);
+      if (has_quota)
+        weref_metrics_set(metrics, metric_samples_missing, quota_need(0) + quota_need(1));
+      else if (target_frames > 0)
+        weref_metrics_set(metrics, metric_samples_missing, (target_frames - captured_frames) / schedule.frames);
+      update_metrics();
+      scene_handles_end_step();
+    }
+    if (has_quota && quota_need(0) + quota_need(1) == 0)
+      printf("Captured the quota in %d samples and %.2f s\n", sample_index + 1, wb_robot_get_time());
+    else if (!has_quota && target_frames > 0 && captured_frames >= target_frames)
+      printf("Captured the %d target samples in %.2f s\n", target_samples, wb_robot_get_time());
+  }
+
+  struct timespec wall_end;
+  clock_gettime(CLOCK_MONOTONIC, &wall_end);
+  const double wall_time = (wall_end.tv_sec - wall_start.tv_sec) + (wall_end.tv_nsec - wall_start.tv_nsec) * 1e-9;
+  printf("Simulated %.2f s in %.2f s of wall-clock time (%.2f simulated seconds per second)\n", wb_robot_get_time(),
+         wall_time, wall_time > 0.0 ? wb_robot_get_time() / wall_time : 0.0);
+  weref_metrics_cleanup(metrics);
+  scene_handles_print_statistics();
+  weref_stage_profile_print(&profile, wb_robot_get_name(), wb_robot_get_time());
+  if (profile_path)
+    weref_stage_profile_append(profile_path, &profile, "scene_director", wb_robot_get_name(), wb_robot_get_time());
+  WEREF_TRACE_STOP();
+  weref_replay_log_cleanup(replay_log);
+  weref_radial_table_cleanup(side_area_table);
+  weref_sampler_cleanup(sampler);
+  // a replay ends with its log, and a capture with its duration, its target samples or its quota
+  if (replay_path || duration > 0.0 || target_samples > 0 || has_quota) {
+    // the camera robots flush their outputs when their step returns -1
+    wb_supervisor_simulation_quit(exit_status);
+    wb_robot_step(time_step);
+  }
+  wb_robot_cleanup();
+  return 0;
+}
@@ -0,0 +1,101 @@
+#include "scene_handles.h"
+
+#include <stdio.h>
+#include <string.h>
+
+int supervisor_call_count = 0;
+
+const char *const scene_robot_defs[WEREF_ROBOT_COUNT] = {"PLAYER_RED_2", "PLAYER_RED_3", "PLAYER_BLUE_4",
+                                                         "OBSTACLE_ROBOT"};
+
+// Per-step statistics
+static int resolve_call_count = 0;
+static long long step_call_total = 0;
+static int step_call_max = 0;
+static int step_count = 0;
+
+/**
+ * @brief Resolves a node and its pose fields. Missing nodes are reported and left NULL.
+ */
+static void resolve_node(SceneNode *scene_node, WbNodeRef node, const char *label) {
+  scene_node->node = node;
+  scene_node->translation = NULL;
+  scene_node->rotation = NULL;
+  scene_node->custom_data = NULL;
+  if (!node) {
+    fprintf(stderr, "Warning: Could not find node %s.\n", label);
+    return;
+  }
+  scene_node->translation = SUPERVISOR_CALL(wb_supervisor_node_get_field(node, "translation"));
+  scene_node->rotation    = SUPERVISOR_CALL(wb_supervisor_node_get_field(node, "rotation"));
+  if (!scene_node->translation || !scene_node->rotation)
+    fprintf(stderr, "Warning: Could not get translation/rotation for %s.\n", label);
+}
+
+/**
+ * @brief Resolves the customData field of a robot, used to publish the scene to its controller.
+ */
+static void resolve_robot(SceneNode *scene_node, const char *def_name) {
+  resolve_node(scene_node, SUPERVISOR_CALL(wb_supervisor_node_get_from_def(def_name)), def_name);
+  if (scene_node->node)
+    scene_node->custom_data = SUPERVISOR_CALL(wb_supervisor_node_get_field(scene_node->node, "customData"));
+}
+
+/**
+ * @brief Finds the referee, the robot running the 'bvh_animation' controller: its DEF name depends on the model.
+ */
+static WbNodeRef find_referee() {
+  WbFieldRef children = SUPERVISOR_CALL(wb_supervisor_node_get_field(wb_supervisor_node_get_root(), "children"));
+  const int count = SUPERVISOR_CALL(wb_supervisor_field_get_count(children));
+  for (int i = 0; i < count; i++) {
+    WbNodeRef node = SUPERVISOR_CALL(wb_supervisor_field_get_mf_node(children, i));
+    WbFieldRef controller = SUPERVISOR_CALL(wb_supervisor_node_get_field(node, "controller"));
+    if (controller && strcmp(SUPERVISOR_CALL(wb_supervisor_field_get_sf_string(controller)), "bvh_animation") == 0)
+      return node;
+  }
+  return NULL;
+}
+
+/**
+ * @brief Resolves every DEF node and field used by the randomizers. Must be called after wb_robot_init().
+ */
+void scene_handles_resolve(SceneHandles *handles) {
+  const int calls_before = supervisor_call_count;
+
+  for (int i = 0; i < WEREF_ROBOT_COUNT; i++)
+    resolve_robot(&handles->robots[i], scene_robot_defs[i]);
+  resolve_node(&handles->ball, SUPERVISOR_CALL(wb_supervisor_node_get_from_def("SOCCER_BALL")), "SOCCER_BALL");
+  resolve_node(&handles->referee, find_referee(), "referee");
+  if (handles->referee.node)
+    handles->referee.custom_data = SUPERVISOR_CALL(wb_supervisor_node_get_field(handles->referee.node, "customData"));
+
+  handles->light = SUPERVISOR_CALL(wb_supervisor_node_get_from_def("TEXTURED_BACKGROUND_LIGHT"));
+  handles->light_direction = NULL;
+  handles->light_luminosity = NULL;
+  if (handles->light) {
+    handles->light_direction  = SUPERVISOR_CALL(wb_supervisor_node_get_field(handles->light, "direction"));
+    handles->light_luminosity = SUPERVISOR_CALL(wb_supervisor_node_get_field(handles->light, "luminosity"));
+  }
+  if (!handles->light_direction || !handles->light_luminosity)
+    fprintf(stderr, "Warning: Could not get direction or luminosity fields of TEXTURED_BACKGROUND_LIGHT.\n");
+
+  // startup resolution is reported separately from the per-step traffic
+  resolve_call_count = supervisor_call_count - calls_before;
+  supervisor_call_count = calls_before;
+}
+
+/**
+ * @brief Accumulates the supervisor calls of the step that just ended.
+ */
+void scene_handles_end_step() {
+  step_call_total += supervisor_call_count;
+  if (supervisor_call_count > step_call_max)
+    step_call_max = supervisor_call_count;
+  supervisor_call_count = 0;
+  step_count++;
+}
+
+void scene_handles_print_statistics() {
+  printf("Supervisor API calls: %d at startup, %lld over %d steps (%.2f per step, max %d)\n", resolve_call_count,
+         step_call_total, step_count, step_count > 0 ? (double)step_call_total / step_count : 0.0, step_call_max);
+}
@@ -0,0 +1,43 @@
+#ifndef SCENE_HANDLES_H
+#define SCENE_HANDLES_H
+
+#include <webots/supervisor.h>
+#include <weref/scene_state.h>
+
+/**
+ * @brief Counts one supervisor API call and evaluates it.
+ *
+ * Every wb_supervisor_* call is a round-trip to the simulator, so all of them go through this macro to be
+ * accounted in the per-step statistics.
+ */
+#define SUPERVISOR_CALL(call) (supervisor_call_count++, (call))
+
+extern int supervisor_call_count;
+
+typedef struct SceneNode {
+  WbNodeRef node;
+  WbFieldRef translation;
+  WbFieldRef rotation;
+  WbFieldRef custom_data;  // robots only, the referee publishes its motion frame in it
+} SceneNode;
+
+/**
+ * @brief Supervisor handles of every node and field the randomizers touch, resolved once at startup.
+ */
+typedef struct SceneHandles {
+  SceneNode robots[WEREF_ROBOT_COUNT];  // indexed by WerefRobotId
+  SceneNode ball;
+  SceneNode referee;
+  WbNodeRef light;
+  WbFieldRef light_direction;
+  WbFieldRef light_luminosity;
+} SceneHandles;
+
+extern const char *const scene_robot_defs[WEREF_ROBOT_COUNT];
+
+void scene_handles_resolve(SceneHandles *handles);
+
+void scene_handles_end_step();
+void scene_handles_print_statistics();
+
+#endif  // SCENE_HANDLES_H
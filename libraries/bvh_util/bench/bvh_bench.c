@@ -0,0 +1,369 @@
+/*
+ * Description:   Microbenchmark of the bvh_util library, built and run outside of Webots. For each BVH file, and for
+ *                a synthetic file repeating the frames of the first one, it measures:
+ *                - the parse throughput of wbu_bvh_read_file(), in MB/s and frames/s,
+ *                - the heap allocations of a parse: calls, bytes and peak live bytes, counted by wrapping malloc(),
+ *                  calloc(), realloc() and free() at link time,
+ *                - the cost of wbu_bvh_step() and of wbu_bvh_goto_frame() to random frames,
+ *                - the latency of wbu_bvh_get_joint_rotation() for each joint, over all the frames of the motion.
+ *                The results are written as JSON, so that runs can be compared to catch regressions.
+ */
+
+#define _GNU_SOURCE  // malloc_usable_size()
+
+#include <malloc.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <webots/bvh_util.h>
+
+#define DEFAULT_SYNTHETIC_FRAMES 100000
+#define DEFAULT_MIN_TIME 0.2  // [s] per measure
+#define MAX_LINE 4096
+#define MAX_JOINTS 128
+
+typedef struct AllocationCounts {
+  long long calls;  // malloc(), calloc() and realloc() calls
+  long long frees;
+  long long bytes;  // allocated bytes, the usable size of the blocks
+  long long live;   // live bytes
+  long long peak;   // peak of the live bytes
+} AllocationCounts;
+
+typedef struct BenchResult {
+  char name[256];
+  long long file_bytes;
+  int frames;
+  int joints;
+  int parse_runs;
+  double parse_seconds;  // best run
+  AllocationCounts allocations;
+  double step_ns;
+  double goto_frame_ns;
+  double rotation_ns;  // mean over the joints
+  double rotation_joint_ns[MAX_JOINTS];
+} BenchResult;
+
+static AllocationCounts allocations;
+static double min_time = DEFAULT_MIN_TIME;
+static volatile double sink;  // keeps the measured calls from being optimized out
+
+//***********************************//
+//        Allocation counting        //
+//***********************************//
+
+// Linked with -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=free: the calls of bvh_util and of this
+// benchmark go through these functions.
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *pointer, size_t size);
+void __real_free(void *pointer);
+
+static void count_allocation(void *pointer) {
+  if (!pointer)
+    return;
+  const long long size = malloc_usable_size(pointer);
+  allocations.calls++;
+  allocations.bytes += size;
+  allocations.live += size;
+  if (allocations.live > allocations.peak)
+    allocations.peak = allocations.live;
+}
+
+void *__wrap_malloc(size_t size) {
+  void *pointer = __real_malloc(size);
+  count_allocation(pointer);
+  return pointer;
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+  void *pointer = __real_calloc(count, size);
+  count_allocation(pointer);
+  return pointer;
+}
+
+void *__wrap_realloc(void *pointer, size_t size) {
+  if (pointer)
+    allocations.live -= malloc_usable_size(pointer);
+  void *new_pointer = __real_realloc(pointer, size);
+  if (!new_pointer && pointer && size > 0)
+    allocations.live += malloc_usable_size(pointer);  // the block is unchanged
+  count_allocation(new_pointer);
+  return new_pointer;
+}
+
+void __wrap_free(void *pointer) {
+  if (!pointer)
+    return;
+  allocations.frees++;
+  allocations.live -= malloc_usable_size(pointer);
+  __real_free(pointer);
+}
+
+//***********************************//
+//        Utility functions          //
+//***********************************//
+
+static double now() {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+static long long file_size(const char *path) {
+  FILE *file = fopen(path, "rb");
+  if (!file)
+    return -1;
+  fseek(file, 0, SEEK_END);
+  const long long size = ftell(file);
+  fclose(file);
+  return size;
+}
+
+// Writes a copy of the BVH file 'template_path' with 'frames' frames, repeating its own. Returns false on error.
+static bool write_synthetic_file(const char *template_path, int frames, const char *path) {
+  FILE *input = fopen(template_path, "r");
+  if (!input) {
+    fprintf(stderr, "Error: could not open '%s'.\n", template_path);
+    return false;
+  }
+  FILE *output = fopen(path, "w");
+  if (!output) {
+    fprintf(stderr, "Error: could not create '%s'.\n", path);
+    fclose(input);
+    return false;
+  }
+  char line[MAX_LINE];
+  char **motion_lines = NULL;
+  int motion_line_count = 0;
+  bool in_motion = false;
+  while (fgets(line, sizeof(line), input)) {
+    if (in_motion) {
+      if (strspn(line, " \t\r\n") == strlen(line))
+        continue;
+      // the last frame of a file may have no line break
+      line[strcspn(line, "\r\n")] = '\0';
+      motion_lines = realloc(motion_lines, (motion_line_count + 1) * sizeof(char *));
+      motion_lines[motion_line_count++] = strdup(line);
+    } else if (strncmp(line, "Frames:", 7) == 0)
+      fprintf(output, "Frames: %d\n", frames);
+    else {
+      fputs(line, output);
+      in_motion = strncmp(line, "Frame Time:", 11) == 0;
+    }
+  }
+  for (int i = 0; i < frames && motion_line_count > 0; i++)
+    fprintf(output, "%s\n", motion_lines[i % motion_line_count]);
+  for (int i = 0; i < motion_line_count; i++)
+    free(motion_lines[i]);
+  free(motion_lines);
+  fclose(input);
+  const bool success = fclose(output) == 0 && motion_line_count > 0;
+  if (motion_line_count == 0)
+    fprintf(stderr, "Error: '%s' has no frames.\n", template_path);
+  return success;
+}
+
+// Number of repetitions of a call measured in about 'min_time', from the duration of 'calibration' calls
+static long long repetitions(double calibration_seconds, long long calibration_calls) {
+  const double per_call = calibration_seconds / calibration_calls;
+  const long long count = per_call > 0.0 ? (long long)(min_time / per_call) : calibration_calls;
+  return count > calibration_calls ? count : calibration_calls;
+}
+
+//***********************************//
+//            Benchmarks             //
+//***********************************//
+
+static WbuBvhMotion bench_parse(const char *path, BenchResult *result) {
+  WbuBvhMotion motion = NULL;
+  result->parse_seconds = 0.0;
+  result->parse_runs = 0;
+  double total = 0.0;
+  // the last run is kept for the other measures, its allocations are counted
+  while (result->parse_runs == 0 || total < min_time) {
+    if (motion)
+      wbu_bvh_cleanup(motion);
+    memset(&allocations, 0, sizeof(allocations));
+    const double start = now();
+    motion = wbu_bvh_read_file(path);
+    const double seconds = now() - start;
+    if (!motion)
+      return NULL;
+    total += seconds;
+    if (result->parse_runs == 0 || seconds < result->parse_seconds)
+      result->parse_seconds = seconds;
+    result->parse_runs++;
+  }
+  result->allocations = allocations;
+  return motion;
+}
+
+static void bench_motion(WbuBvhMotion motion, BenchResult *result) {
+  const int frames = result->frames;
+  const int joints = result->joints < MAX_JOINTS ? result->joints : MAX_JOINTS;
+
+  // wbu_bvh_step()
+  long long count = 1000;
+  double start = now();
+  for (long long i = 0; i < count; i++)
+    wbu_bvh_step(motion);
+  count = repetitions(now() - start, count);
+  start = now();
+  for (long long i = 0; i < count; i++)
+    wbu_bvh_step(motion);
+  result->step_ns = 1e9 * (now() - start) / count;
+  sink = wbu_bvh_get_frame_index(motion);
+
+  // wbu_bvh_goto_frame() to pseudo-random frames
+  int *targets = malloc(4096 * sizeof(int));
+  uint64_t state = 0x9e3779b97f4a7c15ULL;
+  for (int i = 0; i < 4096; i++) {
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    targets[i] = (int)((state >> 33) % frames);
+  }
+  count = 4096;
+  start = now();
+  for (long long i = 0; i < count; i++)
+    wbu_bvh_goto_frame(motion, targets[i & 4095]);
+  count = repetitions(now() - start, count);
+  start = now();
+  for (long long i = 0; i < count; i++)
+    wbu_bvh_goto_frame(motion, targets[i & 4095]);
+  result->goto_frame_ns = 1e9 * (now() - start) / count;
+  free(targets);
+
+  // wbu_bvh_get_joint_rotation(): the first frame stores the T pose of each joint, as in the controller
+  wbu_bvh_goto_frame(motion, 0);
+  for (int j = 0; j < joints; j++)
+    sink = wbu_bvh_get_joint_rotation(motion, j)[3];
+  const int first = frames > 1 ? 1 : 0;
+  double total = 0.0;
+  for (int j = 0; j < joints; j++) {
+    long long calls = 0;
+    start = now();
+    do {
+      for (int f = first; f < frames; f++) {
+        wbu_bvh_goto_frame(motion, f);
+        sink = wbu_bvh_get_joint_rotation(motion, j)[3];
+      }
+      calls += frames - first;
+    } while (now() - start < min_time / joints);
+    result->rotation_joint_ns[j] = 1e9 * (now() - start) / calls;
+    total += result->rotation_joint_ns[j];
+  }
+  result->rotation_ns = joints > 0 ? total / joints : 0.0;
+}
+
+static bool bench_file(const char *path, const char *name, BenchResult *result) {
+  memset(result, 0, sizeof(BenchResult));
+  snprintf(result->name, sizeof(result->name), "%s", name);
+  result->file_bytes = file_size(path);
+  WbuBvhMotion motion = bench_parse(path, result);
+  if (!motion)
+    return false;
+  result->frames = wbu_bvh_get_frame_count(motion);
+  result->joints = wbu_bvh_get_joint_count(motion);
+  if (result->frames > 0)
+    bench_motion(motion, result);
+  wbu_bvh_cleanup(motion);
+  return true;
+}
+
+static void write_result(FILE *file, const BenchResult *result, bool last) {
+  const double megabytes = result->file_bytes / 1e6;
+  fprintf(file, "    {\n      \"file\": \"%s\",\n      \"bytes\": %lld,\n", result->name, result->file_bytes);
+  fprintf(file, "      \"frames\": %d,\n      \"joints\": %d,\n", result->frames, result->joints);
+  fprintf(file, "      \"parse\": {\"runs\": %d, \"seconds\": %.9f, \"mb_per_s\": %.3f, \"frames_per_s\": %.1f},\n",
+          result->parse_runs, result->parse_seconds, megabytes / result->parse_seconds,
+          result->frames / result->parse_seconds);
+  fprintf(file,
+          "      \"parse_allocations\": {\"calls\": %lld, \"frees\": %lld, \"bytes\": %lld, \"peak_bytes\": %lld, "
+          "\"retained_bytes\": %lld},\n",
+          result->allocations.calls, result->allocations.frees, result->allocations.bytes, result->allocations.peak,
+          result->allocations.live);
+  fprintf(file, "      \"step_ns\": %.3f,\n      \"goto_frame_ns\": %.3f,\n", result->step_ns, result->goto_frame_ns);
+  fprintf(file, "      \"joint_rotation_ns\": %.3f,\n      \"joint_rotation_ns_per_joint\": [", result->rotation_ns);
+  for (int j = 0; j < result->joints && j < MAX_JOINTS; j++)
+    fprintf(file, j ? ", %.3f" : "%.3f", result->rotation_joint_ns[j]);
+  fprintf(file, "]\n    }%s\n", last ? "" : ",");
+}
+
+static void print_usage(const char *command) {
+  printf("Usage: %s [-n <frames>] [-t <seconds>] [-o <results.json>] <file.bvh>...\n", command);
+  printf("Options:\n");
+  printf("  -n: frames of the synthetic file, made of the frames of the first file repeated. Default is %d, 0 for\n",
+         DEFAULT_SYNTHETIC_FRAMES);
+  printf("      none.\n");
+  printf("  -t: minimum duration of each measure [s]. Default is %g.\n", DEFAULT_MIN_TIME);
+  printf("  -o: write the results to this file instead of the standard output.\n");
+}
+
+int main(int argc, char **argv) {
+  int synthetic_frames = DEFAULT_SYNTHETIC_FRAMES;
+  const char *output_path = NULL;
+  int c;
+  while ((c = getopt(argc, argv, "n:t:o:")) != -1) {
+    switch (c) {
+      case 'n':
+        synthetic_frames = atoi(optarg);
+        break;
+      case 't':
+        min_time = atof(optarg);
+        break;
+      case 'o':
+        output_path = optarg;
+        break;
+      default:
+        print_usage(argv[0]);
+        return 1;
+    }
+  }
+  const int file_count = argc - optind;
+  if (file_count < 1 || synthetic_frames < 0 || min_time <= 0.0) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  const int result_count = file_count + (synthetic_frames > 0);
+  BenchResult *results = malloc(result_count * sizeof(BenchResult));
+  int n = 0;
+  for (int i = 0; i < file_count; i++) {
+    fprintf(stderr, "Benchmarking %s\n", argv[optind + i]);
+    if (bench_file(argv[optind + i], argv[optind + i], &results[n]))
+      n++;
+  }
+  if (synthetic_frames > 0) {
+    char path[] = "/tmp/bvh_bench_XXXXXX";
+    const int fd = mkstemp(path);
+    if (fd < 0)
+      fprintf(stderr, "Error: could not create a temporary file.\n");
+    else {
+      close(fd);
+      char name[256];
+      snprintf(name, sizeof(name), "synthetic_%d_frames", synthetic_frames);
+      fprintf(stderr, "Benchmarking %s\n", name);
+      if (write_synthetic_file(argv[optind], synthetic_frames, path) && bench_file(path, name, &results[n]))
+        n++;
+      unlink(path);
+    }
+  }
+
+  FILE *output = output_path ? fopen(output_path, "w") : stdout;
+  if (!output) {
+    fprintf(stderr, "Error: could not create '%s'.\n", output_path);
+    free(results);
+    return 1;
+  }
+  fprintf(output, "{\n  \"benchmark\": \"bvh_util\",\n  \"min_time\": %g,\n  \"results\": [\n", min_time);
+  for (int i = 0; i < n; i++)
+    write_result(output, &results[i], i == n - 1);
+  fprintf(output, "  ]\n}\n");
+  if (output_path)
+    fclose(output);
+  free(results);
+  return n == result_count ? 0 : 1;
+}
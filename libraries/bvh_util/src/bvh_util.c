@@ -23,6 +23,13 @@
 #include <stdlib.h>
 #include <string.h>
 
+// hot-path tracing, only built with WEREF_TRACE_ENABLED: bvh_util does not depend on weref_util otherwise
+#ifdef WEREF_TRACE_ENABLED
+#include <weref/trace.h>
+#else
+#define WEREF_TRACE_SCOPE(name) ((void)0)
+#endif
+
 #define MAX_LINE 4096
 #define D2R (((double)M_PI) / 180.0)
 const char DELIM[] = " :,\t\r\n";
@@ -192,6 +199,7 @@ static BvhMotionJointPrivate_t *add_new_joint(FILE *file, WbuBvhMotion motion, c
 }
 
 static void read_motion(FILE *file, WbuBvhMotion motion, int frame_channels_count) {
+  WEREF_TRACE_SCOPE("bvh_read_motion");
   int n_frames = motion->n_frames;
   const char *token;
   int joint_index;
@@ -295,6 +303,7 @@ static void compute_bone_vectors(WbuBvhMotion motion) {
 //***********************************//
 
 WbuBvhMotion wbu_bvh_read_file(const char *filename) {
+  WEREF_TRACE_SCOPE("wbu_bvh_read_file");
   // initialize the motion structure
   WbuBvhMotion motion = malloc(sizeof(WbuBvhMotionPrivate_t));
   motion->n_joints = 0;
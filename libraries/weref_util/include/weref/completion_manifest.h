@@ -0,0 +1,54 @@
+/*
+ * Description:   Completion manifest of a collection, shared by all its runs: the samples and frames captured in each
+ *                gesture x world x cloth x presence x camera position cell, i.e. each folder of the dataset tree.
+ *                Each camera robot appends the progress of its cells for the run of a given seed, so a restarted
+ *                collection only schedules the missing samples. Tab-separated lines, appended in single writes so
+ *                that concurrent runs can share the file:
+ *                  <gesture> <world> <cloth> <presence> <position> <seed> <samples> <frames> <status>
+ *                The records of a run are cumulative, its last one counts. The status is 'running' while the run
+ *                captures and 'finished' once it stopped cleanly.
+ */
+
+#ifndef WEREF_COMPLETION_MANIFEST_H
+#define WEREF_COMPLETION_MANIFEST_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct WerefCompletionRecord {
+  char gesture[128];
+  char world[256];    // '<referee model>_<background>', the name of the world file
+  char cloth[32];
+  char presence[32];  // presence label of the obstacle robot: presence_robot or presence_norobot
+  char position[16];  // label of the camera robot: left, middle or right
+  uint64_t seed;      // seed of the scene sampler of the run
+  int samples;        // complete samples captured by the run
+  int frames;         // frames saved by the run
+  bool finished;      // whether the run stopped cleanly
+} WerefCompletionRecord;
+
+// Appends 'record' to the manifest at 'path', created if needed.
+bool weref_completion_manifest_append(const char *path, const WerefCompletionRecord *record);
+
+typedef struct WerefCompletionManifestPrivate *WerefCompletionManifest;
+
+// Reads the manifest at 'path'. A missing file gives an empty manifest. Returns NULL on error.
+WerefCompletionManifest weref_completion_manifest_load(const char *path);
+void weref_completion_manifest_cleanup(WerefCompletionManifest manifest);
+
+// Sums the samples and frames of a cell over its runs, each one counted by its last record. A NULL 'cloth' or
+// 'presence' sums the cells of every cloth or presence. Returns the number of runs, i.e. of distinct seeds, 0 if the
+// cell has none.
+int weref_completion_manifest_get(const WerefCompletionManifest manifest, const char *gesture, const char *world,
+                                  const char *cloth, const char *presence, const char *position, int *samples,
+                                  int *frames);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // WEREF_COMPLETION_MANIFEST_H
@@ -0,0 +1,46 @@
+/*
+ * Description:   Dataset output backends for captured frames.
+ *                The 'tree' backend keeps the historical one-file-per-frame directory layout, the 'shard' backend
+ *                appends frames to fixed-size tar shards (WebDataset style) with a sidecar offset index.
+ */
+
+#ifndef WEREF_DATASET_WRITER_H
+#define WEREF_DATASET_WRITER_H
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum { WEREF_OUTPUT_TREE = 0, WEREF_OUTPUT_SHARD } WerefOutputMode;
+
+typedef struct WerefDatasetWriterPrivate *WerefDatasetWriter;
+
+// 'root' is the dataset root directory, 'shard_prefix' names the shard files of this writer (shard mode only) and
+// 'shard_size' is the approximate maximum size of a shard in bytes. Both names are limited to 255 characters.
+WerefDatasetWriter weref_dataset_writer_new(WerefOutputMode mode, const char *root, const char *shard_prefix,
+                                            long shard_size);
+void weref_dataset_writer_cleanup(WerefDatasetWriter writer);
+
+// Returns the path the caller should write the encoded sample to, e.g. with wb_camera_save_image().
+// 'key' is the label path of the sample relative to the root (without extension) and 'extension' includes the dot.
+// The returned string is valid until the next call. Returns NULL if the key with its extension exceeds 639
+// characters, the next commit then fails.
+const char *weref_dataset_writer_begin(WerefDatasetWriter writer, const char *key, const char *extension);
+// Publishes the sample written at the path returned by the last weref_dataset_writer_begin() call.
+bool weref_dataset_writer_commit(WerefDatasetWriter writer);
+
+// Returns the WerefOutputMode matching 'name' ("tree" or "shard"), -1 if unknown.
+int weref_dataset_writer_parse_mode(const char *name);
+int weref_dataset_writer_get_sample_count(const WerefDatasetWriter writer);
+long long weref_dataset_writer_get_bytes_written(const WerefDatasetWriter writer);
+
+// Creates 'path' and all its missing parents, like 'mkdir -p'.
+bool weref_make_directories(const char *path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // WEREF_DATASET_WRITER_H
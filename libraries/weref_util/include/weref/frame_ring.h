@@ -0,0 +1,67 @@
+/*
+ * Description:   Single-producer single-consumer ring of captured frames in POSIX shared memory.
+ *                The capture controller copies each camera image and its label record into the next free slot, a
+ *                local consumer process maps the same ring and reads the slots in place, so frames reach a training
+ *                job without going through the disk. Slots are handed over with two atomic counters, no lock is
+ *                taken on either side.
+ */
+
+#ifndef WEREF_FRAME_RING_H
+#define WEREF_FRAME_RING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "label_manifest.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Header of a frame slot, followed by 'size' bytes of BGRA pixels as returned by wb_camera_get_image()
+typedef struct WerefFrameHeader {
+  WerefLabelRecord label;
+  int width;
+  int height;
+  uint32_t size;
+} WerefFrameHeader;
+
+typedef struct WerefFrameRingPrivate *WerefFrameRing;
+
+// Creates the ring 'name' (e.g. "/weref_left") with 'slot_count' slots holding frames of up to 'max_frame_size'
+// bytes, replacing any stale ring of the same name. The producer unlinks the ring on cleanup, a consumer that mapped
+// it keeps reading the remaining frames.
+WerefFrameRing weref_frame_ring_create(const char *name, int slot_count, size_t max_frame_size);
+// Maps an existing ring as its consumer. Returns NULL if the ring does not exist (yet).
+WerefFrameRing weref_frame_ring_open(const char *name);
+void weref_frame_ring_cleanup(WerefFrameRing ring);
+
+// Producer: returns the next free slot, waiting up to 'timeout_ms' for the consumer to release one. Returns NULL if
+// the ring is still full, the frame is then counted as dropped. The pixels go to weref_frame_ring_data().
+WerefFrameHeader *weref_frame_ring_begin_write(WerefFrameRing ring, int timeout_ms);
+// Producer: publishes the slot returned by the last weref_frame_ring_begin_write() call.
+void weref_frame_ring_end_write(WerefFrameRing ring);
+
+// Consumer: returns the oldest published slot, NULL if there is none. The slot stays valid and untouched by the
+// producer until weref_frame_ring_end_read().
+const WerefFrameHeader *weref_frame_ring_begin_read(WerefFrameRing ring);
+// Consumer: releases the slot returned by the last weref_frame_ring_begin_read() call.
+void weref_frame_ring_end_read(WerefFrameRing ring);
+
+// Pixels of a frame slot
+static inline unsigned char *weref_frame_ring_data(const WerefFrameHeader *frame) {
+  return (unsigned char *)(frame + 1);
+}
+
+// Whether the producer has cleaned up the ring: no frame will be published anymore.
+bool weref_frame_ring_is_closed(const WerefFrameRing ring);
+size_t weref_frame_ring_get_max_frame_size(const WerefFrameRing ring);
+long long weref_frame_ring_get_dropped_count(const WerefFrameRing ring);
+// Frames published and not released by the consumer yet
+int weref_frame_ring_get_depth(const WerefFrameRing ring);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // WEREF_FRAME_RING_H
@@ -0,0 +1,49 @@
+/*
+ * Description:   Append-only CSV manifest with one label record per captured frame.
+ *                Records are formatted in memory and written to disk in batches.
+ */
+
+#ifndef WEREF_LABEL_MANIFEST_H
+#define WEREF_LABEL_MANIFEST_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "referee_pose.h"
+#include "roi_crop.h"
+#include "scene_state.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WEREF_LABEL_KEY_LENGTH 512  // size of a key with its terminating NUL
+
+typedef struct WerefLabelRecord {
+  char key[WEREF_LABEL_KEY_LENGTH];  // label path of the sample relative to the dataset root, without extension
+  char camera[16];   // name of the camera device
+  int step;          // simulation step index
+  double time;       // simulation time [s]
+  uint64_t seed;     // seed of the scene sampler of the run
+  int sample;        // index of the randomized scene the frame belongs to
+  int phase;         // index of the frame within its sample, i.e. gesture phase since the last randomization
+  WerefSceneState scene;
+  WerefBoundingBox referee_box;  // box of the referee in the frame, projected from its bones
+  WerefRoi roi;                  // region of the frame saved as the referee crop, empty if none
+} WerefLabelRecord;
+
+typedef struct WerefLabelManifestPrivate *WerefLabelManifest;
+
+// Records are written to 'path' every 'flush_interval' records and on cleanup.
+WerefLabelManifest weref_label_manifest_new(const char *path, int flush_interval);
+void weref_label_manifest_cleanup(WerefLabelManifest manifest);
+
+void weref_label_manifest_append(WerefLabelManifest manifest, const WerefLabelRecord *record);
+bool weref_label_manifest_flush(WerefLabelManifest manifest);
+// Records appended and not written yet
+int weref_label_manifest_get_pending_count(const WerefLabelManifest manifest);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // WEREF_LABEL_MANIFEST_H
@@ -0,0 +1,50 @@
+/*
+ * Description:   Live counters and gauges of a running controller, written periodically in the Prometheus text
+ *                format to '<directory>/<controller>_<robot>.prom', e.g. for the node_exporter textfile collector or
+ *                a watchdog of the collection. The file is written to a temporary file renamed over the previous
+ *                one, so a reader never sees a partial file. Each sample is labelled with the controller and the
+ *                robot, and the file ends with the wall-clock time of its write, which stops moving when the
+ *                controller stalls.
+ *
+ *                Summaries report the 0.5, 0.9 and 0.99 quantiles of the values observed since the previous write,
+ *                and the cumulative sum and count. Every function is a no-op on a NULL 'metrics', so that the
+ *                controllers update them unconditionally.
+ */
+
+#ifndef WEREF_METRICS_H
+#define WEREF_METRICS_H
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum { WEREF_METRIC_COUNTER = 0, WEREF_METRIC_GAUGE, WEREF_METRIC_SUMMARY } WerefMetricType;
+
+typedef struct WerefMetricsPrivate *WerefMetrics;
+
+// The metrics are written every 'interval' wall-clock seconds by weref_metrics_update() and on cleanup.
+WerefMetrics weref_metrics_new(const char *directory, const char *controller, const char *robot, double interval);
+void weref_metrics_cleanup(WerefMetrics metrics);
+
+// Registers a metric named 'name' (e.g. "weref_frames_saved_total"), described by 'help'. Returns its id, -1 on error.
+int weref_metrics_register(WerefMetrics metrics, WerefMetricType type, const char *name, const char *help);
+// Replaces the additional labels of a metric, 'count' name and value pairs, e.g. the labels of the current cell.
+void weref_metrics_set_labels(WerefMetrics metrics, int id, const char *const *labels, int count);
+
+// Counters and gauges. A counter can be set to a total kept elsewhere, e.g. the bytes written by the dataset writer.
+void weref_metrics_add(WerefMetrics metrics, int id, double value);
+void weref_metrics_set(WerefMetrics metrics, int id, double value);
+// Summaries
+void weref_metrics_observe(WerefMetrics metrics, int id, double value);
+
+// Writes the metrics if 'interval' elapsed since their last write. Returns false if the write failed.
+bool weref_metrics_update(WerefMetrics metrics);
+bool weref_metrics_write(WerefMetrics metrics);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // WEREF_METRICS_H
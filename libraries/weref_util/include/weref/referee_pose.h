@@ -0,0 +1,67 @@
+/*
+ * Description:   Pose of the referee published by the 'bvh_animation' controller in its customData field, and its
+ *                projection into a camera to label a frame with the referee's 2D bounding box and keypoints.
+ *                Wire format: "<motion frame> <bone count> x y z ... <keypoint count> name bone ...", Skin bone
+ *                positions in world coordinates [m], then the BVH joint names of the bones they animate, with the
+ *                index of the bone whose position is the keypoint.
+ */
+
+#ifndef WEREF_REFEREE_POSE_H
+#define WEREF_REFEREE_POSE_H
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WEREF_REFEREE_MAX_BONES 128
+#define WEREF_REFEREE_MAX_KEYPOINTS 96
+#define WEREF_KEYPOINT_NAME_LENGTH 32
+#define WEREF_REFEREE_POSE_MAX_LENGTH \
+  (48 + WEREF_REFEREE_MAX_BONES * 3 * 12 + WEREF_REFEREE_MAX_KEYPOINTS * (WEREF_KEYPOINT_NAME_LENGTH + 12))
+
+typedef struct WerefRefereePose {
+  int frame;  // index of the displayed BVH motion frame
+  int bone_count;
+  double bones[WEREF_REFEREE_MAX_BONES][3];  // Skin bone positions
+  int keypoint_count;
+  char keypoint_names[WEREF_REFEREE_MAX_KEYPOINTS][WEREF_KEYPOINT_NAME_LENGTH];  // BVH joint names, without spaces
+  int keypoint_bones[WEREF_REFEREE_MAX_KEYPOINTS];                             // their indices in 'bones'
+} WerefRefereePose;
+
+// Bounding box of the referee in a camera image [pixels], clipped to the image. A referee that is not visible has an
+// empty box.
+typedef struct WerefBoundingBox {
+  double x_min;
+  double y_min;
+  double x_max;
+  double y_max;
+  int visible;    // 1 if part of the box is inside the image, 0 otherwise, -1 if the referee pose is unknown
+  int truncated;  // 1 if the box was clipped by the image borders or part of the referee is behind the camera
+} WerefBoundingBox;
+
+// Writes 'pose' to 'buffer' of 'size' bytes. Returns false if it does not fit.
+bool weref_referee_pose_encode(const WerefRefereePose *pose, char *buffer, int size);
+// Parses a pose written by weref_referee_pose_encode(). Missing trailing sections give a pose without bones or
+// keypoints.
+bool weref_referee_pose_decode(const char *text, WerefRefereePose *pose);
+
+// Projects the world point 'point' into a camera, see weref_referee_pose_project(). Writes its camera frame
+// coordinates (forward, left, up) [m] to 'camera_point' and its image coordinates [pixels] to 'pixel'. Returns true if
+// the point is in front of the camera and inside the image.
+bool weref_project_point(const double camera_pose[16], double fov, int width, int height, const double point[3],
+                         double camera_point[3], double pixel[2]);
+
+// Projects the bones of 'pose' into a camera of 'width' x 'height' pixels and horizontal field of view 'fov' [rad]
+// placed at 'camera_pose', its 4x4 row-major world pose as returned by wb_supervisor_node_get_pose(). Webots cameras
+// look along their x axis, with y to the left and z up. Bones are joint centers, so each one is padded by 'radius'
+// [m] to cover the body around it. Occlusions by other objects are not taken into account.
+void weref_referee_pose_project(const WerefRefereePose *pose, const double camera_pose[16], double fov, int width,
+                                int height, double radius, WerefBoundingBox *box);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // WEREF_REFEREE_POSE_H
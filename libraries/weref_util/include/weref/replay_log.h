@@ -0,0 +1,63 @@
+/*
+ * Description:   Binary replay log of the scene writes of a run.
+ *                A step block is only stored for the steps that write something or change the sample or the capture
+ *                state, so a run only takes a few kilobytes. Values are stored in host byte order.
+ */
+
+#ifndef WEREF_REPLAY_LOG_H
+#define WEREF_REPLAY_LOG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WEREF_REPLAY_MAX_VALUES 6
+
+typedef struct WerefReplayHeader {
+  uint64_t seed;  // seed of the scene sampler of the recorded run
+  int time_step;  // basic time step [ms]
+  char gesture[128];  // labels of the run, as large as the ones of the scene director
+  char referee_model[128];
+  char background[128];
+} WerefReplayHeader;
+
+typedef struct WerefReplayStep {
+  int step;          // simulation step index, i.e. simulation time / time step
+  int sample;        // index of the randomized scene
+  int capture;       // 1 if the camera robots save their frames from this step on
+  int motion_frame;  // frame of the referee motion, -1 if unknown
+} WerefReplayStep;
+
+typedef struct WerefReplayWrite {
+  int field;   // caller-defined field identifier
+  int target;  // caller-defined node identifier
+  int count;   // number of values
+  double values[WEREF_REPLAY_MAX_VALUES];
+} WerefReplayWrite;
+
+typedef struct WerefReplayLogPrivate *WerefReplayLog;
+
+// Recording: creates 'path', overwriting it.
+WerefReplayLog weref_replay_log_create(const char *path, const WerefReplayHeader *header);
+// Replay: opens 'path' and reads its header.
+WerefReplayLog weref_replay_log_open(const char *path, WerefReplayHeader *header);
+void weref_replay_log_cleanup(WerefReplayLog log);
+
+// Queues a write of the current step.
+void weref_replay_log_write(WerefReplayLog log, int field, int target, const double *values, int count);
+// Stores the queued writes of the step, if any, or the step alone if its sample or capture state changed.
+bool weref_replay_log_end_step(WerefReplayLog log, const WerefReplayStep *step);
+
+// Reads the next stored step and its writes, which remain valid until the next call. Returns false at the end of
+// the log.
+bool weref_replay_log_next_step(WerefReplayLog log, WerefReplayStep *step, const WerefReplayWrite **writes,
+                                int *n_writes);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // WEREF_REPLAY_LOG_H
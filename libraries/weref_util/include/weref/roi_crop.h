@@ -0,0 +1,58 @@
+/*
+ * Description:   Fixed-size crops of a camera image around a region of interest, e.g. the referee's bounding box, and
+ *                their encoding. Images are JPEG, or binary PPM when the library is built with WEREF_USE_LIBJPEG=0.
+ */
+
+#ifndef WEREF_ROI_CROP_H
+#define WEREF_ROI_CROP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "referee_pose.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Square region of a camera image [pixels]. It may extend past the image borders, the crop is black there.
+typedef struct WerefRoi {
+  double x;     // left border
+  double y;     // top border
+  double size;  // side, 0 if there is no region
+} WerefRoi;
+
+// Square region centered on 'box', with a side of the largest box side plus 'padding' times it on each side.
+// The region is empty if the box is not visible.
+void weref_roi_from_box(const WerefBoundingBox *box, double padding, WerefRoi *roi);
+
+// Resamples 'roi' of a 'width' x 'height' BGRA image, as returned by wb_camera_get_image(), to a 'size' x 'size' RGB
+// image written to 'rgb' (3 * size * size bytes), with bilinear filtering.
+void weref_roi_crop(const unsigned char *bgra, int width, int height, const WerefRoi *roi, int size,
+                    unsigned char *rgb);
+
+// Converts a 'width' x 'height' BGRA image, as returned by wb_camera_get_image(), to RGB (3 * width * height bytes).
+void weref_image_bgra_to_rgb(const unsigned char *bgra, int width, int height, unsigned char *rgb);
+
+// Extension of the images written by weref_image_write(), including the dot: ".jpg" or ".ppm"
+const char *weref_image_extension();
+// Encodes a 'width' x 'height' RGB image to 'path'. 'quality' (1-100) only applies to JPEG images.
+bool weref_image_write(const char *path, const unsigned char *rgb, int width, int height, int quality);
+
+// Encoded image in memory, its buffer is reused by the next encodings. Zero-initialize it before the first use.
+typedef struct WerefEncodedImage {
+  unsigned char *data;
+  size_t size;      // bytes of the image in 'data'
+  size_t capacity;  // allocated bytes of 'data'
+} WerefEncodedImage;
+
+// Encodes a 'width' x 'height' RGB image in memory, like weref_image_write(), so that the encoding and the file write
+// can be timed apart.
+bool weref_image_encode(const unsigned char *rgb, int width, int height, int quality, WerefEncodedImage *image);
+bool weref_encoded_image_write(const char *path, const WerefEncodedImage *image);
+void weref_encoded_image_cleanup(WerefEncodedImage *image);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // WEREF_ROI_CROP_H
@@ -0,0 +1,53 @@
+/*
+ * Description:   Seeded scene sampler: a xoshiro256** generator per run and 2D point streams in the unit square,
+ *                either pseudo-random or low-discrepancy (Sobol, stratified), mapped to the field regions by the
+ *                caller with inverse-CDF transforms.
+ */
+
+#ifndef WEREF_SAMPLER_H
+#define WEREF_SAMPLER_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum { WEREF_SAMPLER_RANDOM = 0, WEREF_SAMPLER_SOBOL, WEREF_SAMPLER_STRATIFIED } WerefSamplerMode;
+
+#define WEREF_SAMPLER_MAX_STREAMS 8
+
+typedef struct WerefSamplerPrivate *WerefSampler;
+
+// 'strata' is the number of cells per axis of the stratified mode, ignored by the other modes.
+WerefSampler weref_sampler_new(WerefSamplerMode mode, uint64_t seed, int strata);
+void weref_sampler_cleanup(WerefSampler sampler);
+
+// Returns the WerefSamplerMode matching 'name' ("random", "sobol" or "stratified"), -1 if unknown.
+int weref_sampler_parse_mode(const char *name);
+// Seed derived from the clock and the process id, for runs without an explicit seed.
+uint64_t weref_sampler_default_seed();
+uint64_t weref_sampler_get_seed(const WerefSampler sampler);
+
+// Pseudo-random numbers, whatever the mode.
+uint64_t weref_sampler_next_u64(WerefSampler sampler);
+double weref_sampler_uniform(WerefSampler sampler, double min, double max);
+
+// Next point of 'stream' in [0, 1)^2. Each stream is an independent sequence in the sampler mode, so that every
+// region covers its own area evenly.
+void weref_sampler_next_point(WerefSampler sampler, int stream, double point[2]);
+
+// Tabulated inverse CDF of a radial density, e.g. the arc length of a region at radius r.
+typedef double (*WerefRadialDensity)(double r);
+typedef struct WerefRadialTablePrivate *WerefRadialTable;
+
+WerefRadialTable weref_radial_table_new(double r_min, double r_max, int size, WerefRadialDensity density);
+void weref_radial_table_cleanup(WerefRadialTable table);
+// Returns the radius whose CDF is 'u', in O(log size).
+double weref_radial_table_sample(const WerefRadialTable table, double u);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // WEREF_SAMPLER_H
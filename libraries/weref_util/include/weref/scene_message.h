@@ -0,0 +1,41 @@
+/*
+ * Description:   Scene message published by the scene director to each camera robot through its 'customData' field.
+ *                It carries the labels of the run, the capture state and the scene state written in the same step.
+ *                The labels are space-separated words, an empty label is written as '-'.
+ */
+
+#ifndef WEREF_SCENE_MESSAGE_H
+#define WEREF_SCENE_MESSAGE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "scene_state.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WEREF_SCENE_MESSAGE_MAX_LENGTH 1024
+
+typedef struct WerefSceneMessage {
+  char gesture[128];  // labels of the run, as large as the ones of the scene director
+  char referee_model[128];
+  char cloth[32];
+  char background[128];
+  char position[16];  // label of the receiving camera robot: left, middle or right
+  int sample;         // index of the randomized scene
+  int capture;        // 1 if the receiving camera robot should save its frames
+  int render;         // 1 if its cameras must render during the next step, i.e. the next step is captured
+  uint64_t seed;      // seed of the scene sampler of the run
+  WerefSceneState scene;
+} WerefSceneMessage;
+
+// Returns the length of the encoded message, or -1 if it does not fit in 'size' bytes.
+int weref_scene_message_encode(const WerefSceneMessage *message, char *buffer, int size);
+bool weref_scene_message_decode(const char *text, WerefSceneMessage *message);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // WEREF_SCENE_MESSAGE_H
@@ -0,0 +1,44 @@
+/*
+ * Description:   Randomized scene parameters of a captured frame.
+ */
+
+#ifndef WEREF_SCENE_STATE_H
+#define WEREF_SCENE_STATE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+  WEREF_ROBOT_RED_2 = 0,
+  WEREF_ROBOT_RED_3,
+  WEREF_ROBOT_BLUE_4,
+  WEREF_ROBOT_OBSTACLE,
+  WEREF_ROBOT_COUNT
+} WerefRobotId;
+
+typedef struct WerefPose2d {
+  double x;
+  double y;
+  double yaw;  // rotation around the vertical axis [rad]
+} WerefPose2d;
+
+typedef struct WerefSceneState {
+  WerefPose2d robots[WEREF_ROBOT_COUNT];  // indexed by WerefRobotId
+  int obstacle_flag;                      // -1: unknown, 0: absent, 1: present
+  double ball[3];
+  double light_direction[3];
+  double light_luminosity;
+} WerefSceneState;
+
+extern const char *const weref_robot_names[WEREF_ROBOT_COUNT];
+
+void weref_scene_state_reset(WerefSceneState *state);
+// Returns the rotation around the vertical axis of a Webots axis-angle rotation.
+double weref_rotation_to_yaw(const double rotation[4]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // WEREF_SCENE_STATE_H
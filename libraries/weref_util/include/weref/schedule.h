@@ -0,0 +1,44 @@
+/*
+ * Description:   Capture schedule of a gesture: when the scene is randomized and which steps are captured.
+ *                Schedules are read from a table with one line per gesture:
+ *                  <gesture pattern> <start [s]> <period [s]> <frames per sample> <capture stride [steps]>
+ *                A pattern may start or end with '*', e.g. '*_end'. The first matching line is used.
+ */
+
+#ifndef WEREF_SCHEDULE_H
+#define WEREF_SCHEDULE_H
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct WerefSchedule {
+  double start;   // time of the first sample from the start of the run [s]
+  double period;  // time between two samples [s]
+  int frames;     // frames captured per sample
+  int stride;     // steps between two captured frames
+} WerefSchedule;
+
+// Flags returned by weref_schedule_step()
+#define WEREF_SCHEDULE_NEW_SAMPLE 1
+#define WEREF_SCHEDULE_CAPTURE 2
+
+// Reads the schedule of 'gesture' from the table at 'path'. Returns false if the table can't be read or has no
+// entry for the gesture, leaving 'schedule' unchanged.
+bool weref_schedule_load(const char *path, const char *gesture, WerefSchedule *schedule);
+
+// Default schedule of a motion of 'frame_count' frames, played 'frames_per_step' frames per 'motion_time_step' [ms]:
+// one sample per motion cycle, starting after the first cycle, and every step of the sample captured.
+void weref_schedule_default(int frame_count, int frames_per_step, int motion_time_step, int time_step,
+                            WerefSchedule *schedule);
+
+// Returns the WEREF_SCHEDULE_* flags of the step 'step' of the run, counted from its start.
+int weref_schedule_step(const WerefSchedule *schedule, int step, int time_step);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // WEREF_SCHEDULE_H
@@ -0,0 +1,53 @@
+/*
+ * Description:   Wall-clock time of a controller split by pipeline stage, for the throughput benchmarks. Each stage
+ *                accumulates the time between two calls of a monotonic clock, the controller chaining the stages of
+ *                a step. At the end of the run, the profile is printed and appended as one tab-separated line to a
+ *                results file shared by the controllers of the simulation:
+ *                  <controller> <robot> <simulated [s]> <wall-clock [s]> <frames> <seconds of each stage>...
+ */
+
+#ifndef WEREF_STAGE_PROFILE_H
+#define WEREF_STAGE_PROFILE_H
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+  WEREF_STAGE_STEP = 0,    // wb_robot_step(): the simulation, the rendering and the other controllers
+  WEREF_STAGE_SUPERVISOR,  // supervisor API calls and scene messages
+  WEREF_STAGE_CAPTURE,     // camera images read and converted or cropped
+  WEREF_STAGE_ENCODE,      // image encoding in the controller
+  WEREF_STAGE_WRITE,       // file writes: images, labels, shards and manifests
+  WEREF_STAGE_SAVE_IMAGE,  // wb_camera_save_image(): capture, encoding and write by Webots
+  WEREF_STAGE_COUNT
+} WerefStage;
+
+typedef struct WerefStageProfile {
+  double start;  // clock at weref_stage_profile_start()
+  double seconds[WEREF_STAGE_COUNT];
+  long long frames;  // frames saved
+} WerefStageProfile;
+
+// Monotonic clock [s]
+double weref_stage_clock();
+// Column name of a stage in the results file, e.g. "step"
+const char *weref_stage_name(WerefStage stage);
+
+void weref_stage_profile_start(WerefStageProfile *profile);
+// Adds the time elapsed since 'start' to 'stage'. Returns the current clock, the start of the next stage.
+double weref_stage_add(WerefStageProfile *profile, WerefStage stage, double start);
+
+// Prints the profile: simulated seconds and saved frames per wall-clock second, and the share of each stage.
+void weref_stage_profile_print(const WerefStageProfile *profile, const char *robot, double simulated_time);
+// Appends the profile to the results file at 'path' in a single write, so that concurrent controllers can share it.
+bool weref_stage_profile_append(const char *path, const WerefStageProfile *profile, const char *controller,
+                                const char *robot, double simulated_time);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // WEREF_STAGE_PROFILE_H
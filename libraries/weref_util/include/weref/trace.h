@@ -0,0 +1,70 @@
+/*
+ * Description:   Scoped timers of the hot paths, written as a Chrome trace (JSON array format) that chrome://tracing
+ *                and https://ui.perfetto.dev open. The instrumentation compiles to nothing unless the controllers
+ *                and libraries are built with WEREF_TRACE_ENABLED defined (make WEREF_TRACE_ENABLED=1), and it only
+ *                records once weref_trace_start() opened a trace file.
+ *
+ *                Each thread buffers its events in a fixed-size thread-local ring, written to the file when it is
+ *                full and when the trace stops. The controllers of a simulation share one trace file per run: each
+ *                process appends lines of whole events in single writes and the closing bracket, optional in this
+ *                format, is never written. The timestamps come from the monotonic clock, common to the processes.
+ *
+ *                  WEREF_TRACE_START(getenv("WEREF_TRACE"), "scene_director", wb_robot_get_name());
+ *                  static void randomize_scene() {
+ *                    WEREF_TRACE_SCOPE("randomize_scene");  // ends with the enclosing block
+ *                    ...
+ *                  }
+ *                  WEREF_TRACE_STOP();
+ */
+
+#ifndef WEREF_TRACE_H
+#define WEREF_TRACE_H
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct WerefTraceScope {
+  const char *name;  // string literal: only the pointer is buffered
+  double start;      // [us]
+} WerefTraceScope;
+
+// Opens the trace file at 'path', created if needed, and names the process '<controller> <robot>' in the viewer. A NULL
+// or empty path leaves the tracing off.
+bool weref_trace_start(const char *path, const char *controller, const char *robot);
+// Writes the buffered events of every thread and closes the trace file. Threads may still be tracing: their events
+// after the stop are not written.
+void weref_trace_stop();
+bool weref_trace_is_started();
+
+// Monotonic clock [us]
+double weref_trace_clock();
+// Buffers an event of the calling thread from 'start' to now. 'name' must outlive the trace, e.g. a string literal.
+void weref_trace_complete(const char *name, double start);
+
+WerefTraceScope weref_trace_scope_begin(const char *name);
+// Cleanup function of WEREF_TRACE_SCOPE(), called when the scope variable goes out of scope.
+void weref_trace_scope_end(WerefTraceScope *scope);
+
+#ifdef WEREF_TRACE_ENABLED
+#define WEREF_TRACE_CONCAT_(a, b) a##b
+#define WEREF_TRACE_CONCAT(a, b) WEREF_TRACE_CONCAT_(a, b)
+#define WEREF_TRACE_START(path, controller, robot) weref_trace_start(path, controller, robot)
+#define WEREF_TRACE_STOP() weref_trace_stop()
+// Times the rest of the enclosing block, including its early returns, breaks and continues.
+#define WEREF_TRACE_SCOPE(name)                                                               \
+  WerefTraceScope WEREF_TRACE_CONCAT(weref_trace_scope_, __LINE__)                            \
+    __attribute__((cleanup(weref_trace_scope_end), unused)) = weref_trace_scope_begin(name)
+#else
+#define WEREF_TRACE_START(path, controller, robot) ((void)0)
+#define WEREF_TRACE_STOP() ((void)0)
+#define WEREF_TRACE_SCOPE(name) ((void)0)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // WEREF_TRACE_H
@@ -0,0 +1,51 @@
+/*
+ * Description:   Concrete world files rendered from the world template and a parameter set, instead of editing the
+ *                tracked world files in place. The parameters of a world come from its line of the parameter table
+ *                (worlds/templates/worlds.txt), possibly overridden, and every '${NAME}' of the template is replaced
+ *                with its value.
+ *
+ *                A rendered world is placed in a scratch project named by the FNV-1a hash of its content, which
+ *                links the controllers, libraries, motions and world resources of the real project: an identical
+ *                configuration reuses the same project, and any number of Webots instances can load their own
+ *                configuration at the same time. Used by the world generator and the collection runner.
+ */
+
+#ifndef WEREF_WORLD_TEMPLATE_H
+#define WEREF_WORLD_TEMPLATE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct WerefWorldParametersPrivate *WerefWorldParameters;
+
+WerefWorldParameters weref_world_parameters_new();
+void weref_world_parameters_cleanup(WerefWorldParameters parameters);
+
+// Reads the parameters of 'world' from the table at 'path': a header line naming the columns, the first one being
+// WORLD, then one line per world. Blank lines and lines starting with '#' are ignored.
+bool weref_world_parameters_read(WerefWorldParameters parameters, const char *path, const char *world);
+// Sets the parameter of the first 'name_length' characters of 'name', e.g. of a 'NAME=value' argument.
+bool weref_world_parameters_set(WerefWorldParameters parameters, const char *name, size_t name_length,
+                                const char *value);
+// Returns NULL if the parameter is not set.
+const char *weref_world_parameters_get(const WerefWorldParameters parameters, const char *name);
+
+// Replaces every '${NAME}' of the template at 'path' with its value. Returns the rendered text, to be freed, or NULL
+// if the template can't be read or uses an undefined parameter.
+char *weref_world_template_render(const char *path, const WerefWorldParameters parameters);
+
+// Writes 'text' to the world file 'world_file' of the scratch project of its content in 'scratch_dir', created if
+// needed, with links to the absolute 'project_dir'. Writes the path of the world file to 'world_path' of PATH_MAX
+// bytes.
+bool weref_world_project_create(const char *scratch_dir, const char *project_dir, const char *world_file,
+                                const char *text, char *world_path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // WEREF_WORLD_TEMPLATE_H
@@ -0,0 +1,147 @@
+#include "weref/completion_manifest.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAX_RECORD_LENGTH 1024
+
+typedef struct WerefCompletionManifestPrivate {
+  WerefCompletionRecord *records;  // last record of each run
+  int n_records;
+  int capacity;
+} WerefCompletionManifestPrivate_t;
+
+//***********************************//
+//        Utility functions          //
+//***********************************//
+
+// NULL 'cloth' and 'presence' match any
+static bool same_cell(const WerefCompletionRecord *record, const char *gesture, const char *world, const char *cloth,
+                      const char *presence, const char *position) {
+  return strcmp(record->gesture, gesture) == 0 && strcmp(record->world, world) == 0 &&
+         (!cloth || strcmp(record->cloth, cloth) == 0) && (!presence || strcmp(record->presence, presence) == 0) &&
+         strcmp(record->position, position) == 0;
+}
+
+static bool parse_record(char *line, WerefCompletionRecord *record) {
+  char *fields[9];
+  char *save;
+  int n = 0;
+  for (char *field = strtok_r(line, "\t\r\n", &save); field && n < 9; field = strtok_r(NULL, "\t\r\n", &save))
+    fields[n++] = field;
+  if (n != 9 || strlen(fields[0]) >= sizeof(record->gesture) || strlen(fields[1]) >= sizeof(record->world) ||
+      strlen(fields[2]) >= sizeof(record->cloth) || strlen(fields[3]) >= sizeof(record->presence) ||
+      strlen(fields[4]) >= sizeof(record->position))
+    return false;
+  strcpy(record->gesture, fields[0]);
+  strcpy(record->world, fields[1]);
+  strcpy(record->cloth, fields[2]);
+  strcpy(record->presence, fields[3]);
+  strcpy(record->position, fields[4]);
+  record->seed = strtoull(fields[5], NULL, 10);
+  record->samples = atoi(fields[6]);
+  record->frames = atoi(fields[7]);
+  record->finished = strcmp(fields[8], "finished") == 0;
+  return true;
+}
+
+//***********************************//
+//          API functions            //
+//***********************************//
+
+bool weref_completion_manifest_append(const char *path, const WerefCompletionRecord *record) {
+  char line[MAX_RECORD_LENGTH];
+  const int length = snprintf(line, sizeof(line), "%s\t%s\t%s\t%s\t%s\t%" PRIu64 "\t%d\t%d\t%s\n", record->gesture,
+                              record->world, record->cloth, record->presence, record->position, record->seed,
+                              record->samples, record->frames, record->finished ? "finished" : "running");
+  if (length >= (int)sizeof(line)) {
+    fprintf(stderr, "Error: weref_completion_manifest_append(): the record does not fit in %d bytes.\n",
+            MAX_RECORD_LENGTH);
+    return false;
+  }
+  // one write() of a file opened with O_APPEND: the lines of concurrent runs don't interleave
+  const int fd = open(path, O_WRONLY | O_APPEND | O_CREAT, 0644);
+  if (fd < 0) {
+    fprintf(stderr, "Error: weref_completion_manifest_append(): could not open '%s'.\n", path);
+    return false;
+  }
+  const bool success = write(fd, line, length) == length;
+  close(fd);
+  if (!success)
+    fprintf(stderr, "Error: weref_completion_manifest_append(): could not write '%s'.\n", path);
+  return success;
+}
+
+WerefCompletionManifest weref_completion_manifest_load(const char *path) {
+  WerefCompletionManifest manifest = calloc(1, sizeof(WerefCompletionManifestPrivate_t));
+  FILE *file = fopen(path, "r");
+  if (!file) {
+    if (errno == ENOENT)
+      return manifest;
+    fprintf(stderr, "Error: weref_completion_manifest_load(): could not open '%s'.\n", path);
+    free(manifest);
+    return NULL;
+  }
+
+  char line[MAX_RECORD_LENGTH];
+  while (fgets(line, sizeof(line), file)) {
+    WerefCompletionRecord record;
+    // a line cut by a crash is skipped, the previous record of its run counts
+    if (!strchr(line, '\n') || !parse_record(line, &record))
+      continue;
+    int i;
+    for (i = 0; i < manifest->n_records; ++i) {
+      const WerefCompletionRecord *run = &manifest->records[i];
+      if (run->seed == record.seed &&
+          same_cell(run, record.gesture, record.world, record.cloth, record.presence, record.position))
+        break;
+    }
+    if (i == manifest->capacity) {
+      manifest->capacity = manifest->capacity ? 2 * manifest->capacity : 64;
+      manifest->records = realloc(manifest->records, manifest->capacity * sizeof(WerefCompletionRecord));
+    }
+    manifest->records[i] = record;
+    if (i == manifest->n_records)
+      ++manifest->n_records;
+  }
+  fclose(file);
+  return manifest;
+}
+
+void weref_completion_manifest_cleanup(WerefCompletionManifest manifest) {
+  if (manifest == NULL)
+    return;
+  free(manifest->records);
+  free(manifest);
+}
+
+int weref_completion_manifest_get(const WerefCompletionManifest manifest, const char *gesture, const char *world,
+                                  const char *cloth, const char *presence, const char *position, int *samples,
+                                  int *frames) {
+  int runs = 0;
+  *samples = 0;
+  *frames = 0;
+  int i;
+  for (i = 0; i < manifest->n_records; ++i) {
+    const WerefCompletionRecord *run = &manifest->records[i];
+    if (!same_cell(run, gesture, world, cloth, presence, position))
+      continue;
+    *samples += run->samples;
+    *frames += run->frames;
+    // with wildcards, a run has a record per matching cell
+    int j;
+    for (j = 0; j < i; ++j) {
+      const WerefCompletionRecord *other = &manifest->records[j];
+      if (other->seed == run->seed && same_cell(other, gesture, world, cloth, presence, position))
+        break;
+    }
+    if (j == i)
+      ++runs;
+  }
+  return runs;
+}
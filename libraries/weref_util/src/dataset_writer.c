@@ -0,0 +1,309 @@
+#include "weref/dataset_writer.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_PATH 1024
+#define MAX_NAME 256
+#define MAX_KEY 640  // keys of up to 512 characters, and their extension
+#define TAR_BLOCK 512
+#define TAR_MAX_SIZE 077777777777L  // 11 octal digits of the ustar size field
+
+typedef struct WerefDatasetWriterPrivate {
+  WerefOutputMode mode;
+  char root[MAX_NAME];
+  char path[MAX_PATH];      // path returned by the last weref_dataset_writer_begin() call, empty if it failed
+  char key[MAX_KEY];        // member name of the pending sample, with extension
+  char extension[16];       // extension of the pending sample, including the dot
+  char last_dir[MAX_PATH];  // last directory created in tree mode, to avoid a mkdir per frame
+  int n_samples;
+  long long bytes_written;
+
+  // shard mode only
+  char shard_prefix[MAX_NAME];
+  long shard_size;
+  int shard_index;
+  long shard_offset;  // current size of the open shard in bytes
+  FILE *shard;
+  FILE *index;
+  unsigned char *buffer;  // copy buffer for the pending sample
+  size_t buffer_size;
+} WerefDatasetWriterPrivate_t;
+
+//***********************************//
+//        Utility functions          //
+//***********************************//
+
+static bool file_exists(const char *path) {
+  struct stat st;
+  return stat(path, &st) == 0;
+}
+
+static void close_shard(WerefDatasetWriter writer) {
+  if (writer->shard) {
+    // end-of-archive marker: two empty blocks
+    static const unsigned char zero[2 * TAR_BLOCK] = {0};
+    fwrite(zero, 1, sizeof(zero), writer->shard);
+    fclose(writer->shard);
+    writer->shard = NULL;
+  }
+  if (writer->index) {
+    fclose(writer->index);
+    writer->index = NULL;
+  }
+}
+
+static bool open_next_shard(WerefDatasetWriter writer) {
+  close_shard(writer);
+
+  // never overwrite the shards of a previous run
+  char shard_path[MAX_PATH], index_path[MAX_PATH];
+  do {
+    snprintf(shard_path, sizeof(shard_path), "%s/shards/%s-%06d.tar", writer->root, writer->shard_prefix,
+             writer->shard_index);
+    snprintf(index_path, sizeof(index_path), "%s/shards/%s-%06d.idx", writer->root, writer->shard_prefix,
+             writer->shard_index);
+    ++writer->shard_index;
+  } while (file_exists(shard_path));
+
+  writer->shard = fopen(shard_path, "wb");
+  writer->index = fopen(index_path, "w");
+  if (!writer->shard || !writer->index) {
+    fprintf(stderr, "Error: weref_dataset_writer: could not create shard '%s'.\n", shard_path);
+    close_shard(writer);
+    return false;
+  }
+  fprintf(writer->index, "# key\toffset\tsize\n");
+  writer->shard_offset = 0;
+  return true;
+}
+
+// Writes 'value' to the numeric 'field' of a tar header as zero-padded octal digits and a terminating NUL.
+static bool write_octal(unsigned char *field, int size, unsigned long value) {
+  char digits[24];
+  if (snprintf(digits, sizeof(digits), "%0*lo", size - 1, value) != size - 1)
+    return false;
+  memcpy(field, digits, size);
+  return true;
+}
+
+// Fills a ustar header for a regular file. Names longer than 100 characters are split into prefix and name.
+static bool fill_tar_header(unsigned char *header, const char *member_name, long size) {
+  if (size < 0 || size > TAR_MAX_SIZE) {
+    fprintf(stderr, "Error: weref_dataset_writer: '%s' is too large for tar (%ld bytes).\n", member_name, size);
+    return false;
+  }
+  memset(header, 0, TAR_BLOCK);
+  const size_t length = strlen(member_name);
+  if (length <= 100)
+    memcpy(header, member_name, length);
+  else {
+    const char *split = member_name + length - 101;
+    while (*split && *split != '/')
+      ++split;
+    if (!*split || split - member_name > 155) {
+      fprintf(stderr, "Error: weref_dataset_writer: member name too long for tar: '%s'.\n", member_name);
+      return false;
+    }
+    memcpy(header, split + 1, strlen(split + 1));
+    memcpy(header + 345, member_name, split - member_name);
+  }
+  snprintf((char *)header + 100, 8, "%07o", 0644);
+  snprintf((char *)header + 108, 8, "%07o", 0);
+  snprintf((char *)header + 116, 8, "%07o", 0);
+  write_octal(header + 124, 12, (unsigned long)size);
+  write_octal(header + 136, 12, (unsigned long)time(NULL));
+  header[156] = '0';
+  memcpy(header + 257, "ustar", 6);
+  memcpy(header + 263, "00", 2);
+
+  // checksum is computed with the checksum field filled with spaces
+  memset(header + 148, ' ', 8);
+  unsigned int checksum = 0;
+  int i;
+  for (i = 0; i < TAR_BLOCK; ++i)
+    checksum += header[i];
+  snprintf((char *)header + 148, 8, "%06o", checksum);
+  header[155] = ' ';
+  return true;
+}
+
+static bool read_pending_sample(WerefDatasetWriter writer, long *size) {
+  FILE *file = fopen(writer->path, "rb");
+  if (!file) {
+    fprintf(stderr, "Error: weref_dataset_writer_commit(): could not open '%s'.\n", writer->path);
+    return false;
+  }
+  fseek(file, 0, SEEK_END);
+  *size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  if (*size < 0) {
+    fclose(file);
+    return false;
+  }
+  if ((size_t)*size > writer->buffer_size) {
+    writer->buffer = realloc(writer->buffer, *size);
+    writer->buffer_size = *size;
+  }
+  const bool success = fread(writer->buffer, 1, *size, file) == (size_t)*size;
+  fclose(file);
+  return success;
+}
+
+static bool append_to_shard(WerefDatasetWriter writer) {
+  long size;
+  if (!read_pending_sample(writer, &size))
+    return false;
+  unlink(writer->path);
+
+  const long padded_size = (size + TAR_BLOCK - 1) / TAR_BLOCK * TAR_BLOCK;
+  const bool shard_full = writer->shard_offset > 0 && writer->shard_offset + TAR_BLOCK + padded_size > writer->shard_size;
+  if ((writer->shard == NULL || shard_full) && !open_next_shard(writer))
+    return false;
+
+  unsigned char header[TAR_BLOCK];
+  if (!fill_tar_header(header, writer->key, size))
+    return false;
+  static const unsigned char padding[TAR_BLOCK] = {0};
+  fwrite(header, 1, TAR_BLOCK, writer->shard);
+  fwrite(writer->buffer, 1, size, writer->shard);
+  fwrite(padding, 1, padded_size - size, writer->shard);
+  // flushed per sample so that a killed simulation leaves a readable shard behind
+  fflush(writer->shard);
+
+  fprintf(writer->index, "%s\t%ld\t%ld\n", writer->key, writer->shard_offset + TAR_BLOCK, size);
+  fflush(writer->index);
+
+  writer->shard_offset += TAR_BLOCK + padded_size;
+  writer->bytes_written += TAR_BLOCK + padded_size;
+  return true;
+}
+
+//***********************************//
+//          API functions            //
+//***********************************//
+
+bool weref_make_directories(const char *path) {
+  char partial[MAX_PATH];
+  snprintf(partial, sizeof(partial), "%s", path);
+  char *p;
+  for (p = partial + 1; *p; ++p) {
+    if (*p != '/')
+      continue;
+    *p = '\0';
+    if (mkdir(partial, 0755) != 0 && errno != EEXIST)
+      return false;
+    *p = '/';
+  }
+  return mkdir(partial, 0755) == 0 || errno == EEXIST;
+}
+
+WerefDatasetWriter weref_dataset_writer_new(WerefOutputMode mode, const char *root, const char *shard_prefix,
+                                            long shard_size) {
+  if (!root || !root[0]) {
+    fprintf(stderr, "Error: weref_dataset_writer_new() called with NULL or empty 'root' argument.\n");
+    return NULL;
+  }
+
+  if (!shard_prefix)
+    shard_prefix = "frames";
+  if (strlen(root) >= MAX_NAME || strlen(shard_prefix) >= MAX_NAME) {
+    fprintf(stderr, "Error: weref_dataset_writer_new(): root '%s' or shard prefix '%s' too long.\n", root,
+            shard_prefix);
+    return NULL;
+  }
+
+  WerefDatasetWriter writer = calloc(1, sizeof(WerefDatasetWriterPrivate_t));
+  writer->mode = mode;
+  snprintf(writer->root, sizeof(writer->root), "%s", root);
+  snprintf(writer->shard_prefix, sizeof(writer->shard_prefix), "%s", shard_prefix);
+  writer->shard_size = shard_size;
+
+  char directory[MAX_PATH];
+  if (mode == WEREF_OUTPUT_SHARD)
+    snprintf(directory, sizeof(directory), "%s/shards", writer->root);
+  else
+    snprintf(directory, sizeof(directory), "%s", writer->root);
+  if (!weref_make_directories(directory)) {
+    fprintf(stderr, "Error: weref_dataset_writer_new(): could not create '%s'.\n", directory);
+    free(writer);
+    return NULL;
+  }
+  return writer;
+}
+
+void weref_dataset_writer_cleanup(WerefDatasetWriter writer) {
+  if (writer == NULL)
+    return;
+  close_shard(writer);
+  free(writer->buffer);
+  free(writer);
+}
+
+const char *weref_dataset_writer_begin(WerefDatasetWriter writer, const char *key, const char *extension) {
+  writer->path[0] = '\0';
+  const size_t extension_length = strlen(extension);
+  if (extension_length >= sizeof(writer->extension) || strlen(key) + extension_length >= sizeof(writer->key)) {
+    fprintf(stderr, "Error: weref_dataset_writer_begin(): key '%s%s' too long.\n", key, extension);
+    return NULL;
+  }
+  memcpy(writer->extension, extension, extension_length + 1);
+  snprintf(writer->key, sizeof(writer->key), "%s%s", key, writer->extension);
+
+  if (writer->mode == WEREF_OUTPUT_SHARD) {
+    // the sample is staged next to the shards and moved into the shard on commit
+    snprintf(writer->path, sizeof(writer->path), "%s/shards/%s.pending%s", writer->root, writer->shard_prefix,
+             writer->extension);
+    return writer->path;
+  }
+
+  snprintf(writer->path, sizeof(writer->path), "%s/%s", writer->root, writer->key);
+  char *last_slash = strrchr(writer->path, '/');
+  *last_slash = '\0';
+  if (strcmp(writer->path, writer->last_dir) != 0) {
+    if (!weref_make_directories(writer->path))
+      fprintf(stderr, "Error: weref_dataset_writer_begin(): could not create '%s'.\n", writer->path);
+    snprintf(writer->last_dir, sizeof(writer->last_dir), "%s", writer->path);
+  }
+  *last_slash = '/';
+  return writer->path;
+}
+
+bool weref_dataset_writer_commit(WerefDatasetWriter writer) {
+  if (!writer->path[0])
+    return false;
+  if (writer->mode == WEREF_OUTPUT_SHARD) {
+    if (!append_to_shard(writer))
+      return false;
+  } else {
+    struct stat st;
+    if (stat(writer->path, &st) != 0) {
+      fprintf(stderr, "Error: weref_dataset_writer_commit(): '%s' was not written.\n", writer->path);
+      return false;
+    }
+    writer->bytes_written += st.st_size;
+  }
+  ++writer->n_samples;
+  return true;
+}
+
+int weref_dataset_writer_parse_mode(const char *name) {
+  if (strcmp(name, "tree") == 0)
+    return WEREF_OUTPUT_TREE;
+  if (strcmp(name, "shard") == 0)
+    return WEREF_OUTPUT_SHARD;
+  return -1;
+}
+
+int weref_dataset_writer_get_sample_count(const WerefDatasetWriter writer) {
+  return writer->n_samples;
+}
+
+long long weref_dataset_writer_get_bytes_written(const WerefDatasetWriter writer) {
+  return writer->bytes_written;
+}
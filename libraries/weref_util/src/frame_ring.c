@@ -0,0 +1,199 @@
+#include "weref/frame_ring.h"
+
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define RING_MAGIC 0x57524e47u  // "WRNG"
+#define RING_VERSION 3
+#define CACHE_LINE 64
+#define POLL_INTERVAL_US 100
+
+// Shared control block at the start of the mapping, the slots follow it. Both counters only grow: slot i % count
+// holds frame i, it is readable while tail <= i < head. Each counter has its own cache line since the two processes
+// write them concurrently.
+typedef struct RingControl {
+  atomic_uint magic;
+  uint32_t version;
+  uint32_t slot_count;
+  uint64_t slot_size;  // bytes per slot, frame header included
+  atomic_int closed;
+  atomic_llong dropped;
+  _Alignas(CACHE_LINE) atomic_ullong head;  // frames published by the producer
+  _Alignas(CACHE_LINE) atomic_ullong tail;  // frames released by the consumer
+} RingControl;
+
+typedef struct WerefFrameRingPrivate {
+  char name[256];
+  bool producer;
+  RingControl *control;
+  unsigned char *slots;
+  size_t mapping_size;
+} WerefFrameRingPrivate_t;
+
+//***********************************//
+//        Utility functions          //
+//***********************************//
+
+static size_t align_up(size_t size) {
+  return (size + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+}
+
+static size_t slots_offset() {
+  return align_up(sizeof(RingControl));
+}
+
+static WerefFrameHeader *slot(WerefFrameRing ring, unsigned long long index) {
+  return (WerefFrameHeader *)(ring->slots + (index % ring->control->slot_count) * ring->control->slot_size);
+}
+
+static WerefFrameRing map_ring(const char *name, int fd, size_t size, bool producer) {
+  void *mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    fprintf(stderr, "Error: weref_frame_ring: could not map '%s'.\n", name);
+    return NULL;
+  }
+  WerefFrameRing ring = calloc(1, sizeof(WerefFrameRingPrivate_t));
+  snprintf(ring->name, sizeof(ring->name), "%s", name);
+  ring->producer = producer;
+  ring->control = mapping;
+  ring->slots = (unsigned char *)mapping + slots_offset();
+  ring->mapping_size = size;
+  return ring;
+}
+
+//***********************************//
+//          API functions            //
+//***********************************//
+
+WerefFrameRing weref_frame_ring_create(const char *name, int slot_count, size_t max_frame_size) {
+  if (slot_count < 1) {
+    fprintf(stderr, "Error: weref_frame_ring_create(): invalid slot count %d.\n", slot_count);
+    return NULL;
+  }
+  const size_t slot_size = align_up(sizeof(WerefFrameHeader) + max_frame_size);
+  const size_t size = slots_offset() + slot_count * slot_size;
+
+  // a consumer still mapping a stale ring keeps it, the new one gets a fresh object
+  shm_unlink(name);
+  const int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0 || ftruncate(fd, size) != 0) {
+    fprintf(stderr, "Error: weref_frame_ring_create(): could not create '%s' (%zu bytes).\n", name, size);
+    if (fd >= 0) {
+      close(fd);
+      shm_unlink(name);
+    }
+    return NULL;
+  }
+  WerefFrameRing ring = map_ring(name, fd, size, true);
+  if (!ring) {
+    shm_unlink(name);
+    return NULL;
+  }
+  RingControl *control = ring->control;
+  control->slot_count = slot_count;
+  control->slot_size = slot_size;
+  control->version = RING_VERSION;
+  atomic_init(&control->closed, 0);
+  atomic_init(&control->dropped, 0);
+  atomic_init(&control->head, 0);
+  atomic_init(&control->tail, 0);
+  // the magic is stored last: a consumer only accepts the ring once it is complete
+  atomic_store_explicit(&control->magic, RING_MAGIC, memory_order_release);
+  return ring;
+}
+
+WerefFrameRing weref_frame_ring_open(const char *name) {
+  const int fd = shm_open(name, O_RDWR, 0);
+  if (fd < 0)
+    return NULL;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < slots_offset()) {
+    close(fd);
+    return NULL;
+  }
+  WerefFrameRing ring = map_ring(name, fd, st.st_size, false);
+  if (!ring)
+    return NULL;
+  RingControl *control = ring->control;
+  const unsigned int magic = atomic_load_explicit(&control->magic, memory_order_acquire);
+  if (magic == 0) {
+    // the producer is still initializing it
+    weref_frame_ring_cleanup(ring);
+    return NULL;
+  }
+  if (magic != RING_MAGIC || control->version != RING_VERSION ||
+      slots_offset() + control->slot_count * control->slot_size > ring->mapping_size) {
+    fprintf(stderr, "Error: weref_frame_ring_open(): '%s' is not a frame ring.\n", name);
+    weref_frame_ring_cleanup(ring);
+    return NULL;
+  }
+  return ring;
+}
+
+void weref_frame_ring_cleanup(WerefFrameRing ring) {
+  if (!ring)
+    return;
+  if (ring->producer) {
+    atomic_store_explicit(&ring->control->closed, 1, memory_order_release);
+    shm_unlink(ring->name);
+  }
+  munmap(ring->control, ring->mapping_size);
+  free(ring);
+}
+
+WerefFrameHeader *weref_frame_ring_begin_write(WerefFrameRing ring, int timeout_ms) {
+  RingControl *control = ring->control;
+  const unsigned long long head = atomic_load_explicit(&control->head, memory_order_relaxed);
+  int waited_us = 0;
+  while (head - atomic_load_explicit(&control->tail, memory_order_acquire) >= control->slot_count) {
+    if (waited_us >= timeout_ms * 1000) {
+      atomic_fetch_add_explicit(&control->dropped, 1, memory_order_relaxed);
+      return NULL;
+    }
+    const struct timespec interval = {0, POLL_INTERVAL_US * 1000};
+    nanosleep(&interval, NULL);
+    waited_us += POLL_INTERVAL_US;
+  }
+  return slot(ring, head);
+}
+
+void weref_frame_ring_end_write(WerefFrameRing ring) {
+  atomic_fetch_add_explicit(&ring->control->head, 1, memory_order_release);
+}
+
+const WerefFrameHeader *weref_frame_ring_begin_read(WerefFrameRing ring) {
+  RingControl *control = ring->control;
+  const unsigned long long tail = atomic_load_explicit(&control->tail, memory_order_relaxed);
+  if (tail == atomic_load_explicit(&control->head, memory_order_acquire))
+    return NULL;
+  return slot(ring, tail);
+}
+
+void weref_frame_ring_end_read(WerefFrameRing ring) {
+  atomic_fetch_add_explicit(&ring->control->tail, 1, memory_order_release);
+}
+
+bool weref_frame_ring_is_closed(const WerefFrameRing ring) {
+  return atomic_load_explicit(&ring->control->closed, memory_order_acquire) != 0;
+}
+
+size_t weref_frame_ring_get_max_frame_size(const WerefFrameRing ring) {
+  return ring->control->slot_size - sizeof(WerefFrameHeader);
+}
+
+long long weref_frame_ring_get_dropped_count(const WerefFrameRing ring) {
+  return atomic_load_explicit(&ring->control->dropped, memory_order_relaxed);
+}
+
+int weref_frame_ring_get_depth(const WerefFrameRing ring) {
+  return (int)(atomic_load_explicit(&ring->control->head, memory_order_relaxed) -
+               atomic_load_explicit(&ring->control->tail, memory_order_relaxed));
+}
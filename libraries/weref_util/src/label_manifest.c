@@ -0,0 +1,111 @@
+#include "weref/label_manifest.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_RECORD_LENGTH 1024
+
+typedef struct WerefLabelManifestPrivate {
+  FILE *file;
+  int flush_interval;
+  int n_pending;      // number of records in 'buffer'
+  char *buffer;       // formatted records not yet written
+  size_t length;      // used length of 'buffer'
+  size_t capacity;    // allocated size of 'buffer'
+} WerefLabelManifestPrivate_t;
+
+//***********************************//
+//        Utility functions          //
+//***********************************//
+
+static void write_header(FILE *file) {
+  fprintf(file, "key,step,time,camera,seed,sample,phase");
+  int i;
+  for (i = 0; i < WEREF_ROBOT_COUNT; ++i)
+    fprintf(file, ",%s_x,%s_y,%s_yaw", weref_robot_names[i], weref_robot_names[i], weref_robot_names[i]);
+  fprintf(file, ",obstacle_flag,ball_x,ball_y,ball_z,light_dir_x,light_dir_y,light_dir_z,light_luminosity");
+  fprintf(file, ",referee_x_min,referee_y_min,referee_x_max,referee_y_max,referee_visible,referee_truncated");
+  fprintf(file, ",roi_x,roi_y,roi_size\n");
+}
+
+//***********************************//
+//          API functions            //
+//***********************************//
+
+WerefLabelManifest weref_label_manifest_new(const char *path, int flush_interval) {
+  FILE *file = fopen(path, "a");
+  if (!file) {
+    fprintf(stderr, "Error: weref_label_manifest_new(): could not open '%s'.\n", path);
+    return NULL;
+  }
+  // the header is only written once when several runs append to the same manifest
+  fseek(file, 0, SEEK_END);
+  if (ftell(file) == 0)
+    write_header(file);
+
+  WerefLabelManifest manifest = calloc(1, sizeof(WerefLabelManifestPrivate_t));
+  manifest->file = file;
+  manifest->flush_interval = flush_interval > 0 ? flush_interval : 1;
+  manifest->capacity = (size_t)manifest->flush_interval * MAX_RECORD_LENGTH;
+  manifest->buffer = malloc(manifest->capacity);
+  return manifest;
+}
+
+void weref_label_manifest_cleanup(WerefLabelManifest manifest) {
+  if (manifest == NULL)
+    return;
+  weref_label_manifest_flush(manifest);
+  fclose(manifest->file);
+  free(manifest->buffer);
+  free(manifest);
+}
+
+void weref_label_manifest_append(WerefLabelManifest manifest, const WerefLabelRecord *record) {
+  if (manifest == NULL)
+    return;
+
+  if (manifest->capacity - manifest->length < MAX_RECORD_LENGTH)
+    weref_label_manifest_flush(manifest);
+
+  char *line = manifest->buffer + manifest->length;
+  int n = snprintf(line, MAX_RECORD_LENGTH, "%s,%d,%.3f,%s,%" PRIu64 ",%d,%d", record->key, record->step,
+                   record->time, record->camera, record->seed, record->sample, record->phase);
+  int i;
+  for (i = 0; i < WEREF_ROBOT_COUNT; ++i) {
+    const WerefPose2d *pose = &record->scene.robots[i];
+    n += snprintf(line + n, MAX_RECORD_LENGTH - n, ",%.4f,%.4f,%.4f", pose->x, pose->y, pose->yaw);
+  }
+  const WerefSceneState *scene = &record->scene;
+  n += snprintf(line + n, MAX_RECORD_LENGTH - n, ",%d,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f", scene->obstacle_flag,
+                scene->ball[0], scene->ball[1], scene->ball[2], scene->light_direction[0], scene->light_direction[1],
+                scene->light_direction[2], scene->light_luminosity);
+  const WerefBoundingBox *box = &record->referee_box;
+  n += snprintf(line + n, MAX_RECORD_LENGTH - n, ",%.1f,%.1f,%.1f,%.1f,%d,%d,%.1f,%.1f,%.1f\n", box->x_min, box->y_min,
+                box->x_max, box->y_max, box->visible, box->truncated, record->roi.x, record->roi.y, record->roi.size);
+  if (n >= MAX_RECORD_LENGTH) {
+    fprintf(stderr, "Error: weref_label_manifest_append(): record '%s' is too long.\n", record->key);
+    return;
+  }
+
+  manifest->length += n;
+  if (++manifest->n_pending >= manifest->flush_interval)
+    weref_label_manifest_flush(manifest);
+}
+
+bool weref_label_manifest_flush(WerefLabelManifest manifest) {
+  if (manifest == NULL || manifest->length == 0)
+    return true;
+  const bool success = fwrite(manifest->buffer, 1, manifest->length, manifest->file) == manifest->length &&
+                       fflush(manifest->file) == 0;
+  if (!success)
+    fprintf(stderr, "Error: weref_label_manifest_flush(): could not write %d records.\n", manifest->n_pending);
+  manifest->length = 0;
+  manifest->n_pending = 0;
+  return success;
+}
+
+int weref_label_manifest_get_pending_count(const WerefLabelManifest manifest) {
+  return manifest ? manifest->n_pending : 0;
+}
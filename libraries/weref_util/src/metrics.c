@@ -0,0 +1,244 @@
+#include "weref/metrics.h"
+#include "weref/dataset_writer.h"
+
+#include <ctype.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MAX_METRICS 32
+#define MAX_NAME_LENGTH 64
+#define MAX_HELP_LENGTH 160
+#define MAX_LABELS_LENGTH 512
+#define WINDOW_SIZE 4096  // values of a summary kept between two writes, the latest ones
+
+static const double quantiles[] = {0.5, 0.9, 0.99};
+
+typedef struct Metric {
+  WerefMetricType type;
+  char name[MAX_NAME_LENGTH];
+  char help[MAX_HELP_LENGTH];
+  char labels[MAX_LABELS_LENGTH];  // formatted additional labels, each preceded by a comma
+  double value;                    // counters and gauges
+  // summaries only
+  double sum;
+  long long count;
+  double *window;  // values observed since the last write
+  int window_count;
+} Metric;
+
+typedef struct WerefMetricsPrivate {
+  char path[PATH_MAX];
+  char temporary_path[PATH_MAX + 4];  // 'path' with a '.tmp' suffix
+  char labels[MAX_LABELS_LENGTH];  // controller and robot labels of every sample
+  double interval;
+  double last_write;  // monotonic clock of the last write [s]
+  Metric metrics[MAX_METRICS];
+  int n_metrics;
+} WerefMetricsPrivate_t;
+
+//***********************************//
+//        Utility functions          //
+//***********************************//
+
+static double monotonic_clock() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+// Appends ',<name>="<value>"' to 'labels', with the value escaped as in the text format.
+static void append_label(char *labels, const char *name, const char *value) {
+  size_t length = strlen(labels);
+  length += snprintf(labels + length, MAX_LABELS_LENGTH - length, ",%s=\"", name);
+  for (; *value && length + 4 < MAX_LABELS_LENGTH; ++value) {
+    if (*value == '\\' || *value == '"')
+      labels[length++] = '\\';
+    else if (*value == '\n') {
+      labels[length++] = '\\';
+      labels[length++] = 'n';
+      continue;
+    }
+    labels[length++] = *value;
+  }
+  snprintf(labels + length, MAX_LABELS_LENGTH - length, "\"");
+}
+
+static int compare_values(const void *a, const void *b) {
+  const double x = *(const double *)a, y = *(const double *)b;
+  return x < y ? -1 : x > y;
+}
+
+static void print_value(FILE *file, double value) {
+  if (isnan(value))
+    fprintf(file, "NaN\n");
+  else
+    fprintf(file, "%.15g\n", value);
+}
+
+// Writes the samples of a summary and empties its window.
+static void print_summary(FILE *file, Metric *metric, const char *labels) {
+  const int n = metric->window_count < WINDOW_SIZE ? metric->window_count : WINDOW_SIZE;
+  qsort(metric->window, n, sizeof(double), compare_values);
+  size_t i;
+  for (i = 0; i < sizeof(quantiles) / sizeof(quantiles[0]); ++i) {
+    // nearest rank, ceil(q * n) - 1 without libm
+    int rank = (int)(quantiles[i] * n);
+    if (rank > 0 && rank == quantiles[i] * n)
+      rank--;
+    if (rank >= n)
+      rank = n - 1;
+    fprintf(file, "%s{%s%s,quantile=\"%g\"} ", metric->name, labels, metric->labels, quantiles[i]);
+    print_value(file, n > 0 ? metric->window[rank] : NAN);
+  }
+  fprintf(file, "%s_sum{%s%s} ", metric->name, labels, metric->labels);
+  print_value(file, metric->sum);
+  fprintf(file, "%s_count{%s%s} %lld\n", metric->name, labels, metric->labels, metric->count);
+  metric->window_count = 0;
+}
+
+static Metric *find_metric(WerefMetrics metrics, int id) {
+  if (metrics == NULL || id < 0 || id >= metrics->n_metrics)
+    return NULL;
+  return &metrics->metrics[id];
+}
+
+//***********************************//
+//          API functions            //
+//***********************************//
+
+WerefMetrics weref_metrics_new(const char *directory, const char *controller, const char *robot, double interval) {
+  if (!directory || !directory[0] || !controller || !robot) {
+    fprintf(stderr, "Error: weref_metrics_new() called with a NULL or empty argument.\n");
+    return NULL;
+  }
+  if (!weref_make_directories(directory)) {
+    fprintf(stderr, "Error: weref_metrics_new(): could not create '%s'.\n", directory);
+    return NULL;
+  }
+  WerefMetrics metrics = calloc(1, sizeof(WerefMetricsPrivate_t));
+  // the robot names have spaces, e.g. "NAO RED 2"
+  char file_name[128];
+  snprintf(file_name, sizeof(file_name), "%s_%s", controller, robot);
+  char *c;
+  for (c = file_name; *c; ++c)
+    if (!isalnum((unsigned char)*c) && *c != '-' && *c != '_')
+      *c = '_';
+  const int length = snprintf(metrics->path, sizeof(metrics->path), "%s/%s.prom", directory, file_name);
+  // the temporary file is renamed over the metrics file, node_exporter only reads the '.prom' files
+  if (length < 0 || length + 4 >= (int)sizeof(metrics->path)) {
+    fprintf(stderr, "Error: weref_metrics_new(): path too long in '%s'.\n", directory);
+    free(metrics);
+    return NULL;
+  }
+  snprintf(metrics->temporary_path, sizeof(metrics->temporary_path), "%s.tmp", metrics->path);
+  append_label(metrics->labels, "controller", controller);
+  append_label(metrics->labels, "robot", robot);
+  metrics->interval = interval;
+  metrics->last_write = monotonic_clock();
+  return metrics;
+}
+
+void weref_metrics_cleanup(WerefMetrics metrics) {
+  if (metrics == NULL)
+    return;
+  weref_metrics_write(metrics);
+  int i;
+  for (i = 0; i < metrics->n_metrics; ++i)
+    free(metrics->metrics[i].window);
+  free(metrics);
+}
+
+int weref_metrics_register(WerefMetrics metrics, WerefMetricType type, const char *name, const char *help) {
+  if (metrics == NULL)
+    return -1;
+  if (metrics->n_metrics == MAX_METRICS) {
+    fprintf(stderr, "Error: weref_metrics_register(): more than %d metrics.\n", MAX_METRICS);
+    return -1;
+  }
+  Metric *metric = &metrics->metrics[metrics->n_metrics];
+  memset(metric, 0, sizeof(*metric));
+  metric->type = type;
+  snprintf(metric->name, sizeof(metric->name), "%s", name);
+  snprintf(metric->help, sizeof(metric->help), "%s", help);
+  if (type == WEREF_METRIC_SUMMARY && !(metric->window = malloc(WINDOW_SIZE * sizeof(double)))) {
+    fprintf(stderr, "Error: weref_metrics_register(): could not allocate the window of '%s'.\n", name);
+    return -1;
+  }
+  return metrics->n_metrics++;
+}
+
+void weref_metrics_set_labels(WerefMetrics metrics, int id, const char *const *labels, int count) {
+  Metric *metric = find_metric(metrics, id);
+  if (metric == NULL)
+    return;
+  metric->labels[0] = '\0';
+  int i;
+  for (i = 0; i < count; ++i)
+    append_label(metric->labels, labels[2 * i], labels[2 * i + 1]);
+}
+
+void weref_metrics_add(WerefMetrics metrics, int id, double value) {
+  Metric *metric = find_metric(metrics, id);
+  if (metric)
+    metric->value += value;
+}
+
+void weref_metrics_set(WerefMetrics metrics, int id, double value) {
+  Metric *metric = find_metric(metrics, id);
+  if (metric)
+    metric->value = value;
+}
+
+void weref_metrics_observe(WerefMetrics metrics, int id, double value) {
+  Metric *metric = find_metric(metrics, id);
+  if (metric == NULL || metric->type != WEREF_METRIC_SUMMARY)
+    return;
+  metric->sum += value;
+  metric->count++;
+  metric->window[metric->window_count++ % WINDOW_SIZE] = value;
+}
+
+bool weref_metrics_update(WerefMetrics metrics) {
+  if (metrics == NULL || monotonic_clock() - metrics->last_write < metrics->interval)
+    return true;
+  return weref_metrics_write(metrics);
+}
+
+bool weref_metrics_write(WerefMetrics metrics) {
+  if (metrics == NULL)
+    return true;
+  metrics->last_write = monotonic_clock();
+  FILE *file = fopen(metrics->temporary_path, "w");
+  if (!file) {
+    fprintf(stderr, "Error: weref_metrics_write(): could not open '%s'.\n", metrics->temporary_path);
+    return false;
+  }
+  static const char *const type_names[] = {"counter", "gauge", "summary"};
+  // the label list of each sample starts with a comma
+  const char *labels = metrics->labels + 1;
+  int i;
+  for (i = 0; i < metrics->n_metrics; ++i) {
+    Metric *metric = &metrics->metrics[i];
+    fprintf(file, "# HELP %s %s\n# TYPE %s %s\n", metric->name, metric->help, metric->name, type_names[metric->type]);
+    if (metric->type == WEREF_METRIC_SUMMARY)
+      print_summary(file, metric, labels);
+    else {
+      fprintf(file, "%s{%s%s} ", metric->name, labels, metric->labels);
+      print_value(file, metric->value);
+    }
+  }
+  fprintf(file, "# HELP weref_metrics_write_timestamp_seconds Wall-clock time of this write.\n");
+  fprintf(file, "# TYPE weref_metrics_write_timestamp_seconds gauge\n");
+  fprintf(file, "weref_metrics_write_timestamp_seconds{%s} %lld\n", labels, (long long)time(NULL));
+  const bool failed = ferror(file);
+  if (fclose(file) != 0 || failed || rename(metrics->temporary_path, metrics->path) != 0) {
+    fprintf(stderr, "Error: weref_metrics_write(): could not write '%s'.\n", metrics->path);
+    remove(metrics->temporary_path);
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,150 @@
+#include "weref/referee_pose.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Points closer to the camera plane than this are considered behind the camera [m]
+#define NEAR_DISTANCE 0.01
+
+//***********************************//
+//        Utility functions          //
+//***********************************//
+
+static bool read_point(const char **text, double point[3]) {
+  char *end;
+  int j;
+  for (j = 0; j < 3; ++j) {
+    point[j] = strtod(*text, &end);
+    if (end == *text)
+      return false;
+    *text = end;
+  }
+  return true;
+}
+
+//***********************************//
+//          API functions            //
+//***********************************//
+
+bool weref_referee_pose_encode(const WerefRefereePose *pose, char *buffer, int size) {
+  int n = snprintf(buffer, size, "%d %d", pose->frame, pose->bone_count);
+  int i;
+  for (i = 0; i < pose->bone_count && n < size; ++i)
+    n += snprintf(buffer + n, size - n, " %.3f %.3f %.3f", pose->bones[i][0], pose->bones[i][1], pose->bones[i][2]);
+  if (n < size)
+    n += snprintf(buffer + n, size - n, " %d", pose->keypoint_count);
+  for (i = 0; i < pose->keypoint_count && n < size; ++i)
+    n += snprintf(buffer + n, size - n, " %s %d", pose->keypoint_names[i], pose->keypoint_bones[i]);
+  if (n >= size) {
+    fprintf(stderr, "Error: weref_referee_pose_encode(): the pose does not fit in %d bytes.\n", size);
+    return false;
+  }
+  return true;
+}
+
+bool weref_referee_pose_decode(const char *text, WerefRefereePose *pose) {
+  char *end;
+  pose->frame = (int)strtol(text, &end, 10);
+  pose->bone_count = 0;
+  pose->keypoint_count = 0;
+  if (end == text)
+    return false;
+  text = end;
+  int count = (int)strtol(text, &end, 10);
+  if (end == text)
+    return true;
+  if (count < 0 || count > WEREF_REFEREE_MAX_BONES)
+    return false;
+  text = end;
+  int i;
+  for (i = 0; i < count; ++i) {
+    if (!read_point(&text, pose->bones[i]))
+      return false;
+  }
+  pose->bone_count = count;
+
+  count = (int)strtol(text, &end, 10);
+  if (end == text)
+    return true;
+  if (count < 0 || count > WEREF_REFEREE_MAX_KEYPOINTS)
+    return false;
+  text = end;
+  for (i = 0; i < count; ++i) {
+    text += strspn(text, " ");
+    const size_t length = strcspn(text, " ");
+    if (length == 0 || length >= WEREF_KEYPOINT_NAME_LENGTH)
+      return false;
+    memcpy(pose->keypoint_names[i], text, length);
+    pose->keypoint_names[i][length] = '\0';
+    text += length;
+    const int bone = (int)strtol(text, &end, 10);
+    if (end == text || bone < 0 || bone >= pose->bone_count)
+      return false;
+    pose->keypoint_bones[i] = bone;
+    text = end;
+  }
+  pose->keypoint_count = count;
+  return true;
+}
+
+bool weref_project_point(const double camera_pose[16], double fov, int width, int height, const double point[3],
+                         double camera_point[3], double pixel[2]) {
+  // camera frame coordinates: transpose of the rotation applied to the offset from the camera
+  const double d[3] = {point[0] - camera_pose[3], point[1] - camera_pose[7], point[2] - camera_pose[11]};
+  int i;
+  for (i = 0; i < 3; ++i)
+    camera_point[i] = camera_pose[i] * d[0] + camera_pose[4 + i] * d[1] + camera_pose[8 + i] * d[2];
+  if (camera_point[0] < NEAR_DISTANCE) {
+    pixel[0] = pixel[1] = -1.0;
+    return false;
+  }
+  const double focal = 0.5 * width / tan(0.5 * fov);
+  pixel[0] = 0.5 * width - focal * camera_point[1] / camera_point[0];
+  pixel[1] = 0.5 * height - focal * camera_point[2] / camera_point[0];
+  return pixel[0] >= 0.0 && pixel[0] < width && pixel[1] >= 0.0 && pixel[1] < height;
+}
+
+void weref_referee_pose_project(const WerefRefereePose *pose, const double camera_pose[16], double fov, int width,
+                                int height, double radius, WerefBoundingBox *box) {
+  box->x_min = box->y_min = box->x_max = box->y_max = 0.0;
+  box->visible = pose->bone_count > 0 ? 0 : -1;
+  box->truncated = 0;
+  if (pose->bone_count == 0)
+    return;
+
+  const double focal = 0.5 * width / tan(0.5 * fov);
+  double x_min = INFINITY, y_min = INFINITY, x_max = -INFINITY, y_max = -INFINITY;
+  int i;
+  for (i = 0; i < pose->bone_count; ++i) {
+    double camera_point[3], pixel[2];
+    weref_project_point(camera_pose, fov, width, height, pose->bones[i], camera_point, pixel);
+    if (camera_point[0] < NEAR_DISTANCE) {
+      box->truncated = 1;
+      continue;
+    }
+    const double margin = focal * radius / camera_point[0];
+    x_min = fmin(x_min, pixel[0] - margin);
+    x_max = fmax(x_max, pixel[0] + margin);
+    y_min = fmin(y_min, pixel[1] - margin);
+    y_max = fmax(y_max, pixel[1] + margin);
+  }
+  if (x_min > x_max) {
+    box->truncated = 0;  // every bone is behind the camera
+    return;
+  }
+
+  if (x_min < 0.0 || y_min < 0.0 || x_max > width || y_max > height)
+    box->truncated = 1;
+  box->x_min = fmax(x_min, 0.0);
+  box->y_min = fmax(y_min, 0.0);
+  box->x_max = fmin(x_max, width);
+  box->y_max = fmin(y_max, height);
+  if (box->x_min < box->x_max && box->y_min < box->y_max)
+    box->visible = 1;
+  else {
+    box->x_min = box->y_min = box->x_max = box->y_max = 0.0;
+    box->truncated = 0;
+  }
+}
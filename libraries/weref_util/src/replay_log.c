@@ -0,0 +1,195 @@
+#include "weref/replay_log.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define REPLAY_MAGIC "WRPL"
+#define REPLAY_VERSION 1
+#define REPLAY_FLUSH_INTERVAL 64  // step blocks
+
+typedef struct WerefReplayLogPrivate {
+  FILE *file;
+  bool recording;
+  WerefReplayWrite *writes;  // queued writes (recording) or writes of the last step read (replay)
+  int n_writes;
+  int capacity;
+  int last_sample;   // sample and capture state of the last stored step
+  int last_capture;
+  int n_blocks;
+} WerefReplayLogPrivate_t;
+
+//***********************************//
+//        Utility functions          //
+//***********************************//
+
+static bool write_value(FILE *file, const void *value, size_t size) {
+  return fwrite(value, size, 1, file) == 1;
+}
+
+static bool read_value(FILE *file, void *value, size_t size) {
+  return fread(value, size, 1, file) == 1;
+}
+
+static bool reserve_writes(WerefReplayLog log, int count) {
+  if (count <= log->capacity)
+    return true;
+  const int capacity = count > 2 * log->capacity ? count : 2 * log->capacity;
+  WerefReplayWrite *writes = realloc(log->writes, capacity * sizeof(WerefReplayWrite));
+  if (!writes) {
+    fprintf(stderr, "Error: weref_replay_log: could not allocate %d writes.\n", capacity);
+    return false;
+  }
+  log->writes = writes;
+  log->capacity = capacity;
+  return true;
+}
+
+static WerefReplayLog new_log(FILE *file, bool recording) {
+  WerefReplayLog log = calloc(1, sizeof(WerefReplayLogPrivate_t));
+  log->file = file;
+  log->recording = recording;
+  log->last_sample = -1;
+  log->last_capture = 0;
+  return log;
+}
+
+//***********************************//
+//          API functions            //
+//***********************************//
+
+WerefReplayLog weref_replay_log_create(const char *path, const WerefReplayHeader *header) {
+  FILE *file = fopen(path, "wb");
+  if (!file) {
+    fprintf(stderr, "Error: weref_replay_log_create(): could not create '%s'.\n", path);
+    return NULL;
+  }
+  const uint32_t version = REPLAY_VERSION;
+  const int32_t time_step = header->time_step;
+  if (fwrite(REPLAY_MAGIC, 4, 1, file) != 1 || !write_value(file, &version, sizeof(version)) ||
+      !write_value(file, &header->seed, sizeof(header->seed)) || !write_value(file, &time_step, sizeof(time_step)) ||
+      !write_value(file, header->gesture, sizeof(header->gesture)) ||
+      !write_value(file, header->referee_model, sizeof(header->referee_model)) ||
+      !write_value(file, header->background, sizeof(header->background))) {
+    fprintf(stderr, "Error: weref_replay_log_create(): could not write the header of '%s'.\n", path);
+    fclose(file);
+    return NULL;
+  }
+  return new_log(file, true);
+}
+
+WerefReplayLog weref_replay_log_open(const char *path, WerefReplayHeader *header) {
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    fprintf(stderr, "Error: weref_replay_log_open(): could not open '%s'.\n", path);
+    return NULL;
+  }
+  char magic[4];
+  uint32_t version;
+  int32_t time_step;
+  if (!read_value(file, magic, sizeof(magic)) || memcmp(magic, REPLAY_MAGIC, 4) != 0 ||
+      !read_value(file, &version, sizeof(version)) || version != REPLAY_VERSION) {
+    fprintf(stderr, "Error: weref_replay_log_open(): '%s' is not a replay log of version %d.\n", path,
+            REPLAY_VERSION);
+    fclose(file);
+    return NULL;
+  }
+  if (!read_value(file, &header->seed, sizeof(header->seed)) || !read_value(file, &time_step, sizeof(time_step)) ||
+      !read_value(file, header->gesture, sizeof(header->gesture)) ||
+      !read_value(file, header->referee_model, sizeof(header->referee_model)) ||
+      !read_value(file, header->background, sizeof(header->background))) {
+    fprintf(stderr, "Error: weref_replay_log_open(): truncated header in '%s'.\n", path);
+    fclose(file);
+    return NULL;
+  }
+  header->time_step = time_step;
+  header->gesture[sizeof(header->gesture) - 1] = '\0';
+  header->referee_model[sizeof(header->referee_model) - 1] = '\0';
+  header->background[sizeof(header->background) - 1] = '\0';
+  return new_log(file, false);
+}
+
+void weref_replay_log_cleanup(WerefReplayLog log) {
+  if (log == NULL)
+    return;
+  fclose(log->file);
+  free(log->writes);
+  free(log);
+}
+
+void weref_replay_log_write(WerefReplayLog log, int field, int target, const double *values, int count) {
+  if (log == NULL || !log->recording)
+    return;
+  if (count > WEREF_REPLAY_MAX_VALUES) {
+    fprintf(stderr, "Error: weref_replay_log_write(): too many values (%d).\n", count);
+    return;
+  }
+  if (!reserve_writes(log, log->n_writes + 1))
+    return;
+  WerefReplayWrite *write = &log->writes[log->n_writes++];
+  write->field = field;
+  write->target = target;
+  write->count = count;
+  memcpy(write->values, values, count * sizeof(double));
+}
+
+bool weref_replay_log_end_step(WerefReplayLog log, const WerefReplayStep *step) {
+  if (log == NULL || !log->recording)
+    return false;
+  if (log->n_writes == 0 && step->sample == log->last_sample && step->capture == log->last_capture)
+    return true;
+
+  const int32_t block[4] = {step->step, step->sample, step->capture, step->motion_frame};
+  const uint16_t n_writes = log->n_writes;
+  bool success = write_value(log->file, block, sizeof(block)) && write_value(log->file, &n_writes, sizeof(n_writes));
+  int i;
+  for (i = 0; i < log->n_writes && success; ++i) {
+    const WerefReplayWrite *write = &log->writes[i];
+    const uint8_t fields[3] = {write->field, write->target, write->count};
+    success = write_value(log->file, fields, sizeof(fields)) &&
+              fwrite(write->values, sizeof(double), write->count, log->file) == (size_t)write->count;
+  }
+  if (success && ++log->n_blocks % REPLAY_FLUSH_INTERVAL == 0)
+    success = fflush(log->file) == 0;
+  if (!success)
+    fprintf(stderr, "Error: weref_replay_log_end_step(): could not write step %d.\n", step->step);
+
+  log->n_writes = 0;
+  log->last_sample = step->sample;
+  log->last_capture = step->capture;
+  return success;
+}
+
+bool weref_replay_log_next_step(WerefReplayLog log, WerefReplayStep *step, const WerefReplayWrite **writes,
+                                int *n_writes) {
+  if (log == NULL || log->recording)
+    return false;
+
+  int32_t block[4];
+  uint16_t count;
+  if (!read_value(log->file, block, sizeof(block)) || !read_value(log->file, &count, sizeof(count)))
+    return false;
+  step->step = block[0];
+  step->sample = block[1];
+  step->capture = block[2];
+  step->motion_frame = block[3];
+
+  if (!reserve_writes(log, count))
+    return false;
+  int i;
+  for (i = 0; i < count; ++i) {
+    WerefReplayWrite *write = &log->writes[i];
+    uint8_t fields[3];
+    if (!read_value(log->file, fields, sizeof(fields)) || fields[2] > WEREF_REPLAY_MAX_VALUES ||
+        fread(write->values, sizeof(double), fields[2], log->file) != fields[2]) {
+      fprintf(stderr, "Error: weref_replay_log_next_step(): truncated step %d.\n", step->step);
+      return false;
+    }
+    write->field = fields[0];
+    write->target = fields[1];
+    write->count = fields[2];
+  }
+  *writes = log->writes;
+  *n_writes = count;
+  return true;
+}
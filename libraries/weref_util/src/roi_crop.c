@@ -0,0 +1,197 @@
+#include "weref/roi_crop.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef WEREF_USE_LIBJPEG
+#include <jpeglib.h>
+#endif
+
+//***********************************//
+//        Utility functions          //
+//***********************************//
+
+static int clamp(int value, int max) {
+  return value < 0 ? 0 : (value > max ? max : value);
+}
+
+#ifdef WEREF_USE_LIBJPEG
+static bool write_jpeg(FILE *file, const unsigned char *rgb, int width, int height, int quality) {
+  struct jpeg_compress_struct compressor;
+  struct jpeg_error_mgr error_manager;
+  compressor.err = jpeg_std_error(&error_manager);
+  jpeg_create_compress(&compressor);
+  jpeg_stdio_dest(&compressor, file);
+  compressor.image_width = width;
+  compressor.image_height = height;
+  compressor.input_components = 3;
+  compressor.in_color_space = JCS_RGB;
+  jpeg_set_defaults(&compressor);
+  jpeg_set_quality(&compressor, quality, TRUE);
+  jpeg_start_compress(&compressor, TRUE);
+  while (compressor.next_scanline < compressor.image_height) {
+    JSAMPROW row = (JSAMPROW)(rgb + 3 * width * compressor.next_scanline);
+    jpeg_write_scanlines(&compressor, &row, 1);
+  }
+  jpeg_finish_compress(&compressor);
+  jpeg_destroy_compress(&compressor);
+  return true;
+}
+
+// Encodes in the buffer of 'image', libjpeg allocates a larger one if it is too small
+static bool encode_jpeg(const unsigned char *rgb, int width, int height, int quality, WerefEncodedImage *image) {
+  struct jpeg_compress_struct compressor;
+  struct jpeg_error_mgr error_manager;
+  compressor.err = jpeg_std_error(&error_manager);
+  jpeg_create_compress(&compressor);
+  unsigned char *buffer = image->data;
+  unsigned long size = image->capacity;
+  jpeg_mem_dest(&compressor, &buffer, &size);
+  compressor.image_width = width;
+  compressor.image_height = height;
+  compressor.input_components = 3;
+  compressor.in_color_space = JCS_RGB;
+  jpeg_set_defaults(&compressor);
+  jpeg_set_quality(&compressor, quality, TRUE);
+  jpeg_start_compress(&compressor, TRUE);
+  while (compressor.next_scanline < compressor.image_height) {
+    JSAMPROW row = (JSAMPROW)(rgb + 3 * width * compressor.next_scanline);
+    jpeg_write_scanlines(&compressor, &row, 1);
+  }
+  jpeg_finish_compress(&compressor);
+  jpeg_destroy_compress(&compressor);
+  if (buffer != image->data) {
+    free(image->data);
+    image->data = buffer;
+    image->capacity = size;
+  }
+  image->size = size;
+  return true;
+}
+#endif
+
+//***********************************//
+//          API functions            //
+//***********************************//
+
+void weref_roi_from_box(const WerefBoundingBox *box, double padding, WerefRoi *roi) {
+  if (box->visible != 1) {
+    roi->x = roi->y = roi->size = 0.0;
+    return;
+  }
+  const double side = fmax(box->x_max - box->x_min, box->y_max - box->y_min);
+  roi->size = side * (1.0 + 2.0 * padding);
+  roi->x = 0.5 * (box->x_min + box->x_max - roi->size);
+  roi->y = 0.5 * (box->y_min + box->y_max - roi->size);
+}
+
+void weref_roi_crop(const unsigned char *bgra, int width, int height, const WerefRoi *roi, int size,
+                    unsigned char *rgb) {
+  const double scale = roi->size / size;
+  int i, j, c;
+  for (i = 0; i < size; ++i) {
+    const double y = roi->y + (i + 0.5) * scale - 0.5;
+    const int y0 = (int)floor(y);
+    const double fy = y - y0;
+    for (j = 0; j < size; ++j) {
+      unsigned char *pixel = rgb + 3 * (size * i + j);
+      const double x = roi->x + (j + 0.5) * scale - 0.5;
+      if (x < -0.5 || y < -0.5 || x > width - 0.5 || y > height - 0.5) {
+        memset(pixel, 0, 3);
+        continue;
+      }
+      const int x0 = (int)floor(x);
+      const double fx = x - x0;
+      const unsigned char *p00 = bgra + 4 * (width * clamp(y0, height - 1) + clamp(x0, width - 1));
+      const unsigned char *p01 = bgra + 4 * (width * clamp(y0, height - 1) + clamp(x0 + 1, width - 1));
+      const unsigned char *p10 = bgra + 4 * (width * clamp(y0 + 1, height - 1) + clamp(x0, width - 1));
+      const unsigned char *p11 = bgra + 4 * (width * clamp(y0 + 1, height - 1) + clamp(x0 + 1, width - 1));
+      for (c = 0; c < 3; ++c) {
+        const double top = p00[2 - c] + fx * (p01[2 - c] - p00[2 - c]);
+        const double bottom = p10[2 - c] + fx * (p11[2 - c] - p10[2 - c]);
+        pixel[c] = (unsigned char)(top + fy * (bottom - top) + 0.5);
+      }
+    }
+  }
+}
+
+void weref_image_bgra_to_rgb(const unsigned char *bgra, int width, int height, unsigned char *rgb) {
+  const int n_pixels = width * height;
+  int i;
+  for (i = 0; i < n_pixels; ++i) {
+    rgb[3 * i] = bgra[4 * i + 2];
+    rgb[3 * i + 1] = bgra[4 * i + 1];
+    rgb[3 * i + 2] = bgra[4 * i];
+  }
+}
+
+const char *weref_image_extension() {
+#ifdef WEREF_USE_LIBJPEG
+  return ".jpg";
+#else
+  return ".ppm";
+#endif
+}
+
+bool weref_image_write(const char *path, const unsigned char *rgb, int width, int height, int quality) {
+  FILE *file = fopen(path, "wb");
+  if (!file) {
+    fprintf(stderr, "Error: weref_image_write(): could not create '%s'.\n", path);
+    return false;
+  }
+#ifdef WEREF_USE_LIBJPEG
+  bool success = write_jpeg(file, rgb, width, height, quality);
+#else
+  (void)quality;
+  fprintf(file, "P6\n%d %d\n255\n", width, height);
+  bool success = fwrite(rgb, 3 * width, height, file) == (size_t)height;
+#endif
+  success = fclose(file) == 0 && success;
+  if (!success)
+    fprintf(stderr, "Error: weref_image_write(): could not write '%s'.\n", path);
+  return success;
+}
+
+bool weref_image_encode(const unsigned char *rgb, int width, int height, int quality, WerefEncodedImage *image) {
+#ifdef WEREF_USE_LIBJPEG
+  return encode_jpeg(rgb, width, height, quality, image);
+#else
+  (void)quality;
+  char header[32];
+  const int header_length = snprintf(header, sizeof(header), "P6\n%d %d\n255\n", width, height);
+  const size_t size = header_length + (size_t)3 * width * height;
+  if (size > image->capacity) {
+    unsigned char *data = realloc(image->data, size);
+    if (!data) {
+      fprintf(stderr, "Error: weref_image_encode(): could not allocate %zu bytes.\n", size);
+      return false;
+    }
+    image->data = data;
+    image->capacity = size;
+  }
+  memcpy(image->data, header, header_length);
+  memcpy(image->data + header_length, rgb, (size_t)3 * width * height);
+  image->size = size;
+  return true;
+#endif
+}
+
+bool weref_encoded_image_write(const char *path, const WerefEncodedImage *image) {
+  FILE *file = fopen(path, "wb");
+  if (!file) {
+    fprintf(stderr, "Error: weref_encoded_image_write(): could not create '%s'.\n", path);
+    return false;
+  }
+  bool success = fwrite(image->data, 1, image->size, file) == image->size;
+  success = fclose(file) == 0 && success;
+  if (!success)
+    fprintf(stderr, "Error: weref_encoded_image_write(): could not write '%s'.\n", path);
+  return success;
+}
+
+void weref_encoded_image_cleanup(WerefEncodedImage *image) {
+  free(image->data);
+  memset(image, 0, sizeof(*image));
+}
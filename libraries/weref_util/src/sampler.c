@@ -0,0 +1,236 @@
+#include "weref/sampler.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct WerefSamplerStream {
+  uint32_t index;   // number of points drawn
+  double shift[2];  // Cranley-Patterson rotation of the Sobol points
+  int *cells;       // stratified mode: visiting order of the cells, reshuffled every pass
+} WerefSamplerStream;
+
+typedef struct WerefSamplerPrivate {
+  WerefSamplerMode mode;
+  uint64_t seed;
+  uint64_t state[4];  // xoshiro256** state
+  int strata;
+  WerefSamplerStream streams[WEREF_SAMPLER_MAX_STREAMS];
+} WerefSamplerPrivate_t;
+
+typedef struct WerefRadialTablePrivate {
+  double r_min;
+  double step;
+  int size;
+  double *cdf;  // normalized CDF at r_min + i * step, i in [0, size]
+} WerefRadialTablePrivate_t;
+
+//***********************************//
+//        Utility functions          //
+//***********************************//
+
+static uint64_t splitmix64(uint64_t *x) {
+  uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+static inline uint64_t rotl(const uint64_t x, int k) {
+  return (x << k) | (x >> (64 - k));
+}
+
+static double to_unit(uint64_t x) {
+  return (x >> 11) * 0x1.0p-53;
+}
+
+static double fraction(double x) {
+  return x >= 1.0 ? x - 1.0 : x;
+}
+
+// first two dimensions of the Sobol sequence: bit reversal (van der Corput) and the direction numbers of the
+// primitive polynomial x + 1, v_k = v_(k-1) ^ (v_(k-1) >> 1)
+static void sobol_point(uint32_t index, double point[2]) {
+  uint32_t x = 0, y = 0, v = 1u << 31;
+  int k;
+  for (k = 0; index; ++k, index >>= 1, v ^= v >> 1) {
+    if (index & 1) {
+      x ^= 1u << (31 - k);
+      y ^= v;
+    }
+  }
+  point[0] = x * 0x1.0p-32;
+  point[1] = y * 0x1.0p-32;
+}
+
+static void shuffle(WerefSampler sampler, int *values, int n) {
+  int i;
+  for (i = n - 1; i > 0; --i) {
+    int j = (int)(weref_sampler_next_u64(sampler) % (uint64_t)(i + 1));
+    int tmp = values[i];
+    values[i] = values[j];
+    values[j] = tmp;
+  }
+}
+
+//***********************************//
+//          API functions            //
+//***********************************//
+
+WerefSampler weref_sampler_new(WerefSamplerMode mode, uint64_t seed, int strata) {
+  WerefSampler sampler = calloc(1, sizeof(WerefSamplerPrivate_t));
+  sampler->mode = mode;
+  sampler->seed = seed;
+  sampler->strata = strata > 0 ? strata : 1;
+
+  uint64_t x = seed;
+  int i;
+  for (i = 0; i < 4; ++i)
+    sampler->state[i] = splitmix64(&x);
+
+  const int n_cells = sampler->strata * sampler->strata;
+  for (i = 0; i < WEREF_SAMPLER_MAX_STREAMS; ++i) {
+    WerefSamplerStream *stream = &sampler->streams[i];
+    stream->shift[0] = to_unit(weref_sampler_next_u64(sampler));
+    stream->shift[1] = to_unit(weref_sampler_next_u64(sampler));
+    if (mode == WEREF_SAMPLER_STRATIFIED) {
+      stream->cells = malloc(n_cells * sizeof(int));
+      int j;
+      for (j = 0; j < n_cells; ++j)
+        stream->cells[j] = j;
+    }
+  }
+  return sampler;
+}
+
+void weref_sampler_cleanup(WerefSampler sampler) {
+  if (sampler == NULL)
+    return;
+  int i;
+  for (i = 0; i < WEREF_SAMPLER_MAX_STREAMS; ++i)
+    free(sampler->streams[i].cells);
+  free(sampler);
+}
+
+int weref_sampler_parse_mode(const char *name) {
+  if (strcmp(name, "random") == 0)
+    return WEREF_SAMPLER_RANDOM;
+  if (strcmp(name, "sobol") == 0)
+    return WEREF_SAMPLER_SOBOL;
+  if (strcmp(name, "stratified") == 0)
+    return WEREF_SAMPLER_STRATIFIED;
+  return -1;
+}
+
+uint64_t weref_sampler_default_seed() {
+  uint64_t x = ((uint64_t)time(NULL) << 32) ^ (uint64_t)clock() ^ ((uint64_t)getpid() << 16);
+  return splitmix64(&x);
+}
+
+uint64_t weref_sampler_get_seed(const WerefSampler sampler) {
+  return sampler->seed;
+}
+
+uint64_t weref_sampler_next_u64(WerefSampler sampler) {
+  uint64_t *s = sampler->state;
+  const uint64_t result = rotl(s[1] * 5, 7) * 9;
+  const uint64_t t = s[1] << 17;
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = rotl(s[3], 45);
+  return result;
+}
+
+double weref_sampler_uniform(WerefSampler sampler, double min, double max) {
+  return min + (max - min) * to_unit(weref_sampler_next_u64(sampler));
+}
+
+void weref_sampler_next_point(WerefSampler sampler, int stream_index, double point[2]) {
+  if (stream_index < 0 || stream_index >= WEREF_SAMPLER_MAX_STREAMS) {
+    fprintf(stderr, "Error: weref_sampler_next_point(): invalid stream %d.\n", stream_index);
+    point[0] = point[1] = 0.0;
+    return;
+  }
+  WerefSamplerStream *stream = &sampler->streams[stream_index];
+  switch (sampler->mode) {
+    case WEREF_SAMPLER_SOBOL:
+      sobol_point(stream->index, point);
+      point[0] = fraction(point[0] + stream->shift[0]);
+      point[1] = fraction(point[1] + stream->shift[1]);
+      break;
+    case WEREF_SAMPLER_STRATIFIED: {
+      // jittered grid, every cell is visited once per pass in a random order
+      const int n_cells = sampler->strata * sampler->strata;
+      const int position = stream->index % n_cells;
+      if (position == 0)
+        shuffle(sampler, stream->cells, n_cells);
+      const int cell = stream->cells[position];
+      point[0] = (cell % sampler->strata + to_unit(weref_sampler_next_u64(sampler))) / sampler->strata;
+      point[1] = (cell / sampler->strata + to_unit(weref_sampler_next_u64(sampler))) / sampler->strata;
+      break;
+    }
+    default:
+      point[0] = to_unit(weref_sampler_next_u64(sampler));
+      point[1] = to_unit(weref_sampler_next_u64(sampler));
+      break;
+  }
+  ++stream->index;
+}
+
+WerefRadialTable weref_radial_table_new(double r_min, double r_max, int size, WerefRadialDensity density) {
+  if (size < 1 || r_max <= r_min) {
+    fprintf(stderr, "Error: weref_radial_table_new(): invalid range [%g, %g] or size %d.\n", r_min, r_max, size);
+    return NULL;
+  }
+  WerefRadialTable table = malloc(sizeof(WerefRadialTablePrivate_t));
+  table->r_min = r_min;
+  table->step = (r_max - r_min) / size;
+  table->size = size;
+  table->cdf = malloc((size + 1) * sizeof(double));
+
+  // trapezoidal integration of the density
+  table->cdf[0] = 0.0;
+  double previous = density(r_min);
+  int i;
+  for (i = 1; i <= size; ++i) {
+    const double current = density(r_min + i * table->step);
+    table->cdf[i] = table->cdf[i - 1] + 0.5 * (previous + current) * table->step;
+    previous = current;
+  }
+  const double total = table->cdf[size];
+  if (total <= 0.0) {
+    fprintf(stderr, "Error: weref_radial_table_new(): the density is zero over [%g, %g].\n", r_min, r_max);
+    weref_radial_table_cleanup(table);
+    return NULL;
+  }
+  for (i = 1; i <= size; ++i)
+    table->cdf[i] /= total;
+  return table;
+}
+
+void weref_radial_table_cleanup(WerefRadialTable table) {
+  if (table == NULL)
+    return;
+  free(table->cdf);
+  free(table);
+}
+
+double weref_radial_table_sample(const WerefRadialTable table, double u) {
+  // last entry whose CDF is not greater than u
+  int lo = 0, hi = table->size;
+  while (hi - lo > 1) {
+    const int mid = (lo + hi) / 2;
+    if (table->cdf[mid] <= u)
+      lo = mid;
+    else
+      hi = mid;
+  }
+  const double width = table->cdf[lo + 1] - table->cdf[lo];
+  const double t = width > 0.0 ? (u - table->cdf[lo]) / width : 0.0;
+  return table->r_min + (lo + t) * table->step;
+}
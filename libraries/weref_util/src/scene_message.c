@@ -0,0 +1,70 @@
+#include "weref/scene_message.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#define MESSAGE_TAG "weref1"
+#define EMPTY_LABEL "-"  // written for an empty label, which would shift the following fields
+
+//***********************************//
+//        Utility functions          //
+//***********************************//
+
+static const char *encode_label(const char *label) {
+  return label[0] ? label : EMPTY_LABEL;
+}
+
+static void decode_label(char *label) {
+  if (strcmp(label, EMPTY_LABEL) == 0)
+    label[0] = '\0';
+}
+
+//***********************************//
+//          API functions            //
+//***********************************//
+
+int weref_scene_message_encode(const WerefSceneMessage *message, char *buffer, int size) {
+  const WerefSceneState *scene = &message->scene;
+  int n = snprintf(buffer, size, MESSAGE_TAG " %s %s %s %s %s %d %d %d %" PRIu64, encode_label(message->gesture),
+                   encode_label(message->referee_model), encode_label(message->cloth),
+                   encode_label(message->background), encode_label(message->position), message->sample,
+                   message->capture, message->render, message->seed);
+  int i;
+  for (i = 0; i < WEREF_ROBOT_COUNT && n < size; ++i)
+    n += snprintf(buffer + n, size - n, " %.5f %.5f %.5f", scene->robots[i].x, scene->robots[i].y,
+                  scene->robots[i].yaw);
+  if (n < size)
+    n += snprintf(buffer + n, size - n, " %d %.5f %.5f %.5f %.5f %.5f %.5f %.5f", scene->obstacle_flag,
+                  scene->ball[0], scene->ball[1], scene->ball[2], scene->light_direction[0],
+                  scene->light_direction[1], scene->light_direction[2], scene->light_luminosity);
+  return n < size ? n : -1;
+}
+
+bool weref_scene_message_decode(const char *text, WerefSceneMessage *message) {
+  if (strncmp(text, MESSAGE_TAG " ", strlen(MESSAGE_TAG) + 1) != 0)
+    return false;
+
+  int offset;
+  if (sscanf(text, MESSAGE_TAG " %127s %127s %31s %127s %15s %d %d %d %" SCNu64 "%n", message->gesture,
+             message->referee_model, message->cloth, message->background, message->position, &message->sample,
+             &message->capture, &message->render, &message->seed, &offset) != 9)
+    return false;
+  decode_label(message->gesture);
+  decode_label(message->referee_model);
+  decode_label(message->cloth);
+  decode_label(message->background);
+  decode_label(message->position);
+  text += offset;
+
+  WerefSceneState *scene = &message->scene;
+  int i;
+  for (i = 0; i < WEREF_ROBOT_COUNT; ++i) {
+    if (sscanf(text, " %lf %lf %lf%n", &scene->robots[i].x, &scene->robots[i].y, &scene->robots[i].yaw, &offset) != 3)
+      return false;
+    text += offset;
+  }
+  return sscanf(text, " %d %lf %lf %lf %lf %lf %lf %lf", &scene->obstacle_flag, &scene->ball[0], &scene->ball[1],
+                &scene->ball[2], &scene->light_direction[0], &scene->light_direction[1], &scene->light_direction[2],
+                &scene->light_luminosity) == 8;
+}
@@ -0,0 +1,20 @@
+#include "weref/scene_state.h"
+
+#include <math.h>
+#include <string.h>
+
+const char *const weref_robot_names[WEREF_ROBOT_COUNT] = {"red2", "red3", "blue4", "obstacle"};
+
+void weref_scene_state_reset(WerefSceneState *state) {
+  memset(state, 0, sizeof(WerefSceneState));
+  state->obstacle_flag = -1;
+}
+
+double weref_rotation_to_yaw(const double rotation[4]) {
+  // heading of the rotated x axis projected on the ground plane
+  const double c = cos(rotation[3]);
+  const double s = sin(rotation[3]);
+  const double x = c + rotation[0] * rotation[0] * (1.0 - c);
+  const double y = rotation[1] * rotation[0] * (1.0 - c) + rotation[2] * s;
+  return atan2(y, x);
+}
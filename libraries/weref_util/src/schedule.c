@@ -0,0 +1,88 @@
+#include "weref/schedule.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+//***********************************//
+//        Utility functions          //
+//***********************************//
+
+static bool match_pattern(const char *pattern, const char *name) {
+  const size_t pattern_length = strlen(pattern);
+  const size_t name_length = strlen(name);
+  if (strcmp(pattern, "*") == 0)
+    return true;
+  if (pattern[0] == '*')
+    return name_length >= pattern_length - 1 &&
+           strcmp(name + name_length - (pattern_length - 1), pattern + 1) == 0;
+  if (pattern[pattern_length - 1] == '*')
+    return strncmp(name, pattern, pattern_length - 1) == 0;
+  return strcmp(pattern, name) == 0;
+}
+
+static int to_steps(double time, int time_step) {
+  return (int)floor(time * 1000.0 / time_step + 0.5);
+}
+
+//***********************************//
+//          API functions            //
+//***********************************//
+
+bool weref_schedule_load(const char *path, const char *gesture, WerefSchedule *schedule) {
+  FILE *file = fopen(path, "r");
+  if (!file) {
+    fprintf(stderr, "Error: weref_schedule_load(): could not open '%s'.\n", path);
+    return false;
+  }
+
+  char line[256];
+  int line_number = 0;
+  bool found = false;
+  while (!found && fgets(line, sizeof(line), file)) {
+    ++line_number;
+    char pattern[64];
+    WerefSchedule entry;
+    const int n = sscanf(line, "%63s %lf %lf %d %d", pattern, &entry.start, &entry.period, &entry.frames,
+                         &entry.stride);
+    if (n <= 0 || pattern[0] == '#')
+      continue;
+    if (n != 5 || entry.period <= 0.0 || entry.frames < 0 || entry.stride < 1) {
+      fprintf(stderr, "Error: weref_schedule_load(): invalid entry at %s:%d.\n", path, line_number);
+      continue;
+    }
+    if (match_pattern(pattern, gesture)) {
+      *schedule = entry;
+      found = true;
+    }
+  }
+  fclose(file);
+  return found;
+}
+
+void weref_schedule_default(int frame_count, int frames_per_step, int motion_time_step, int time_step,
+                            WerefSchedule *schedule) {
+  // the motion controller steps at a multiple of the basic time step and restarts from frame 1 when it has less
+  // than 'frames_per_step' frames left
+  const int motion_steps = (int)ceil((double)motion_time_step / time_step) * time_step;
+  const int cycle_steps = frame_count > 1 ? (frame_count - 1 + frames_per_step - 1) / frames_per_step : 1;
+  schedule->period = cycle_steps * motion_steps / 1000.0;
+  schedule->start = schedule->period + motion_steps / 1000.0;
+  schedule->frames = to_steps(schedule->period, time_step);
+  schedule->stride = 1;
+}
+
+int weref_schedule_step(const WerefSchedule *schedule, int step, int time_step) {
+  const int start_step = to_steps(schedule->start, time_step);
+  if (step < start_step)
+    return 0;
+  int period_steps = to_steps(schedule->period, time_step);
+  if (period_steps < 1)
+    period_steps = 1;
+
+  const int phase = (step - start_step) % period_steps;
+  int flags = phase == 0 ? WEREF_SCHEDULE_NEW_SAMPLE : 0;
+  if (phase % schedule->stride == 0 && phase / schedule->stride < schedule->frames)
+    flags |= WEREF_SCHEDULE_CAPTURE;
+  return flags;
+}
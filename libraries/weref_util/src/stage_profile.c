@@ -0,0 +1,90 @@
+#include "weref/stage_profile.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_LINE_LENGTH 512
+
+static const char *const stage_names[WEREF_STAGE_COUNT] = {"step",   "supervisor", "capture",
+                                                           "encode", "write",      "save_image"};
+
+//***********************************//
+//        Utility functions          //
+//***********************************//
+
+static double wall_time(const WerefStageProfile *profile) {
+  return weref_stage_clock() - profile->start;
+}
+
+//***********************************//
+//          API functions            //
+//***********************************//
+
+double weref_stage_clock() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+const char *weref_stage_name(WerefStage stage) {
+  return stage >= 0 && stage < WEREF_STAGE_COUNT ? stage_names[stage] : "";
+}
+
+void weref_stage_profile_start(WerefStageProfile *profile) {
+  memset(profile, 0, sizeof(*profile));
+  profile->start = weref_stage_clock();
+}
+
+double weref_stage_add(WerefStageProfile *profile, WerefStage stage, double start) {
+  const double now = weref_stage_clock();
+  profile->seconds[stage] += now - start;
+  return now;
+}
+
+void weref_stage_profile_print(const WerefStageProfile *profile, const char *robot, double simulated_time) {
+  const double wall = wall_time(profile);
+  if (wall <= 0.0)
+    return;
+  printf("Profile of %s: %.2f s of wall-clock time, %.2f simulated seconds per second", robot, wall,
+         simulated_time / wall);
+  if (profile->frames > 0)
+    printf(", %lld frames saved (%.2f per second)", profile->frames, profile->frames / wall);
+  printf("\n");
+  double other = wall;
+  int i;
+  for (i = 0; i < WEREF_STAGE_COUNT; ++i) {
+    if (profile->seconds[i] > 0.0)
+      printf("  %-11s %9.3f s %5.1f%%\n", stage_names[i], profile->seconds[i], 100.0 * profile->seconds[i] / wall);
+    other -= profile->seconds[i];
+  }
+  printf("  %-11s %9.3f s %5.1f%%\n", "other", other, 100.0 * other / wall);
+}
+
+bool weref_stage_profile_append(const char *path, const WerefStageProfile *profile, const char *controller,
+                                const char *robot, double simulated_time) {
+  char line[MAX_LINE_LENGTH];
+  int length = snprintf(line, sizeof(line), "%s\t%s\t%.3f\t%.6f\t%lld", controller, robot, simulated_time,
+                        wall_time(profile), profile->frames);
+  int i;
+  for (i = 0; i < WEREF_STAGE_COUNT && length < (int)sizeof(line); ++i)
+    length += snprintf(line + length, sizeof(line) - length, "\t%.6f", profile->seconds[i]);
+  if (length >= (int)sizeof(line) - 1) {
+    fprintf(stderr, "Error: weref_stage_profile_append(): the line does not fit in %d bytes.\n", MAX_LINE_LENGTH);
+    return false;
+  }
+  line[length++] = '\n';
+  // one write() of a file opened with O_APPEND: the lines of concurrent controllers don't interleave
+  const int fd = open(path, O_WRONLY | O_APPEND | O_CREAT, 0644);
+  if (fd < 0) {
+    fprintf(stderr, "Error: weref_stage_profile_append(): could not open '%s'.\n", path);
+    return false;
+  }
+  const bool success = write(fd, line, length) == length;
+  close(fd);
+  if (!success)
+    fprintf(stderr, "Error: weref_stage_profile_append(): could not write '%s'.\n", path);
+  return success;
+}
@@ -0,0 +1,214 @@
+#include "weref/trace.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define RING_CAPACITY 4096   // events buffered per thread
+#define CHUNK_SIZE 65536     // bytes of whole events written at once
+#define MAX_EVENT_LENGTH 512
+
+typedef struct TraceEvent {
+  const char *name;
+  double start;     // [us]
+  double duration;  // [us]
+} TraceEvent;
+
+typedef struct TraceRing {
+  TraceEvent events[RING_CAPACITY];
+  int head;  // oldest event
+  int count;
+  // guards 'head' and 'count' between the thread of the ring and weref_trace_stop(), taken after 'trace_mutex'; it is
+  // only contended while the trace stops
+  pthread_mutex_t mutex;
+  int thread_id;
+  struct TraceRing *next;
+} TraceRing;
+
+// The rings are registered on the first event of their thread and kept until the process exits, so that
+// weref_trace_stop() writes the events of threads that already ended.
+static pthread_mutex_t trace_mutex = PTHREAD_MUTEX_INITIALIZER;
+static TraceRing *rings = NULL;
+static int thread_count = 0;
+static _Thread_local TraceRing *thread_ring = NULL;
+
+static atomic_int trace_fd = -1;  // read without the mutex by the traced threads
+static int process_id = 0;
+static bool write_failed = false;
+static char chunk[CHUNK_SIZE];
+static int chunk_length = 0;
+
+//***********************************//
+//        Utility functions          //
+//***********************************//
+
+// Copies 'text' to 'buffer' as the content of a JSON string. Returns the length written, without the terminator.
+static int json_escape(const char *text, char *buffer, int size) {
+  int length = 0;
+  for (; *text && length < size - 7; ++text) {
+    const unsigned char c = (unsigned char)*text;
+    if (c == '"' || c == '\\')
+      length += snprintf(buffer + length, size - length, "\\%c", c);
+    else if (c < 0x20)
+      length += snprintf(buffer + length, size - length, "\\u%04x", c);
+    else
+      buffer[length++] = c;
+  }
+  buffer[length] = '\0';
+  return length;
+}
+
+// Writes the chunk in a single write, the lines of concurrent processes don't interleave. Called with the mutex.
+static void write_chunk() {
+  if (chunk_length > 0 && write(trace_fd, chunk, chunk_length) != chunk_length && !write_failed) {
+    fprintf(stderr, "Error: weref_trace: could not write the trace file.\n");
+    write_failed = true;
+  }
+  chunk_length = 0;
+}
+
+// Appends a line to the chunk, written first if the line does not fit. Called with the mutex.
+static void append_line(const char *line, int length) {
+  if (chunk_length + length > CHUNK_SIZE)
+    write_chunk();
+  memcpy(chunk + chunk_length, line, length);
+  chunk_length += length;
+}
+
+// Writes the events of 'ring' and empties it. Called with the mutex and the one of the ring.
+static void flush_ring(TraceRing *ring) {
+  char name[256], line[MAX_EVENT_LENGTH];
+  for (; ring->count > 0; --ring->count) {
+    const TraceEvent *event = &ring->events[ring->head];
+    ring->head = (ring->head + 1) % RING_CAPACITY;
+    json_escape(event->name, name, sizeof(name));
+    const int length = snprintf(line, sizeof(line),
+                                "{\"name\":\"%s\",\"cat\":\"weref\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+                                "\"pid\":%d,\"tid\":%d},\n",
+                                name, event->start, event->duration, process_id, ring->thread_id);
+    if (length > 0 && length < (int)sizeof(line))
+      append_line(line, length);
+  }
+  ring->head = 0;
+  write_chunk();
+}
+
+static TraceRing *register_thread() {
+  TraceRing *ring = (TraceRing *)calloc(1, sizeof(TraceRing));
+  if (!ring)
+    return NULL;
+  pthread_mutex_init(&ring->mutex, NULL);
+  pthread_mutex_lock(&trace_mutex);
+  ring->thread_id = ++thread_count;
+  ring->next = rings;
+  rings = ring;
+  pthread_mutex_unlock(&trace_mutex);
+  return ring;
+}
+
+//***********************************//
+//          API functions            //
+//***********************************//
+
+bool weref_trace_start(const char *path, const char *controller, const char *robot) {
+  if (!path || !path[0])
+    return false;
+  if (trace_fd >= 0) {
+    fprintf(stderr, "Error: weref_trace_start(): the trace is already started.\n");
+    return false;
+  }
+  // the first process of the run creates the file and opens the array, the others append to it
+  int fd = open(path, O_WRONLY | O_APPEND | O_CREAT | O_EXCL, 0644);
+  const bool created = fd >= 0;
+  if (!created && errno == EEXIST)
+    fd = open(path, O_WRONLY | O_APPEND);
+  if (fd < 0) {
+    fprintf(stderr, "Error: weref_trace_start(): could not open '%s'.\n", path);
+    return false;
+  }
+
+  pthread_mutex_lock(&trace_mutex);
+  trace_fd = fd;
+  process_id = (int)getpid();
+  write_failed = false;
+  if (created)
+    append_line("[\n", 2);
+  char process_name[256], name[256], line[MAX_EVENT_LENGTH];
+  snprintf(process_name, sizeof(process_name), "%s %s", controller, robot);
+  json_escape(process_name, name, sizeof(name));
+  const int length = snprintf(line, sizeof(line),
+                              "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"%s\"}},\n",
+                              process_id, name);
+  append_line(line, length);
+  write_chunk();
+  pthread_mutex_unlock(&trace_mutex);
+  return true;
+}
+
+void weref_trace_stop() {
+  pthread_mutex_lock(&trace_mutex);
+  if (trace_fd >= 0) {
+    TraceRing *ring;
+    for (ring = rings; ring; ring = ring->next) {
+      pthread_mutex_lock(&ring->mutex);
+      flush_ring(ring);
+      pthread_mutex_unlock(&ring->mutex);
+    }
+    close(trace_fd);
+    trace_fd = -1;
+  }
+  pthread_mutex_unlock(&trace_mutex);
+}
+
+bool weref_trace_is_started() {
+  return trace_fd >= 0;
+}
+
+double weref_trace_clock() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1e6 + now.tv_nsec * 1e-3;
+}
+
+void weref_trace_complete(const char *name, double start) {
+  const double end = weref_trace_clock();
+  if (trace_fd < 0)
+    return;
+  if (!thread_ring && !(thread_ring = register_thread()))
+    return;
+  TraceRing *ring = thread_ring;
+  pthread_mutex_lock(&ring->mutex);
+  ring->events[(ring->head + ring->count) % RING_CAPACITY] = (TraceEvent){name, start, end - start};
+  const bool full = ++ring->count == RING_CAPACITY;
+  pthread_mutex_unlock(&ring->mutex);
+  if (!full)
+    return;
+  // full ring: its write is traced too, as it delays the traced thread
+  pthread_mutex_lock(&trace_mutex);
+  pthread_mutex_lock(&ring->mutex);
+  if (trace_fd >= 0)
+    flush_ring(ring);
+  else {
+    ring->head = 0;  // the trace stopped meanwhile: the events are dropped
+    ring->count = 0;
+  }
+  ring->events[ring->count++] = (TraceEvent){"weref_trace_flush", end, weref_trace_clock() - end};
+  pthread_mutex_unlock(&ring->mutex);
+  pthread_mutex_unlock(&trace_mutex);
+}
+
+WerefTraceScope weref_trace_scope_begin(const char *name) {
+  WerefTraceScope scope = {name, trace_fd >= 0 ? weref_trace_clock() : 0.0};
+  return scope;
+}
+
+void weref_trace_scope_end(WerefTraceScope *scope) {
+  if (scope->start > 0.0)
+    weref_trace_complete(scope->name, scope->start);
+}
@@ -0,0 +1,287 @@
+#define _XOPEN_SOURCE 700  // nftw()
+
+#include "weref/world_template.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <ftw.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define MAX_PARAMETERS 64
+#define MAX_NAME 64
+#define MAX_VALUE 256
+#define MAX_LINE 4096
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+typedef struct WerefWorldParametersPrivate {
+  int count;
+  char names[MAX_PARAMETERS][MAX_NAME];
+  char values[MAX_PARAMETERS][MAX_VALUE];
+} WerefWorldParametersPrivate_t;
+
+//***********************************//
+//        Utility functions          //
+//***********************************//
+
+static uint64_t fnv1a(uint64_t hash, const void *data, size_t size) {
+  const unsigned char *bytes = data;
+  for (size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= FNV_PRIME;
+  }
+  return hash;
+}
+
+static bool ends_with(const char *text, const char *suffix) {
+  const size_t length = strlen(text), suffix_length = strlen(suffix);
+  return length >= suffix_length && strcmp(text + length - suffix_length, suffix) == 0;
+}
+
+// Writes '<dir>/<name>' to 'path' of PATH_MAX bytes. Returns false if it does not fit.
+static bool join_path(char *path, const char *dir, const char *name) {
+  return snprintf(path, PATH_MAX, "%s/%s", dir, name) < PATH_MAX;
+}
+
+static const char *find_parameter(const WerefWorldParameters parameters, const char *name, size_t name_length) {
+  for (int i = 0; i < parameters->count; i++) {
+    if (strlen(parameters->names[i]) == name_length && strncmp(parameters->names[i], name, name_length) == 0)
+      return parameters->values[i];
+  }
+  return NULL;
+}
+
+static bool link_entry(const char *target_dir, const char *name, const char *link_dir) {
+  char target[PATH_MAX], link_path[PATH_MAX];
+  if (!join_path(target, target_dir, name) || !join_path(link_path, link_dir, name) ||
+      symlink(target, link_path) != 0) {
+    fprintf(stderr, "Error: could not link '%s' to '%s'.\n", link_path, target);
+    return false;
+  }
+  return true;
+}
+
+// Fills the new directory 'dir' with links to the controllers, libraries, motions and world resources of the
+// project and the world file 'world_file' of content 'text'.
+static bool build_project(const char *dir, const char *project_dir, const char *world_file, const char *text) {
+  char worlds_dir[PATH_MAX], source_worlds[PATH_MAX], world_path[PATH_MAX];
+  if (!join_path(worlds_dir, dir, "worlds") || !join_path(source_worlds, project_dir, "worlds") ||
+      !join_path(world_path, worlds_dir, world_file) || mkdir(worlds_dir, 0755) != 0) {
+    fprintf(stderr, "Error: could not create '%s/worlds'.\n", dir);
+    return false;
+  }
+  if (!link_entry(project_dir, "controllers", dir) || !link_entry(project_dir, "libraries", dir) ||
+      !link_entry(project_dir, "motions", dir))
+    return false;
+
+  // protos, textures and other resources referenced by the world relatively to it
+  DIR *entries = opendir(source_worlds);
+  if (!entries) {
+    fprintf(stderr, "Error: could not open '%s'.\n", source_worlds);
+    return false;
+  }
+  struct dirent *entry;
+  bool success = true;
+  while (success && (entry = readdir(entries))) {
+    if (entry->d_name[0] != '.' && !ends_with(entry->d_name, ".wbt") && strcmp(entry->d_name, "templates") != 0)
+      success = link_entry(source_worlds, entry->d_name, worlds_dir);
+  }
+  closedir(entries);
+  if (!success)
+    return false;
+
+  FILE *file = fopen(world_path, "w");
+  if (!file || fputs(text, file) == EOF || fclose(file) != 0) {
+    fprintf(stderr, "Error: could not write '%s'.\n", world_path);
+    return false;
+  }
+  return true;
+}
+
+static int remove_entry(const char *path, const struct stat *status, int flag, struct FTW *ftw) {
+  (void)status;
+  (void)flag;
+  (void)ftw;
+  return remove(path);
+}
+
+//***********************************//
+//          API functions            //
+//***********************************//
+
+WerefWorldParameters weref_world_parameters_new() {
+  return calloc(1, sizeof(WerefWorldParametersPrivate_t));
+}
+
+void weref_world_parameters_cleanup(WerefWorldParameters parameters) {
+  free(parameters);
+}
+
+bool weref_world_parameters_read(WerefWorldParameters parameters, const char *path, const char *world) {
+  FILE *file = fopen(path, "r");
+  if (!file) {
+    fprintf(stderr, "Error: could not open '%s'.\n", path);
+    return false;
+  }
+  char header[MAX_LINE], line[MAX_LINE];
+  char *columns[MAX_PARAMETERS + 1];
+  int column_count = 0;
+  bool found = false;
+  while (!found && fgets(line, sizeof(line), file)) {
+    line[strcspn(line, "\r\n")] = '\0';
+    if (line[strspn(line, " \t")] == '\0' || line[0] == '#')
+      continue;
+    char *save;
+    if (column_count == 0) {
+      strcpy(header, line);
+      for (char *name = strtok_r(header, " \t", &save); name && column_count <= MAX_PARAMETERS;
+           name = strtok_r(NULL, " \t", &save))
+        columns[column_count++] = name;
+      continue;
+    }
+    const char *value = strtok_r(line, " \t", &save);
+    if (!value || strcmp(value, world) != 0)
+      continue;
+    found = true;
+    for (int i = 1; i < column_count; i++) {
+      value = strtok_r(NULL, " \t", &save);
+      if (!value) {
+        fprintf(stderr, "Error: '%s' has no %s value in '%s'.\n", world, columns[i], path);
+        fclose(file);
+        return false;
+      }
+      if (!weref_world_parameters_set(parameters, columns[i], strlen(columns[i]), value)) {
+        fclose(file);
+        return false;
+      }
+    }
+  }
+  fclose(file);
+  if (!found)
+    fprintf(stderr, "Error: '%s' is not in '%s'.\n", world, path);
+  return found;
+}
+
+bool weref_world_parameters_set(WerefWorldParameters parameters, const char *name, size_t name_length,
+                                const char *value) {
+  if (name_length == 0 || name_length >= MAX_NAME || strlen(value) >= MAX_VALUE) {
+    fprintf(stderr, "Error: invalid parameter '%.*s'.\n", (int)name_length, name);
+    return false;
+  }
+  int i;
+  for (i = 0; i < parameters->count; i++) {
+    if (strlen(parameters->names[i]) == name_length && strncmp(parameters->names[i], name, name_length) == 0)
+      break;
+  }
+  if (i == MAX_PARAMETERS) {
+    fprintf(stderr, "Error: more than %d parameters.\n", MAX_PARAMETERS);
+    return false;
+  }
+  if (i == parameters->count) {
+    memcpy(parameters->names[i], name, name_length);
+    parameters->names[i][name_length] = '\0';
+    parameters->count++;
+  }
+  strcpy(parameters->values[i], value);
+  return true;
+}
+
+const char *weref_world_parameters_get(const WerefWorldParameters parameters, const char *name) {
+  return find_parameter(parameters, name, strlen(name));
+}
+
+char *weref_world_template_render(const char *path, const WerefWorldParameters parameters) {
+  FILE *file = fopen(path, "r");
+  if (!file) {
+    fprintf(stderr, "Error: could not open '%s'.\n", path);
+    return NULL;
+  }
+  size_t capacity = 1 << 16, length = 0;
+  char *text = malloc(capacity);
+  char line[MAX_LINE];
+  while (text && fgets(line, sizeof(line), file)) {
+    const char *p = line, *start;
+    while (text) {
+      start = strstr(p, "${");
+      const char *end = start ? strchr(start, '}') : NULL;
+      const size_t literal = start ? (size_t)(start - p) : strlen(p);
+      const char *value = "";
+      if (start) {
+        value = end ? find_parameter(parameters, start + 2, end - start - 2) : NULL;
+        if (!value) {
+          fprintf(stderr, "Error: undefined template variable '%.*s' in '%s'.\n",
+                  end ? (int)(end - start + 1) : (int)strcspn(start, "\n"), start, path);
+          free(text);
+          text = NULL;
+          break;
+        }
+      }
+      const size_t needed = length + literal + strlen(value) + 1;
+      if (needed > capacity) {
+        while (needed > capacity)
+          capacity *= 2;
+        char *larger = realloc(text, capacity);
+        if (!larger) {
+          free(text);
+          text = NULL;
+          break;
+        }
+        text = larger;
+      }
+      memcpy(text + length, p, literal);
+      length += literal;
+      strcpy(text + length, value);
+      length += strlen(value);
+      if (!start)
+        break;
+      p = end + 1;
+    }
+  }
+  fclose(file);
+  if (text)
+    text[length] = '\0';
+  return text;
+}
+
+bool weref_world_project_create(const char *scratch_dir, const char *project_dir, const char *world_file,
+                                const char *text, char *world_path) {
+  // the links of the project point to 'project_dir' and the labels derive from the file name: both are content
+  uint64_t hash = fnv1a(FNV_OFFSET_BASIS, project_dir, strlen(project_dir) + 1);
+  hash = fnv1a(hash, world_file, strlen(world_file) + 1);
+  hash = fnv1a(hash, text, strlen(text));
+  char hash_name[32], dir[PATH_MAX], worlds_dir[PATH_MAX];
+  snprintf(hash_name, sizeof(hash_name), "%016" PRIx64, hash);
+  if ((mkdir(scratch_dir, 0755) != 0 && errno != EEXIST) || !join_path(dir, scratch_dir, hash_name) ||
+      !join_path(worlds_dir, dir, "worlds") || !join_path(world_path, worlds_dir, world_file)) {
+    fprintf(stderr, "Error: could not create '%s'.\n", scratch_dir);
+    return false;
+  }
+
+  struct stat status;
+  if (stat(world_path, &status) == 0)
+    return true;
+  // built under a private name, then renamed: a concurrent creator of the same world either wins the rename or finds
+  // the complete project
+  char temporary_name[64], temporary[PATH_MAX];
+  snprintf(temporary_name, sizeof(temporary_name), ".%s.%ld", hash_name, (long)getpid());
+  if (!join_path(temporary, scratch_dir, temporary_name) || mkdir(temporary, 0755) != 0) {
+    fprintf(stderr, "Error: could not create '%s/%s'.\n", scratch_dir, temporary_name);
+    return false;
+  }
+  const bool built = build_project(temporary, project_dir, world_file, text);
+  if (!built || (rename(temporary, dir) != 0 && errno != EEXIST && errno != ENOTEMPTY)) {
+    if (built)
+      fprintf(stderr, "Error: could not rename '%s' to '%s'.\n", temporary, dir);
+    nftw(temporary, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+    return false;
+  }
+  nftw(temporary, remove_entry, 16, FTW_DEPTH | FTW_PHYS);  // left over if another creator won the rename
+  return true;
+}
@@ -1,7 +1,9 @@
 #!/bin/bash
 
 WEBOTS_PATH="/Applications/Webots.app/Contents/MacOS/webots"
-WORLDS_DIR="worlds"
+WORLD_GENERATOR="tools/world_generator/world_generator"
+
+make -C libraries/weref_util --quiet && make -C tools/world_generator --quiet || exit 1
 
 GESTURES=(
   "corner_kick_blue.bvh"
@@ -53,23 +55,20 @@ WBT_FILES=(
 for gesture in "${GESTURES[@]}"; do
   echo "=== Using gesture: $gesture ==="
 
-  DURATION=45
+  # one sample of 42 frames per motion cycle of 0.84 s: the samples per world variation of the dataset, see the README
+  SAMPLES=6
   
   for wbt in "${WBT_FILES[@]}"; do
-    echo "Modifying $wbt => $gesture"
-
-    sed -i '' "s|\(\.\./\.\./motions/\)[^\"]*\.bvh|\1$gesture|g" "$WORLDS_DIR/$wbt"
-
-    echo "Running $wbt for $DURATION seconds..."
-    "$WEBOTS_PATH" --batch --mode=fast "$WORLDS_DIR/$wbt" &
-    WEBOTS_PID=$!
-
-    sleep "$DURATION"
+    # rendered from the world template into a scratch project, the tracked world files are left untouched
+    world_path=$("$WORLD_GENERATOR" "${wbt%.wbt}" GESTURE="$gesture") || continue
+    echo "Rendered $wbt => $gesture: $world_path"
 
-    kill "$WEBOTS_PID" 2>/dev/null
-    wait "$WEBOTS_PID" 2>/dev/null
+    # the scene director quits the simulation once the samples are captured, its exit status is Webots' one
+    echo "Running $wbt until $SAMPLES samples are captured..."
+    WEREF_SAMPLES="$SAMPLES" "$WEBOTS_PATH" --batch --mode=fast "$world_path"
+    status=$?
 
-    echo "Stopped $wbt"
+    echo "Stopped $wbt (exit status $status)"
   done
 
   echo "Done with gesture: $gesture"
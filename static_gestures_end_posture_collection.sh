@@ -1,7 +1,9 @@
 #!/bin/bash
 
 WEBOTS_PATH="/Applications/Webots.app/Contents/MacOS/webots"
-WORLDS_DIR="worlds"
+WORLD_GENERATOR="tools/world_generator/world_generator"
+
+make -C libraries/weref_util --quiet && make -C tools/world_generator --quiet || exit 1
 
 GESTURES=(
   "corner_kick_blue_end.bvh"
@@ -52,22 +54,22 @@ WBT_FILES=(
 
 for gesture in "${GESTURES[@]}"; do
   echo "=== Using gesture: $gesture ==="
-  
-  for wbt in "${WBT_FILES[@]}"; do
-    echo "Modifying $wbt => $gesture"
 
-    sed -i '' "s|\(\.\./\.\./motions/\)[^\"]*\.bvh|\1$gesture|g" "$WORLDS_DIR/$wbt"
+  # one frame per sample, see controllers/scene_director/capture_schedule.txt: as many frames per world variation as
+  # the static gestures, 6 samples of 42 frames
+  SAMPLES=252
 
-    echo "Running $wbt for 14 seconds..."
-    "$WEBOTS_PATH" --batch --mode=fast "$WORLDS_DIR/$wbt" &
-    WEBOTS_PID=$!
-
-    sleep 12
+  for wbt in "${WBT_FILES[@]}"; do
+    # rendered from the world template into a scratch project, the tracked world files are left untouched
+    world_path=$("$WORLD_GENERATOR" "${wbt%.wbt}" GESTURE="$gesture") || continue
+    echo "Rendered $wbt => $gesture: $world_path"
 
-    kill "$WEBOTS_PID" 2>/dev/null
-    wait "$WEBOTS_PID" 2>/dev/null
+    # the scene director quits the simulation once the samples are captured, its exit status is Webots' one
+    echo "Running $wbt until $SAMPLES samples are captured..."
+    WEREF_SAMPLES="$SAMPLES" "$WEBOTS_PATH" --batch --mode=fast "$world_path"
+    status=$?
 
-    echo "Stopped $wbt"
+    echo "Stopped $wbt (exit status $status)"
   done
 
   echo "Done with gesture: $gesture"
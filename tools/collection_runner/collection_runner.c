@@ -0,0 +1,774 @@
+/*
+ * Description:   Parallel data collection runner. It runs the gesture x world matrix of a collection as concurrent
+ *                'webots --batch --mode=fast' instances, each pinned to its own CPUs. Every instance loads its world
+ *                rendered from the world template and the parameter table of worlds/templates, with the gesture of
+ *                the job, as the world generator does: the rendered world is placed in the scratch project of its
+ *                content, which links the controllers, libraries and motions of the real one, so that no world file
+ *                is edited in place and Webots' per-world state is not shared. Identical jobs, e.g. of a restarted
+ *                collection, reuse the same project. Each instance writes its dataset under its own output root and
+ *                quits by itself
+ *                once its samples are captured or after its duration. Completions and failures are written to
+ *                '<output_dir>/runner_summary.tsv'.
+ *                The camera robots of all the runs record their progress in '<output_dir>/completion.tsv'. With a
+ *                sample quota (-n), a restarted collection reads it and only runs the gesture x world cells that
+ *                miss samples, for the missing samples only, with a new seed, in a new run directory.
+ *                A quota table (-q) plans the whole sweep instead: it gives the samples of each gesture x referee x
+ *                cloth x background x presence x position cell of the dataset tree. Each gesture x world job gets
+ *                the samples its cells miss, the scene director of its run draws the presence of the obstacle robot
+ *                accordingly and quits once they are filled, and the longest jobs start first.
+ */
+
+#define _GNU_SOURCE  // sched_setaffinity()
+
+#include <errno.h>
+#include <limits.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include <weref/completion_manifest.h>
+#include <weref/world_template.h>
+
+#define MAX_GESTURES 64
+#define MAX_LINE_LENGTH 1024
+#define MAX_INSTANCES 256
+#define POLL_INTERVAL_MS 200
+
+typedef struct Gesture {
+  const char *file;  // BVH file name in motions/, e.g. 'full_time.bvh'
+  double duration;   // simulated duration of its runs [s], 0 if they are only bounded by the timeout
+} Gesture;
+
+typedef enum { JOB_PENDING, JOB_RUNNING, JOB_COMPLETED, JOB_FAILED, JOB_TIMED_OUT, JOB_SKIPPED } JobStatus;
+
+typedef struct Job {
+  char world[136];        // world file name in worlds/
+  const Gesture *gesture;
+  char world_stem[128];   // world and gesture labels of the completion manifest
+  char gesture_stem[128];
+  char name[256];         // '<world>-<gesture>', names the scratch project and output root of the job
+  char cloth[32];         // cloth label of the cells of the quota table, empty with -n
+  int samples;            // samples the run captures, 0 if it is only bounded by its duration or its quota
+  bool has_quota;         // whether the run captures 'quota' instead
+  int quota[2][3];        // missing samples of each presence (0: absent, 1: present) and camera position
+  int work;               // samples the run draws, the longest runs start first
+  JobStatus status;
+  pid_t pid;
+  int exit_code;          // exit code of Webots, or minus the signal that killed it
+  struct timespec start;
+  double wall_time;       // [s]
+} Job;
+
+static const char *project_dir = NULL;  // absolute
+static char output_dir[PATH_MAX];       // absolute
+static char scratch_dir[PATH_MAX];      // absolute
+static char template_path[PATH_MAX];    // world template and its parameter table
+static char parameters_path[PATH_MAX];
+static const char *webots = "webots";
+static int target_samples = 0;
+static char completion_path[PATH_MAX];
+static const char *camera_positions[3] = {"left", "middle", "right"};
+static const char *presence_labels[2] = {"presence_norobot", "presence_robot"};
+static double timeout = 600.0;
+static bool pin_cpus = true;
+
+// Cell of the dataset tree with a quota, from -n or the -q table
+typedef struct Cell {
+  int job;       // index of the job capturing it
+  int presence;  // 0: presence_norobot, 1: presence_robot, -1: both with -n
+  int position;  // index in camera_positions
+  int quota;     // samples
+} Cell;
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void handle_signal(int signal) {
+  (void)signal;
+  stop_requested = 1;
+}
+
+static void sleep_ms(int milliseconds) {
+  const struct timespec interval = {milliseconds / 1000, (milliseconds % 1000) * 1000000L};
+  nanosleep(&interval, NULL);
+}
+
+static double elapsed(const struct timespec *start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+static bool ends_with(const char *text, const char *suffix) {
+  const size_t length = strlen(text), suffix_length = strlen(suffix);
+  return length >= suffix_length && strcmp(text + length - suffix_length, suffix) == 0;
+}
+
+// Writes '<dir>/<name>' to 'path' of PATH_MAX bytes. Returns false if it does not fit.
+static bool join_path(char *path, const char *dir, const char *name) {
+  return snprintf(path, PATH_MAX, "%s/%s", dir, name) < PATH_MAX;
+}
+
+/**
+ * @brief Resolves 'path' to an absolute path, creating the directory first if needed.
+ */
+static bool make_absolute_dir(const char *path, char *absolute) {
+  if (mkdir(path, 0755) != 0 && errno != EEXIST) {
+    fprintf(stderr, "Error: could not create '%s'.\n", path);
+    return false;
+  }
+  if (!realpath(path, absolute)) {
+    fprintf(stderr, "Error: could not resolve '%s'.\n", path);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Renders the world of a job from the world template, with the gesture of the job, in the scratch project of its
+ * content. The world keeps its file name, the labels of the dataset are derived from it.
+ */
+static bool render_world(const Job *job, char *world_path) {
+  WerefWorldParameters parameters = weref_world_parameters_new();
+  bool success = parameters && weref_world_parameters_read(parameters, parameters_path, job->world_stem);
+  if (success && job->gesture->file)
+    success = weref_world_parameters_set(parameters, "GESTURE", strlen("GESTURE"), job->gesture->file);
+  char *text = success ? weref_world_template_render(template_path, parameters) : NULL;
+  weref_world_parameters_cleanup(parameters);
+  success = text && weref_world_project_create(scratch_dir, project_dir, job->world, text, world_path);
+  free(text);
+  return success;
+}
+
+/**
+ * @brief Restricts the calling process to its share of the CPUs: 'cpus_per_instance' consecutive CPUs for the
+ * instance slot 'slot'.
+ */
+static void pin_to_cpus(int slot, int cpus_per_instance) {
+#ifdef __linux__
+  const long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int i = 0; i < cpus_per_instance; i++)
+    CPU_SET((slot * cpus_per_instance + i) % cpu_count, &set);
+  if (sched_setaffinity(0, sizeof(set), &set) != 0)
+    fprintf(stderr, "Warning: could not pin instance %d to its CPUs.\n", slot);
+#else
+  (void)slot;
+  (void)cpus_per_instance;
+#endif
+}
+
+/**
+ * @brief Starts Webots on the scratch world of 'job', in its own process group so that a timeout also stops the
+ * controllers. Its output goes to '<output_dir>/<job>/run_<k>/webots.log', the metrics of the controllers to
+ * '<controller>_<robot>.prom' next to it, and the trace of controllers built with WEREF_TRACE_ENABLED to 'trace.json'.
+ */
+static bool start_job(Job *job, int slot, int cpus_per_instance) {
+  char world_path[PATH_MAX], job_output[PATH_MAX], run_output[PATH_MAX], log_path[PATH_MAX], trace_path[PATH_MAX];
+  if (!join_path(job_output, output_dir, job->name) || (mkdir(job_output, 0755) != 0 && errno != EEXIST) ||
+      !render_world(job, world_path))
+    return false;
+  // each run of the job has its own dataset root, a resumed run does not overwrite the frames of the previous ones
+  for (int run = 0;; run++) {
+    char run_name[32];
+    snprintf(run_name, sizeof(run_name), "run_%d", run);
+    if (!join_path(run_output, job_output, run_name) || !join_path(log_path, run_output, "webots.log") ||
+        !join_path(trace_path, run_output, "trace.json"))
+      return false;
+    if (mkdir(run_output, 0755) == 0)
+      break;
+    if (errno != EEXIST) {
+      fprintf(stderr, "Error: could not create '%s'.\n", run_output);
+      return false;
+    }
+  }
+
+  char duration[32], samples[32], quota[96];
+  snprintf(duration, sizeof(duration), "%g", job->gesture->duration);
+  snprintf(samples, sizeof(samples), "%d", job->samples);
+  snprintf(quota, sizeof(quota), "%d,%d,%d/%d,%d,%d", job->quota[1][0], job->quota[1][1], job->quota[1][2],
+           job->quota[0][0], job->quota[0][1], job->quota[0][2]);
+  fflush(stdout);
+  const pid_t pid = fork();
+  if (pid < 0) {
+    fprintf(stderr, "Error: could not start an instance for %s.\n", job->name);
+    return false;
+  }
+  if (pid == 0) {
+    setpgid(0, 0);
+    if (pin_cpus)
+      pin_to_cpus(slot, cpus_per_instance);
+    // read by the controllers as the defaults of their output root, duration, sample target, quota and completion
+    // manifest options, as their metrics directory, and as their trace file
+    setenv("WEREF_OUTPUT_ROOT", run_output, 1);
+    setenv("WEREF_COMPLETION_MANIFEST", completion_path, 1);
+    setenv("WEREF_METRICS", run_output, 1);
+    setenv("WEREF_TRACE", trace_path, 1);
+    if (job->gesture->duration > 0.0)
+      setenv("WEREF_DURATION", duration, 1);
+    else
+      unsetenv("WEREF_DURATION");
+    if (job->samples > 0)
+      setenv("WEREF_SAMPLES", samples, 1);
+    else
+      unsetenv("WEREF_SAMPLES");
+    if (job->has_quota)
+      setenv("WEREF_QUOTA", quota, 1);
+    else
+      unsetenv("WEREF_QUOTA");
+    if (!freopen(log_path, "w", stdout) || dup2(fileno(stdout), STDERR_FILENO) < 0)
+      _exit(127);
+    execlp(webots, webots, "--batch", "--mode=fast", "--no-rendering", "--stdout", "--stderr", world_path,
+           (char *)NULL);
+    fprintf(stderr, "Error: could not execute '%s'.\n", webots);
+    _exit(127);
+  }
+  setpgid(pid, pid);
+  job->pid = pid;
+  job->status = JOB_RUNNING;
+  clock_gettime(CLOCK_MONOTONIC, &job->start);
+  printf("[slot %d] started %s (pid %d) in %s\n", slot, job->name, (int)pid, run_output);
+  return true;
+}
+
+static void finish_job(Job *job, int status) {
+  job->wall_time = elapsed(&job->start);
+  if (WIFEXITED(status))
+    job->exit_code = WEXITSTATUS(status);
+  else if (WIFSIGNALED(status))
+    job->exit_code = -WTERMSIG(status);
+  if (job->status == JOB_RUNNING)
+    job->status = job->exit_code == 0 ? JOB_COMPLETED : JOB_FAILED;
+  printf("%s %s in %.1f s (exit code %d)\n", job->name,
+         job->status == JOB_COMPLETED ? "completed" : (job->status == JOB_TIMED_OUT ? "timed out" : "failed"),
+         job->wall_time, job->exit_code);
+}
+
+static const char *status_name(JobStatus status) {
+  switch (status) {
+    case JOB_COMPLETED:
+      return "completed";
+    case JOB_FAILED:
+      return "failed";
+    case JOB_TIMED_OUT:
+      return "timed_out";
+    case JOB_SKIPPED:
+      return "skipped";
+    default:
+      return "not_run";
+  }
+}
+
+static bool write_summary(const Job *jobs, int job_count) {
+  char path[PATH_MAX];
+  FILE *file = join_path(path, output_dir, "runner_summary.tsv") ? fopen(path, "w") : NULL;
+  if (!file) {
+    fprintf(stderr, "Error: could not create '%s'.\n", path);
+    return false;
+  }
+  fprintf(file, "job\tworld\tgesture\tstatus\texit_code\twall_time\n");
+  for (int i = 0; i < job_count; i++)
+    fprintf(file, "%s\t%s\t%s\t%s\t%d\t%.1f\n", jobs[i].name, jobs[i].world, jobs[i].gesture_stem,
+            status_name(jobs[i].status), jobs[i].exit_code, jobs[i].wall_time);
+  return fclose(file) == 0;
+}
+
+/**
+ * @brief Samples of 'cell' in the completion manifest.
+ */
+static int cell_samples(const WerefCompletionManifest manifest, const Job *jobs, const Cell *cell, int *runs,
+                        int *frames) {
+  const Job *job = &jobs[cell->job];
+  int samples;
+  *runs = weref_completion_manifest_get(manifest, job->gesture_stem, job->world_stem,
+                                        job->cloth[0] ? job->cloth : NULL,
+                                        cell->presence >= 0 ? presence_labels[cell->presence] : NULL,
+                                        camera_positions[cell->position], &samples, frames);
+  return samples;
+}
+
+/**
+ * @brief Plans the runs of the jobs from the samples their cells miss in the completion manifest. A job whose cells
+ * are complete is skipped. Returns the number of jobs to run, -1 on error.
+ */
+static int plan_jobs(Job *jobs, int job_count, const Cell *cells, int cell_count) {
+  WerefCompletionManifest manifest = weref_completion_manifest_load(completion_path);
+  if (!manifest)
+    return -1;
+  for (int i = 0; i < cell_count; i++) {
+    Job *job = &jobs[cells[i].job];
+    int runs, frames;
+    const int done = cell_samples(manifest, jobs, &cells[i], &runs, &frames);
+    const int missing = cells[i].quota > done ? cells[i].quota - done : 0;
+    if (cells[i].presence < 0)
+      job->samples = missing > job->samples ? missing : job->samples;
+    else {
+      job->has_quota = true;
+      job->quota[cells[i].presence][cells[i].position] = missing;
+    }
+  }
+  weref_completion_manifest_cleanup(manifest);
+
+  int pending_count = 0, total_work = 0;
+  for (int i = 0; i < job_count; i++) {
+    Job *job = &jobs[i];
+    job->work = job->samples;
+    if (job->has_quota) {
+      // a sample fills a cell of each position at once: the largest quota of each presence is drawn
+      for (int presence = 0; presence < 2; presence++) {
+        int need = 0;
+        for (int position = 0; position < 3; position++)
+          need = job->quota[presence][position] > need ? job->quota[presence][position] : need;
+        job->work += need;
+      }
+    }
+    if (job->work <= 0)
+      job->status = JOB_SKIPPED;
+    else
+      pending_count++;
+    total_work += job->work;
+  }
+  printf("%d of %d jobs already complete, %d samples to capture\n", job_count - pending_count, job_count, total_work);
+  return pending_count;
+}
+
+/**
+ * @brief Orders the jobs to run by decreasing samples, so that the longest runs do not start last and keep a single
+ * instance busy at the end of the collection.
+ */
+static int compare_work(const void *a, const void *b) {
+  const Job *job_a = *(const Job *const *)a, *job_b = *(const Job *const *)b;
+  if (job_a->work != job_b->work)
+    return job_b->work - job_a->work;
+  return job_a < job_b ? -1 : 1;
+}
+
+/**
+ * @brief Writes the progress of every cell with a quota, from the completion manifest, to
+ * '<output_dir>/completion_summary.tsv'.
+ */
+static bool write_completion_summary(const Job *jobs, const Cell *cells, int cell_count) {
+  WerefCompletionManifest manifest = weref_completion_manifest_load(completion_path);
+  char path[PATH_MAX];
+  FILE *file = manifest && join_path(path, output_dir, "completion_summary.tsv") ? fopen(path, "w") : NULL;
+  if (!file) {
+    fprintf(stderr, "Error: could not write the completion summary of '%s'.\n", completion_path);
+    weref_completion_manifest_cleanup(manifest);
+    return false;
+  }
+  int complete = 0;
+  fprintf(file, "gesture\tworld\tcloth\tpresence\tposition\truns\tsamples\tframes\tquota\tstatus\n");
+  for (int i = 0; i < cell_count; i++) {
+    const Cell *cell = &cells[i];
+    const Job *job = &jobs[cell->job];
+    int runs, frames;
+    const int samples = cell_samples(manifest, jobs, cell, &runs, &frames);
+    fprintf(file, "%s\t%s\t%s\t%s\t%s\t%d\t%d\t%d\t%d\t%s\n", job->gesture_stem, job->world_stem,
+            job->cloth[0] ? job->cloth : "*", cell->presence >= 0 ? presence_labels[cell->presence] : "*",
+            camera_positions[cell->position], runs, samples, frames, cell->quota,
+            samples >= cell->quota ? "complete" : "incomplete");
+    complete += samples >= cell->quota;
+  }
+  printf("%d of %d cells complete\n", complete, cell_count);
+  weref_completion_manifest_cleanup(manifest);
+  return fclose(file) == 0;
+}
+
+/**
+ * @brief Parses '<file>.bvh[:<duration>]'.
+ */
+static bool parse_gesture(char *text, double default_duration, Gesture *gesture) {
+  char *colon = strchr(text, ':');
+  gesture->duration = default_duration;
+  if (colon) {
+    *colon = '\0';
+    gesture->duration = atof(colon + 1);
+  }
+  gesture->file = text;
+  return ends_with(text, ".bvh") && (colon ? gesture->duration > 0.0 : true);
+}
+
+/**
+ * @brief Reads the motion of a world from the parameter table, the GESTURE of its line. Writes it without its extension
+ * to 'stem' of 128 bytes.
+ */
+static bool read_world_gesture(const char *world_stem, char *stem) {
+  WerefWorldParameters parameters = weref_world_parameters_new();
+  const char *gesture = NULL;
+  if (parameters && weref_world_parameters_read(parameters, parameters_path, world_stem)) {
+    gesture = weref_world_parameters_get(parameters, "GESTURE");
+    if (!gesture || !ends_with(gesture, ".bvh") || strlen(gesture) - 4 >= 128) {
+      fprintf(stderr, "Error: '%s' has no valid GESTURE in '%s'.\n", world_stem, parameters_path);
+      gesture = NULL;
+    }
+  }
+  if (gesture)
+    snprintf(stem, 128, "%.*s", (int)strlen(gesture) - 4, gesture);
+  weref_world_parameters_cleanup(parameters);
+  return gesture != NULL;
+}
+
+/**
+ * @brief Sets the world, gesture, labels and name of a job. Without a gesture, the label is the motion of the world,
+ * which its camera robots write to the completion manifest.
+ */
+static bool init_job(Job *job, const char *world, const Gesture *gesture) {
+  job->gesture = gesture;
+  const int world_length = (int)strlen(world) - (ends_with(world, ".wbt") ? 4 : 0);
+  snprintf(job->world_stem, sizeof(job->world_stem), "%.*s", world_length, world);
+  snprintf(job->world, sizeof(job->world), "%s.wbt", job->world_stem);
+  if (gesture->file)
+    snprintf(job->gesture_stem, sizeof(job->gesture_stem), "%.*s", (int)strlen(gesture->file) - 4, gesture->file);
+  else if (!read_world_gesture(job->world_stem, job->gesture_stem))
+    return false;
+  snprintf(job->name, sizeof(job->name), "%s-%s", job->world_stem, job->gesture_stem);
+  return true;
+}
+
+/**
+ * @brief Reads the quota table at 'path', one cell of the dataset tree per line:
+ *   <gesture> <referee model> <cloth> <background> <presence_robot|presence_norobot> <left|middle|right> <samples>
+ * and makes a job of each gesture x world of its cells, the world file being '<referee model>_<background>.wbt'.
+ * Empty lines and '#' comments are skipped.
+ */
+static bool read_quota_table(const char *path, double default_duration, Gesture *gestures, int *gesture_count,
+                             Job **jobs, int *job_count, Cell **cells, int *cell_count) {
+  static char gesture_files[MAX_GESTURES][128];
+  FILE *file = fopen(path, "r");
+  if (!file) {
+    fprintf(stderr, "Error: could not open '%s'.\n", path);
+    return false;
+  }
+  char line[MAX_LINE_LENGTH];
+  int line_number = 0, job_capacity = 0, cell_capacity = 0;
+  bool success = true;
+  while (success && fgets(line, sizeof(line), file)) {
+    line_number++;
+    char *comment = strchr(line, '#');
+    if (comment)
+      *comment = '\0';
+    char gesture[100], model[64], cloth[32], background[64], presence[32], position[16];
+    int samples;
+    const int n = sscanf(line, "%99s %63s %31s %63s %31s %15s %d", gesture, model, cloth, background, presence,
+                         position, &samples);
+    if (n <= 0)
+      continue;
+    int presence_index = -1, position_index = -1;
+    for (int i = 0; n == 7 && i < 3; i++) {
+      if (i < 2 && strcmp(presence, presence_labels[i]) == 0)
+        presence_index = i;
+      if (strcmp(position, camera_positions[i]) == 0)
+        position_index = i;
+    }
+    if (n != 7 || presence_index < 0 || position_index < 0 || samples < 0) {
+      fprintf(stderr, "Error: %s:%d: expected '<gesture> <referee model> <cloth> <background> "
+                      "<presence_robot|presence_norobot> <left|middle|right> <samples>'.\n",
+              path, line_number);
+      success = false;
+      break;
+    }
+
+    char gesture_file[128], world[136];
+    snprintf(gesture_file, sizeof(gesture_file), "%s.bvh", gesture);
+    snprintf(world, sizeof(world), "%s_%s.wbt", model, background);
+    int g = 0;
+    while (g < *gesture_count && strcmp(gestures[g].file, gesture_file) != 0)
+      g++;
+    if (g == *gesture_count) {
+      if (g == MAX_GESTURES) {
+        fprintf(stderr, "Error: %s has more than %d gestures.\n", path, MAX_GESTURES);
+        success = false;
+        break;
+      }
+      snprintf(gesture_files[g], sizeof(gesture_files[g]), "%s", gesture_file);
+      gestures[g].file = gesture_files[g];
+      gestures[g].duration = default_duration;
+      (*gesture_count)++;
+    }
+
+    int j = 0;
+    while (j < *job_count && (strcmp((*jobs)[j].world, world) != 0 || (*jobs)[j].gesture != &gestures[g]))
+      j++;
+    if (j == *job_count) {
+      if (j == job_capacity) {
+        job_capacity = job_capacity ? 2 * job_capacity : 64;
+        *jobs = realloc(*jobs, job_capacity * sizeof(Job));
+        memset(*jobs + j, 0, (job_capacity - j) * sizeof(Job));
+      }
+      init_job(&(*jobs)[j], world, &gestures[g]);
+      snprintf((*jobs)[j].cloth, sizeof((*jobs)[j].cloth), "%s", cloth);
+      (*job_count)++;
+    } else if (strcmp((*jobs)[j].cloth, cloth) != 0) {
+      // the cloth is a property of the world
+      fprintf(stderr, "Error: %s:%d: %s is listed with the cloths %s and %s.\n", path, line_number, world,
+              (*jobs)[j].cloth, cloth);
+      success = false;
+      break;
+    }
+
+    for (int i = 0; i < *cell_count; i++) {
+      const Cell *cell = &(*cells)[i];
+      if (cell->job == j && cell->presence == presence_index && cell->position == position_index) {
+        fprintf(stderr, "Error: %s:%d: the cell is listed twice.\n", path, line_number);
+        success = false;
+      }
+    }
+    if (*cell_count == cell_capacity) {
+      cell_capacity = cell_capacity ? 2 * cell_capacity : 256;
+      *cells = realloc(*cells, cell_capacity * sizeof(Cell));
+    }
+    const Cell cell = {j, presence_index, position_index, samples};
+    (*cells)[(*cell_count)++] = cell;
+  }
+  fclose(file);
+  if (success && *job_count == 0) {
+    fprintf(stderr, "Error: %s has no cells.\n", path);
+    success = false;
+  }
+  return success;
+}
+
+static void print_usage(const char *command) {
+  printf("Usage: %s [-j <instances>] [-g <gesture.bvh>[:<duration>]]... [-d <duration>] [-p <project_dir>] "
+         "[-n <samples>] [-o <output_dir>] [-s <scratch_dir>] [-w <webots>] [-T <timeout>] [-a] <world.wbt>...\n",
+         command);
+  printf("       %s -q <quota_table> [-j <instances>] [-d <duration>] [-p <project_dir>] [-o <output_dir>] "
+         "[-s <scratch_dir>] [-w <webots>] [-T <timeout>] [-a]\n",
+         command);
+  printf("Options:\n");
+  printf("  -j: number of concurrent Webots instances. Default is one per 4 CPUs.\n");
+  printf("  -g: gesture of the motions folder run in every world, with its simulated duration [s]. Repeatable.\n");
+  printf("      Default is the gesture of each world in the parameter table.\n");
+  printf("  -d: default simulated duration of a run [s]. Default is 30 without -n or -q, no limit with them.\n");
+  printf("  -n: samples of each gesture x world x position cell. A run quits once they are captured, and fails if\n");
+  printf("      it reaches its duration first. Cells already complete in the completion manifest are skipped and\n");
+  printf("      incomplete ones only capture their missing samples.\n");
+  printf("  -q: quota table, the samples of each gesture x referee x cloth x background x presence x position cell,\n");
+  printf("      which gives the gesture x world jobs. Each run captures the samples its cells miss and quits.\n");
+  printf("  -p: project directory, containing the controllers, libraries, motions and worlds. Default is '.'.\n");
+  printf("  -o: output directory, one dataset root per run. Default is 'runs'.\n");
+  printf("  -s: scratch directory of the rendered projects. Default is '<output_dir>/scratch'.\n");
+  printf("  -w: Webots executable. Default is 'webots' from the PATH.\n");
+  printf("  -T: wall-clock timeout of a run [s], after which it is killed. Default is 600.\n");
+  printf("  -a: do not pin the instances to CPUs (only supported on Linux).\n");
+  printf("<world.wbt> is a line of the parameter table, worlds/templates/worlds.txt, with or without extension.\n");
+}
+
+int main(int argc, char **argv) {
+  static Gesture gestures[MAX_GESTURES];
+  char *gesture_args[MAX_GESTURES];
+  int gesture_count = 0;
+  int instance_count = 0;
+  double default_duration = -1.0;
+  const char *quota_path = NULL;
+  const char *project = ".";
+  const char *output = "runs";
+  const char *scratch = NULL;
+  int c;
+  while ((c = getopt(argc, argv, "j:g:d:n:q:p:o:s:w:T:a")) != -1) {
+    switch (c) {
+      case 'j':
+        instance_count = atoi(optarg);
+        break;
+      case 'g':
+        if (gesture_count == MAX_GESTURES) {
+          fprintf(stderr, "Error: more than %d gestures.\n", MAX_GESTURES);
+          return 1;
+        }
+        gesture_args[gesture_count++] = optarg;
+        break;
+      case 'd':
+        default_duration = atof(optarg);
+        if (default_duration <= 0.0) {
+          fprintf(stderr, "Invalid duration `%s'.\n", optarg);
+          return 1;
+        }
+        break;
+      case 'n':
+        target_samples = atoi(optarg);
+        break;
+      case 'q':
+        quota_path = optarg;
+        break;
+      case 'p':
+        project = optarg;
+        break;
+      case 'o':
+        output = optarg;
+        break;
+      case 's':
+        scratch = optarg;
+        break;
+      case 'w':
+        webots = optarg;
+        break;
+      case 'T':
+        timeout = atof(optarg);
+        break;
+      case 'a':
+        pin_cpus = false;
+        break;
+      default:
+        print_usage(argv[0]);
+        return 1;
+    }
+  }
+  if (default_duration < 0.0)
+    default_duration = target_samples > 0 || quota_path ? 0.0 : 30.0;
+  if (quota_path && (gesture_count > 0 || target_samples > 0 || optind < argc)) {
+    fprintf(stderr, "Error: the gestures, worlds and samples come from the quota table with -q.\n");
+    print_usage(argv[0]);
+    return 1;
+  }
+  if (!quota_path && optind == argc) {
+    print_usage(argv[0]);
+    return 1;
+  }
+  for (int i = 0; i < gesture_count; i++) {
+    if (!parse_gesture(gesture_args[i], default_duration, &gestures[i])) {
+      fprintf(stderr, "Invalid gesture `%s'.\n", gesture_args[i]);
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+
+  static char project_path[PATH_MAX];
+  if (!realpath(project, project_path)) {
+    fprintf(stderr, "Error: could not resolve '%s'.\n", project);
+    return 1;
+  }
+  project_dir = project_path;
+  if (!join_path(template_path, project_dir, "worlds/templates/referee_world.wbt.in") ||
+      !join_path(parameters_path, project_dir, "worlds/templates/worlds.txt")) {
+    fprintf(stderr, "Error: the path of '%s' is too long.\n", project_dir);
+    return 1;
+  }
+  if (!make_absolute_dir(output, output_dir))
+    return 1;
+  if (scratch)
+    snprintf(scratch_dir, sizeof(scratch_dir), "%s", scratch);
+  else if (!join_path(scratch_dir, output_dir, "scratch")) {
+    fprintf(stderr, "Error: the path of '%s' is too long.\n", output);
+    return 1;
+  }
+  char scratch_path[PATH_MAX];
+  if (!make_absolute_dir(scratch_dir, scratch_path))
+    return 1;
+  snprintf(scratch_dir, sizeof(scratch_dir), "%s", scratch_path);
+
+  Job *jobs = NULL;
+  Cell *cells = NULL;
+  int job_count = 0, cell_count = 0;
+  if (quota_path) {
+    if (!read_quota_table(quota_path, default_duration, gestures, &gesture_count, &jobs, &job_count, &cells,
+                          &cell_count))
+      return 1;
+  } else {
+    // the gesture x world matrix, gesture major as in the collection scripts
+    const int world_count = argc - optind;
+    job_count = world_count * (gesture_count > 0 ? gesture_count : 1);
+    static Gesture world_gesture = {NULL, 0.0};
+    world_gesture.duration = default_duration;
+    // -n: the same quota for each position, whatever the presence
+    cell_count = target_samples > 0 ? 3 * job_count : 0;
+    jobs = calloc(job_count, sizeof(Job));
+    cells = calloc(cell_count > 0 ? cell_count : 1, sizeof(Cell));
+    if (!jobs || !cells) {
+      fprintf(stderr, "Error: could not allocate %d jobs.\n", job_count);
+      return 1;
+    }
+    for (int i = 0; i < job_count; i++) {
+      const char *world_arg = argv[optind + i % world_count];
+      if (!init_job(&jobs[i], strrchr(world_arg, '/') ? strrchr(world_arg, '/') + 1 : world_arg,
+                    gesture_count > 0 ? &gestures[i / world_count] : &world_gesture))
+        return 1;
+    }
+    for (int i = 0; i < cell_count; i++) {
+      const Cell cell = {i / 3, -1, i % 3, target_samples};
+      cells[i] = cell;
+    }
+  }
+
+  // resumption: only the samples missing from the completion manifest are scheduled
+  if (!join_path(completion_path, output_dir, "completion.tsv")) {
+    fprintf(stderr, "Error: the path of '%s' is too long.\n", output);
+    return 1;
+  }
+  const int pending_count = cell_count > 0 ? plan_jobs(jobs, job_count, cells, cell_count) : job_count;
+  if (pending_count < 0)
+    return 1;
+  Job **queue = malloc(job_count * sizeof(Job *));
+  for (int i = 0; i < job_count; i++)
+    queue[i] = &jobs[i];
+  qsort(queue, job_count, sizeof(Job *), compare_work);
+
+  const long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+  if (instance_count <= 0)
+    instance_count = cpu_count >= 8 ? (int)(cpu_count / 4) : 1;
+  if (instance_count > pending_count)
+    instance_count = pending_count > 0 ? pending_count : 1;
+  if (instance_count > MAX_INSTANCES)
+    instance_count = MAX_INSTANCES;
+  const int cpus_per_instance = cpu_count > instance_count ? (int)(cpu_count / instance_count) : 1;
+  printf("Running %d jobs on %d instances (%d CPUs each), output in %s\n", pending_count, instance_count,
+         cpus_per_instance, output_dir);
+
+  signal(SIGINT, handle_signal);
+  signal(SIGTERM, handle_signal);
+  Job *slots[MAX_INSTANCES] = {NULL};
+  int next = 0, running = 0;
+  while ((next < job_count && !stop_requested) || running > 0) {
+    for (int slot = 0; slot < instance_count && next < job_count && !stop_requested; slot++) {
+      if (slots[slot])
+        continue;
+      Job *job = queue[next++];
+      if (job->status != JOB_PENDING)
+        continue;
+      if (start_job(job, slot, cpus_per_instance)) {
+        slots[slot] = job;
+        running++;
+      } else
+        job->status = JOB_FAILED;
+    }
+
+    int status;
+    const pid_t pid = waitpid(-1, &status, WNOHANG);
+    if (pid > 0) {
+      for (int slot = 0; slot < instance_count; slot++) {
+        if (slots[slot] && slots[slot]->pid == pid) {
+          finish_job(slots[slot], status);
+          slots[slot] = NULL;
+          running--;
+        }
+      }
+      continue;
+    }
+
+    for (int slot = 0; slot < instance_count; slot++) {
+      Job *job = slots[slot];
+      if (job && job->status == JOB_RUNNING && (stop_requested || elapsed(&job->start) > timeout)) {
+        job->status = stop_requested ? JOB_FAILED : JOB_TIMED_OUT;
+        kill(-job->pid, SIGKILL);
+      }
+    }
+    sleep_ms(POLL_INTERVAL_MS);
+  }
+
+  int completed = 0;
+  for (int i = 0; i < job_count; i++)
+    completed += jobs[i].status == JOB_COMPLETED || jobs[i].status == JOB_SKIPPED;
+  printf("%d of %d jobs completed, %d failed or not run\n", completed, job_count, job_count - completed);
+  bool summary_written = write_summary(jobs, job_count);
+  if (cell_count > 0)
+    summary_written = write_completion_summary(jobs, cells, cell_count) && summary_written;
+  free(queue);
+  free(cells);
+  free(jobs);
+  return completed == job_count && summary_written ? 0 : 1;
+}
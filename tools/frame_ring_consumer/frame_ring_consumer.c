@@ -0,0 +1,157 @@
+/*
+ * Description:   Reference consumer of the shared-memory frame ring of the 'nao_soccer_player' controller (-o ring).
+ *                It maps the ring, reads every frame in place and stores it as a PPM image in tar shards, with the
+ *                same label manifest as the controller's 'shard' mode. A training job reads the ring the same way,
+ *                feeding the pixels to its input pipeline instead of the disk.
+ */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <weref/dataset_writer.h>
+#include <weref/frame_ring.h>
+#include <weref/label_manifest.h>
+
+#define POLL_INTERVAL_MS 1
+#define OPEN_INTERVAL_MS 100
+#define MANIFEST_FLUSH_INTERVAL 64
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void handle_signal(int signal) {
+  (void)signal;
+  stop_requested = 1;
+}
+
+static void sleep_ms(int milliseconds) {
+  const struct timespec interval = {milliseconds / 1000, (milliseconds % 1000) * 1000000L};
+  nanosleep(&interval, NULL);
+}
+
+/**
+ * @brief Tells whether the BGRA pixels of a frame fit in the slots of the ring: the dimensions come from the shared
+ * memory, a corrupt or mismatched producer must not make the consumer read past the slot.
+ */
+static bool is_frame_valid(const WerefFrameHeader *frame, size_t max_frame_size) {
+  if (frame->width <= 0 || frame->height <= 0)
+    return false;
+  const unsigned long long size = 4ULL * (unsigned long long)frame->width * (unsigned long long)frame->height;
+  return size <= max_frame_size && size <= frame->size;
+}
+
+/**
+ * @brief Writes a BGRA frame of the ring as a binary PPM image.
+ */
+static bool write_ppm(const char *path, const WerefFrameHeader *frame) {
+  FILE *file = fopen(path, "wb");
+  if (!file) {
+    fprintf(stderr, "Error: could not create '%s'.\n", path);
+    return false;
+  }
+  fprintf(file, "P6\n%d %d\n255\n", frame->width, frame->height);
+  const unsigned char *pixels = weref_frame_ring_data(frame);
+  unsigned char *row = malloc(3 * frame->width);
+  bool success = row != NULL;
+  for (int y = 0; success && y < frame->height; y++) {
+    const unsigned char *bgra = pixels + 4 * frame->width * y;
+    for (int x = 0; x < frame->width; x++) {
+      row[3 * x] = bgra[4 * x + 2];
+      row[3 * x + 1] = bgra[4 * x + 1];
+      row[3 * x + 2] = bgra[4 * x];
+    }
+    success = fwrite(row, 3, frame->width, file) == (size_t)frame->width;
+  }
+  free(row);
+  return fclose(file) == 0 && success;
+}
+
+static void print_usage(const char *command) {
+  printf("Usage: %s -n <ring_name> [-r <output_root>] [-S <shard_size_mb>]\n", command);
+  printf("Options:\n");
+  printf("  -n: name of the ring, printed by the controller, e.g. '/weref_full_time_sophia_..._left'.\n");
+  printf("  -r: dataset root directory. Default is 'images'.\n");
+  printf("  -S: maximum shard size in MB. Default is 256.\n");
+}
+
+int main(int argc, char **argv) {
+  const char *ring_name = NULL;
+  const char *output_root = "images";
+  long shard_size = 256L * 1024 * 1024;
+  int c;
+  while ((c = getopt(argc, argv, "n:r:S:")) != -1) {
+    switch (c) {
+      case 'n':
+        ring_name = optarg;
+        break;
+      case 'r':
+        output_root = optarg;
+        break;
+      case 'S':
+        shard_size = atol(optarg) * 1024 * 1024;
+        break;
+      default:
+        print_usage(argv[0]);
+        return 1;
+    }
+  }
+  if (!ring_name) {
+    fprintf(stderr, "Missing required argument -n.\n");
+    print_usage(argv[0]);
+    return 1;
+  }
+  signal(SIGINT, handle_signal);
+  signal(SIGTERM, handle_signal);
+
+  // the controller creates the ring when it receives its first scene message
+  printf("Waiting for the ring %s\n", ring_name);
+  WerefFrameRing ring = NULL;
+  while (!ring && !stop_requested) {
+    ring = weref_frame_ring_open(ring_name);
+    if (!ring)
+      sleep_ms(OPEN_INTERVAL_MS);
+  }
+  if (!ring)
+    return 0;
+
+  const char *prefix = ring_name[0] == '/' ? ring_name + 1 : ring_name;
+  WerefDatasetWriter writer = weref_dataset_writer_new(WEREF_OUTPUT_SHARD, output_root, prefix, shard_size);
+  if (!writer) {
+    weref_frame_ring_cleanup(ring);
+    return 1;
+  }
+  char manifest_path[1024];
+  snprintf(manifest_path, sizeof(manifest_path), "%s/%s.labels.csv", output_root, prefix);
+  WerefLabelManifest manifest = weref_label_manifest_new(manifest_path, MANIFEST_FLUSH_INTERVAL);
+
+  const size_t max_frame_size = weref_frame_ring_get_max_frame_size(ring);
+  int frame_count = 0;
+  while (!stop_requested) {
+    const WerefFrameHeader *frame = weref_frame_ring_begin_read(ring);
+    if (!frame) {
+      // the producer closes the ring after its last frame: one more read tells whether it is drained
+      if (weref_frame_ring_is_closed(ring) && !weref_frame_ring_begin_read(ring))
+        break;
+      sleep_ms(POLL_INTERVAL_MS);
+      continue;
+    }
+    if (is_frame_valid(frame, max_frame_size)) {
+      const char *path = weref_dataset_writer_begin(writer, frame->label.key, ".ppm");
+      if (path && write_ppm(path, frame) && weref_dataset_writer_commit(writer))
+        weref_label_manifest_append(manifest, &frame->label);
+    } else
+      fprintf(stderr, "Error: skipping a frame of invalid size %dx%d (%u bytes, slots of %zu bytes).\n",
+              frame->width, frame->height, frame->size, max_frame_size);
+    weref_frame_ring_end_read(ring);
+    frame_count++;
+  }
+
+  printf("Read %d frames from %s, %lld dropped by the producer\n", frame_count, ring_name,
+         weref_frame_ring_get_dropped_count(ring));
+  weref_label_manifest_cleanup(manifest);
+  weref_dataset_writer_cleanup(writer);
+  weref_frame_ring_cleanup(ring);
+  return 0;
+}
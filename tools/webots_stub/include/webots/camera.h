@@ -0,0 +1,29 @@
+/*
+ * Description:   Camera API of the Webots controller library, as implemented by the stub runtime. The other entry
+ *                points of the real header are not provided.
+ */
+
+#ifndef WB_CAMERA_H
+#define WB_CAMERA_H
+
+#define WB_USING_C_API
+#include <webots/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void wb_camera_enable(WbDeviceTag tag, int sampling_period);
+void wb_camera_disable(WbDeviceTag tag);
+int wb_camera_get_sampling_period(WbDeviceTag tag);
+const unsigned char *wb_camera_get_image(WbDeviceTag tag);
+int wb_camera_get_width(WbDeviceTag tag);
+int wb_camera_get_height(WbDeviceTag tag);
+double wb_camera_get_fov(WbDeviceTag tag);
+int wb_camera_save_image(WbDeviceTag tag, const char *filename, int quality);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WB_CAMERA_H */
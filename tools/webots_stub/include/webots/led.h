@@ -0,0 +1,23 @@
+/*
+ * Description:   LED API of the Webots controller library, as implemented by the stub runtime. The other entry points
+ *                of the real header are not provided.
+ */
+
+#ifndef WB_LED_H
+#define WB_LED_H
+
+#define WB_USING_C_API
+#include <webots/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void wb_led_set(WbDeviceTag tag, int value);
+int wb_led_get(WbDeviceTag tag);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WB_LED_H */
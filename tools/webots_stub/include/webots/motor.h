@@ -0,0 +1,23 @@
+/*
+ * Description:   Motor API of the Webots controller library, as implemented by the stub runtime. The other entry
+ *                points of the real header are not provided.
+ */
+
+#ifndef WB_MOTOR_H
+#define WB_MOTOR_H
+
+#define WB_USING_C_API
+#include <webots/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void wb_motor_set_position(WbDeviceTag tag, double position);
+void wb_motor_set_velocity(WbDeviceTag tag, double velocity);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WB_MOTOR_H */
@@ -0,0 +1,27 @@
+/*
+ * Description:   Motion file API of the Webots controller library, as implemented by the stub runtime. Motions are
+ *                only checked for existence, playing them does not move any joint.
+ */
+
+#ifndef WBU_MOTION_H
+#define WBU_MOTION_H
+
+#define WB_USING_C_API
+#include <webots/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+WbMotionRef wbu_motion_new(const char *filename);
+void wbu_motion_delete(WbMotionRef motion);
+void wbu_motion_play(WbMotionRef motion);
+void wbu_motion_stop(WbMotionRef motion);
+void wbu_motion_set_loop(WbMotionRef motion, bool loop);
+bool wbu_motion_is_over(WbMotionRef motion);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WBU_MOTION_H */
@@ -0,0 +1,1223 @@
+/*
+ * Description:   Headless stand-in for the Webots controller library (libController), to build and profile the
+ *                controllers on a machine without Webots. A controller linked with it runs alone, in-process:
+ *                - wb_robot_step() advances a simulated clock, and returns -1 after WEBOTS_STUB_DURATION simulated
+ *                  seconds (10 by default, 0 for no limit) or once the supervisor quits the simulation.
+ *                - The supervisor API works on a scene graph parsed from the world file WEBOTS_STUB_WORLD: its nodes,
+ *                  DEF names and literal field values. Proto fields missing from the world read as zero.
+ *                - The controller runs as the robot WEBOTS_STUB_ROBOT (DEF or name), by default the first robot of
+ *                  the world whose controller field is the name of the program.
+ *                - Cameras render a synthetic pattern at their sampling period, saved as PPM images whatever the
+ *                  file extension. Skin devices record the bone poses written to them. Skin bones are the joints
+ *                  of WEBOTS_STUB_SKIN_BVH, by default of the first BVH file in the controllerArgs of the robot.
+ *                - Field writes of the controller can be recorded to WEBOTS_STUB_RECORD, and the writes recorded
+ *                  from other controllers replayed from WEBOTS_STUB_INPUT at their simulated time, e.g. the scene
+ *                  messages of the scene director for a camera robot. One write per line:
+ *                    <time [ms]> <node DEF or name> <field> <s|n|b> <value>
+ *                When the controller calls wb_robot_cleanup(), or exits, the stub reports the number of calls of
+ *                each API function and the wall-clock time the controller spent per step, to stderr or as JSON to
+ *                WEBOTS_STUB_REPORT.
+ */
+
+#define _GNU_SOURCE  // program_invocation_short_name
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <webots/camera.h>
+#include <webots/led.h>
+#include <webots/motor.h>
+#include <webots/robot.h>
+#include <webots/skin.h>
+#include <webots/supervisor.h>
+#include <webots/utils/motion.h>
+
+#define DEFAULT_TIME_STEP 32
+#define DEFAULT_DURATION 10.0
+#define DEFAULT_CAMERA_WIDTH 160  // Nao proto
+#define DEFAULT_CAMERA_HEIGHT 120
+#define DEFAULT_CAMERA_FOV 1.0
+#define MAX_DEVICES 64
+#define MAX_API_FUNCTIONS 128
+#define MAX_TOKEN_LENGTH 1024
+
+struct WbFieldStructPrivate {
+  char *name;
+  WbFieldType type;
+  double values[4];   // SF_BOOL, SF_INT32, SF_FLOAT, SF_VEC2F, SF_VEC3F, SF_ROTATION and SF_COLOR fields
+  char *string;       // SF_STRING fields
+  WbNodeRef *nodes;   // SF_NODE and MF_NODE fields
+  char **strings;     // MF_STRING fields
+  int count;          // items of MF fields
+  WbNodeRef owner;
+  WbFieldRef next;
+};
+
+struct WbNodeStructPrivate {
+  char def[64];
+  char type[64];
+  WbNodeRef parent;
+  WbFieldRef fields;
+  double pose[16];      // returned by wb_supervisor_node_get_pose()
+  double velocity[6];
+  WbNodeRef next;       // all the nodes of the scene
+};
+
+struct WbMotionStructPrivate {
+  bool playing;
+  bool loop;
+};
+
+typedef enum { DEVICE_UNKNOWN, DEVICE_CAMERA, DEVICE_SKIN } DeviceType;
+
+typedef struct Device {
+  char name[64];
+  WbNodeRef node;  // node of the device in the world, NULL for the devices of protos
+  DeviceType type;
+  // camera
+  int sampling_period;  // [ms], 0 if disabled
+  double enable_time;   // [ms]
+  int width, height;
+  unsigned char *image;  // BGRA
+  bool has_image;
+  long long frames;
+  // skin
+  int bone_count;
+  char **bone_names;
+  double (*orientations)[4];
+  double (*positions)[3];
+  long long bone_writes;
+} Device;
+
+typedef struct InputWrite {
+  double time;  // [ms]
+  char *node;
+  char *field;
+  char kind;  // 's': string, 'n': numbers, 'b': boolean
+  char *value;
+} InputWrite;
+
+// Scene
+static WbNodeRef root = NULL;
+static WbNodeRef nodes = NULL;  // every node, newest first
+static WbNodeRef self = NULL;
+static char world_path[4096] = "";
+static char *world_text = NULL;
+static const char *world_cursor = NULL;
+
+// Clock
+static int basic_time_step = DEFAULT_TIME_STEP;
+static double time_ms = 0.0;
+static double duration = DEFAULT_DURATION;
+static bool quit_requested = false;
+static int quit_status = 0;
+
+// Devices, tag i + 1 is devices[i]
+static Device devices[MAX_DEVICES];
+static int device_count = 0;
+
+// Recorded and replayed field writes
+static FILE *record_file = NULL;
+static InputWrite *inputs = NULL;
+static int input_count = 0;
+static int next_input = 0;
+
+// Statistics
+static const char *api_names[MAX_API_FUNCTIONS];
+static long long api_calls[MAX_API_FUNCTIONS];
+static int api_count = 0;
+static double *step_latencies = NULL;  // wall-clock time of the controller in each step [s]
+static int step_count = 0;
+static int step_capacity = 0;
+static struct timespec start_time, step_return_time;
+static bool initialized = false;
+static bool reported = false;
+
+//***********************************//
+//        Utility functions          //
+//***********************************//
+
+static double seconds_between(const struct timespec *start, const struct timespec *end) {
+  return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+static void count_call(int *id, const char *name) {
+  if (*id < 0) {
+    if (api_count == MAX_API_FUNCTIONS)
+      return;
+    api_names[api_count] = name;
+    *id = api_count++;
+  }
+  api_calls[*id]++;
+}
+
+// Counts a call of the enclosing API function
+#define STUB_COUNT()               \
+  do {                             \
+    static int call_id = -1;       \
+    count_call(&call_id, __func__); \
+  } while (0)
+
+static char *duplicate(const char *text) {
+  char *copy = malloc(strlen(text) + 1);
+  strcpy(copy, text);
+  return copy;
+}
+
+// ----------------------------------------------------------
+// Scene graph
+// ----------------------------------------------------------
+
+static WbNodeRef new_node(const char *def, const char *type, WbNodeRef parent) {
+  WbNodeRef node = calloc(1, sizeof(struct WbNodeStructPrivate));
+  snprintf(node->def, sizeof(node->def), "%.63s", def ? def : "");
+  snprintf(node->type, sizeof(node->type), "%.63s", type);
+  node->parent = parent;
+  node->next = nodes;
+  nodes = node;
+  return node;
+}
+
+static WbFieldRef find_field(WbNodeRef node, const char *name) {
+  for (WbFieldRef field = node->fields; field; field = field->next) {
+    if (strcmp(field->name, name) == 0)
+      return field;
+  }
+  return NULL;
+}
+
+// Fields missing from the world, e.g. the default fields of a proto, are added as zero
+static WbFieldRef get_field(WbNodeRef node, const char *name) {
+  WbFieldRef field = find_field(node, name);
+  if (field)
+    return field;
+  field = calloc(1, sizeof(struct WbFieldStructPrivate));
+  field->name = duplicate(name);
+  field->owner = node;
+  field->next = node->fields;
+  node->fields = field;
+  return field;
+}
+
+static const char *field_string(WbNodeRef node, const char *name) {
+  WbFieldRef field = node ? find_field(node, name) : NULL;
+  return field && field->string ? field->string : "";
+}
+
+// DEF name of the node, or its name field, as written in the traces
+static const char *node_id(WbNodeRef node) {
+  if (node->def[0])
+    return node->def;
+  const char *name = field_string(node, "name");
+  return name[0] ? name : node->type;
+}
+
+static WbNodeRef find_node(const char *id) {
+  for (WbNodeRef node = nodes; node; node = node->next) {
+    if (strcmp(node->def, id) == 0 || strcmp(field_string(node, "name"), id) == 0)
+      return node;
+  }
+  return NULL;
+}
+
+static void append_node(WbFieldRef field, WbNodeRef node) {
+  field->nodes = realloc(field->nodes, (field->count + 1) * sizeof(WbNodeRef));
+  field->nodes[field->count++] = node;
+}
+
+// Row-major 4x4 pose of a node relative to the world, from its translation and rotation fields and its parents
+static void compute_pose(WbNodeRef node, double *pose) {
+  double parent_pose[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+  if (node->parent)
+    compute_pose(node->parent, parent_pose);
+  const WbFieldRef translation = find_field(node, "translation");
+  const WbFieldRef rotation = find_field(node, "rotation");
+  const double *t = translation ? translation->values : (const double[4]){0, 0, 0, 0};
+  double axis[3] = {0.0, 0.0, 1.0}, angle = 0.0;
+  if (rotation) {
+    const double norm = sqrt(rotation->values[0] * rotation->values[0] + rotation->values[1] * rotation->values[1] +
+                             rotation->values[2] * rotation->values[2]);
+    if (norm > 0.0) {
+      for (int i = 0; i < 3; i++)
+        axis[i] = rotation->values[i] / norm;
+      angle = rotation->values[3];
+    }
+  }
+  const double c = cos(angle), s = sin(angle), C = 1.0 - c;
+  const double x = axis[0], y = axis[1], z = axis[2];
+  const double local[16] = {x * x * C + c,     x * y * C - z * s, x * z * C + y * s, t[0],
+                            y * x * C + z * s, y * y * C + c,     y * z * C - x * s, t[1],
+                            z * x * C - y * s, z * y * C + x * s, z * z * C + c,     t[2],
+                            0,                 0,                 0,                 1};
+  for (int i = 0; i < 4; i++) {
+    for (int j = 0; j < 4; j++) {
+      pose[4 * i + j] = 0.0;
+      for (int k = 0; k < 4; k++)
+        pose[4 * i + j] += parent_pose[4 * i + k] * local[4 * k + j];
+    }
+  }
+}
+
+// ----------------------------------------------------------
+// World file parser
+// ----------------------------------------------------------
+
+// Reads the next token of the world: a word, a string (without its quotes) or one of '{', '}', '[' and ']'.
+// Returns false at the end of the file.
+static bool next_token(char *token, bool *is_string) {
+  const char *p = world_cursor;
+  while (*p) {
+    if (*p == '#') {
+      while (*p && *p != '\n')
+        p++;
+    } else if (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n' || *p == ',')
+      p++;
+    else
+      break;
+  }
+  *is_string = false;
+  int length = 0;
+  if (!*p) {
+    world_cursor = p;
+    return false;
+  }
+  if (*p == '"') {
+    *is_string = true;
+    for (p++; *p && *p != '"'; p++) {
+      if (*p == '\\' && p[1])
+        p++;
+      if (length < MAX_TOKEN_LENGTH - 1)
+        token[length++] = *p;
+    }
+    if (*p)
+      p++;
+  } else if (strchr("{}[]", *p))
+    token[length++] = *p++;
+  else {
+    while (*p && !strchr(" \t\r\n,{}[]\"#", *p)) {
+      if (length < MAX_TOKEN_LENGTH - 1)
+        token[length++] = *p;
+      p++;
+    }
+  }
+  token[length] = '\0';
+  world_cursor = p;
+  return true;
+}
+
+static bool peek_token(char *token, bool *is_string) {
+  const char *cursor = world_cursor;
+  const bool found = next_token(token, is_string);
+  world_cursor = cursor;
+  return found;
+}
+
+static bool is_number(const char *token) {
+  char *end;
+  strtod(token, &end);
+  return end != token && *end == '\0';
+}
+
+static WbNodeRef parse_node(const char *first, WbNodeRef parent);
+
+// Parses the value of 'field' following its name: a string, a node, a list or up to 4 numbers or booleans
+static void parse_value(WbFieldRef field, WbNodeRef node) {
+  char token[MAX_TOKEN_LENGTH], next[MAX_TOKEN_LENGTH];
+  bool is_string, next_is_string;
+  if (!peek_token(token, &is_string))
+    return;
+  if (is_string) {
+    next_token(token, &is_string);
+    field->type = WB_SF_STRING;
+    field->string = duplicate(token);
+  } else if (strcmp(token, "[") == 0) {
+    next_token(token, &is_string);
+    field->type = WB_MF;
+    while (next_token(token, &is_string) && !(strcmp(token, "]") == 0 && !is_string)) {
+      if (is_string) {
+        field->type = WB_MF_STRING;
+        field->strings = realloc(field->strings, (field->count + 1) * sizeof(char *));
+        field->strings[field->count++] = duplicate(token);
+      } else if (!is_number(token) && strcmp(token, "TRUE") != 0 && strcmp(token, "FALSE") != 0) {
+        WbNodeRef child = parse_node(token, node);
+        if (child) {
+          field->type = WB_MF_NODE;
+          append_node(field, child);
+        }
+      } else
+        field->type = WB_MF_FLOAT;  // the values of other lists are not needed
+    }
+  } else if (strcmp(token, "NULL") == 0) {
+    next_token(token, &is_string);
+    field->type = WB_SF_NODE;
+  } else if (is_number(token) || strcmp(token, "TRUE") == 0 || strcmp(token, "FALSE") == 0) {
+    int n = 0;
+    while (n < 4 && peek_token(next, &next_is_string) && !next_is_string &&
+           (is_number(next) || strcmp(next, "TRUE") == 0 || strcmp(next, "FALSE") == 0)) {
+      next_token(next, &next_is_string);
+      field->values[n++] = strcmp(next, "TRUE") == 0 ? 1.0 : (strcmp(next, "FALSE") == 0 ? 0.0 : atof(next));
+    }
+    const WbFieldType types[5] = {WB_NO_FIELD, WB_SF_FLOAT, WB_SF_VEC2F, WB_SF_VEC3F, WB_SF_ROTATION};
+    field->type = strcmp(token, "TRUE") == 0 || strcmp(token, "FALSE") == 0 ? WB_SF_BOOL : types[n];
+  } else {
+    next_token(token, &is_string);
+    WbNodeRef child = parse_node(token, node);
+    if (child) {
+      field->type = WB_SF_NODE;
+      append_node(field, child);
+    }
+  }
+}
+
+// Parses a node starting with the token 'first': 'DEF <name> <type> { ... }', 'USE <name>' or '<type> { ... }'
+static WbNodeRef parse_node(const char *first, WbNodeRef parent) {
+  char token[MAX_TOKEN_LENGTH], def[MAX_TOKEN_LENGTH] = "";
+  bool is_string;
+  if (strcmp(first, "USE") == 0)
+    return next_token(token, &is_string) ? find_node(token) : NULL;
+  snprintf(token, sizeof(token), "%s", first);
+  if (strcmp(token, "DEF") == 0 && !(next_token(def, &is_string) && next_token(token, &is_string)))
+    return NULL;
+  char type[MAX_TOKEN_LENGTH];
+  snprintf(type, sizeof(type), "%s", token);
+  if (!next_token(token, &is_string) || strcmp(token, "{") != 0)
+    return NULL;
+  WbNodeRef node = new_node(def, type, parent);
+  while (next_token(token, &is_string) && !(strcmp(token, "}") == 0 && !is_string)) {
+    WbFieldRef field = get_field(node, token);
+    parse_value(field, node);
+  }
+  return node;
+}
+
+static bool load_world(const char *path) {
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    fprintf(stderr, "Error: webots_stub: could not open the world '%s'.\n", path);
+    return false;
+  }
+  fseek(file, 0, SEEK_END);
+  const long size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  world_text = malloc(size + 1);
+  const bool success = fread(world_text, 1, size, file) == (size_t)size;
+  fclose(file);
+  world_text[success ? size : 0] = '\0';
+
+  WbFieldRef children = get_field(root, "children");
+  children->type = WB_MF_NODE;
+  world_cursor = world_text;
+  char token[MAX_TOKEN_LENGTH];
+  bool is_string;
+  while (next_token(token, &is_string)) {
+    if (strcmp(token, "EXTERNPROTO") == 0 || strcmp(token, "IMPORTABLE") == 0)
+      continue;
+    if (is_string)
+      continue;
+    WbNodeRef node = parse_node(token, NULL);
+    if (node)
+      append_node(children, node);
+  }
+  free(world_text);
+  world_text = NULL;
+  return true;
+}
+
+// ----------------------------------------------------------
+// Field writes
+// ----------------------------------------------------------
+
+static void write_escaped(FILE *file, const char *text) {
+  for (; *text; text++) {
+    if (*text == '\\')
+      fputs("\\\\", file);
+    else if (*text == '\t')
+      fputs("\\t", file);
+    else if (*text == '\n')
+      fputs("\\n", file);
+    else
+      fputc(*text, file);
+  }
+}
+
+static void unescape(char *text) {
+  char *out = text;
+  for (const char *in = text; *in; in++) {
+    if (*in == '\\' && in[1]) {
+      in++;
+      *out++ = *in == 't' ? '\t' : (*in == 'n' ? '\n' : *in);
+    } else
+      *out++ = *in;
+  }
+  *out = '\0';
+}
+
+static void record_write(WbFieldRef field, int count) {
+  if (!record_file)
+    return;
+  fprintf(record_file, "%.0f\t", time_ms);
+  write_escaped(record_file, node_id(field->owner));
+  fprintf(record_file, "\t%s\t", field->name);
+  if (field->type == WB_SF_STRING) {
+    fputs("s\t", record_file);
+    write_escaped(record_file, field->string);
+  } else if (field->type == WB_SF_BOOL)
+    fprintf(record_file, "b\t%d", field->values[0] != 0.0);
+  else {
+    fputs("n\t", record_file);
+    for (int i = 0; i < count; i++)
+      fprintf(record_file, i ? " %.17g" : "%.17g", field->values[i]);
+  }
+  fputc('\n', record_file);
+}
+
+static void set_string(WbFieldRef field, const char *value) {
+  field->type = WB_SF_STRING;
+  free(field->string);
+  field->string = duplicate(value);
+}
+
+static bool load_inputs(const char *path) {
+  FILE *file = fopen(path, "r");
+  if (!file) {
+    fprintf(stderr, "Error: webots_stub: could not open the input '%s'.\n", path);
+    return false;
+  }
+  char *line = NULL;
+  size_t capacity = 0;
+  int line_number = 0;
+  while (getline(&line, &capacity, file) > 0) {
+    line_number++;
+    line[strcspn(line, "\r\n")] = '\0';
+    char *fields[5];
+    char *p = line;
+    int n = 0;
+    while (n < 5 && p) {
+      fields[n++] = p;
+      p = n < 5 ? strchr(p, '\t') : NULL;
+      if (p)
+        *p++ = '\0';
+    }
+    if (n != 5 || !strchr("snb", fields[3][0])) {
+      fprintf(stderr, "Warning: webots_stub: %s:%d is not a field write.\n", path, line_number);
+      continue;
+    }
+    inputs = realloc(inputs, (input_count + 1) * sizeof(InputWrite));
+    InputWrite *input = &inputs[input_count++];
+    input->time = atof(fields[0]);
+    unescape(fields[1]);
+    unescape(fields[4]);
+    input->node = duplicate(fields[1]);
+    input->field = duplicate(fields[2]);
+    input->kind = fields[3][0];
+    input->value = duplicate(fields[4]);
+  }
+  free(line);
+  fclose(file);
+  return true;
+}
+
+// Applies the replayed writes up to the current time, which are sorted by time
+static void apply_inputs() {
+  for (; next_input < input_count && inputs[next_input].time <= time_ms; next_input++) {
+    const InputWrite *input = &inputs[next_input];
+    WbNodeRef node = find_node(input->node);
+    if (!node)
+      continue;
+    WbFieldRef field = get_field(node, input->field);
+    if (input->kind == 's')
+      set_string(field, input->value);
+    else if (input->kind == 'b') {
+      field->type = WB_SF_BOOL;
+      field->values[0] = atoi(input->value) != 0;
+    } else {
+      char *p = input->value;
+      for (int i = 0; i < 4; i++)
+        field->values[i] = strtod(p, &p);
+    }
+  }
+}
+
+// ----------------------------------------------------------
+// Devices
+// ----------------------------------------------------------
+
+static Device *get_device(WbDeviceTag tag, DeviceType type) {
+  if (tag == 0 || tag > device_count)
+    return NULL;
+  Device *device = &devices[tag - 1];
+  if (device->type == DEVICE_UNKNOWN)
+    device->type = type;
+  return device->type == type ? device : NULL;
+}
+
+// Finds the node named 'name' among the descendants of 'node'
+static WbNodeRef find_descendant(WbNodeRef node, const char *name) {
+  for (WbNodeRef other = nodes; other; other = other->next) {
+    if (strcmp(field_string(other, "name"), name) != 0)
+      continue;
+    for (WbNodeRef ancestor = other->parent; ancestor; ancestor = ancestor->parent) {
+      if (ancestor == node)
+        return other;
+    }
+  }
+  return NULL;
+}
+
+static Device *get_camera(WbDeviceTag tag) {
+  Device *camera = get_device(tag, DEVICE_CAMERA);
+  if (camera && camera->width == 0) {
+    // the camera resolution fields of the Nao proto
+    const WbFieldRef width = self ? find_field(self, "cameraWidth") : NULL;
+    const WbFieldRef height = self ? find_field(self, "cameraHeight") : NULL;
+    camera->width = width && width->values[0] > 0 ? (int)width->values[0] : DEFAULT_CAMERA_WIDTH;
+    camera->height = height && height->values[0] > 0 ? (int)height->values[0] : DEFAULT_CAMERA_HEIGHT;
+    camera->image = malloc(4 * camera->width * camera->height);
+  }
+  return camera;
+}
+
+// Renders a synthetic BGRA pattern that moves with every frame
+static void render_camera(Device *camera) {
+  unsigned char *pixel = camera->image;
+  const int shift = (int)camera->frames;
+  for (int y = 0; y < camera->height; y++) {
+    for (int x = 0; x < camera->width; x++) {
+      pixel[0] = (unsigned char)(x + shift);
+      pixel[1] = (unsigned char)(y + shift);
+      pixel[2] = (unsigned char)((x ^ y) + shift);
+      pixel[3] = 255;
+      pixel += 4;
+    }
+  }
+  camera->has_image = true;
+  camera->frames++;
+}
+
+static void read_bone_names(Device *skin) {
+  const char *path = getenv("WEBOTS_STUB_SKIN_BVH");
+  WbFieldRef args = self ? find_field(self, "controllerArgs") : NULL;
+  for (int i = 0; !path && args && i < args->count; i++) {
+    const size_t length = strlen(args->strings[i]);
+    if (length > 4 && strcmp(args->strings[i] + length - 4, ".bvh") == 0)
+      path = args->strings[i];
+  }
+  FILE *file = path ? fopen(path, "r") : NULL;
+  if (!file) {
+    fprintf(stderr, "Warning: webots_stub: the Skin '%s' has no bones, set WEBOTS_STUB_SKIN_BVH.\n", skin->name);
+    return;
+  }
+  char line[1024], keyword[64], name[256];
+  while (fgets(line, sizeof(line), file) && strncmp(line, "MOTION", 6) != 0) {
+    if (sscanf(line, "%63s %255s", keyword, name) != 2 || (strcmp(keyword, "ROOT") != 0 && strcmp(keyword, "JOINT")))
+      continue;
+    skin->bone_names = realloc(skin->bone_names, (skin->bone_count + 1) * sizeof(char *));
+    skin->bone_names[skin->bone_count++] = duplicate(name);
+  }
+  fclose(file);
+  skin->orientations = calloc(skin->bone_count, sizeof(*skin->orientations));
+  skin->positions = calloc(skin->bone_count, sizeof(*skin->positions));
+  for (int i = 0; i < skin->bone_count; i++)
+    skin->orientations[i][1] = 1.0;  // identity: rotation of 0 around y
+}
+
+static Device *get_skin(WbDeviceTag tag) {
+  Device *skin = get_device(tag, DEVICE_SKIN);
+  if (skin && !skin->bone_names)
+    read_bone_names(skin);
+  return skin;
+}
+
+// ----------------------------------------------------------
+// Report
+// ----------------------------------------------------------
+
+static int compare_doubles(const void *a, const void *b) {
+  const double x = *(const double *)a, y = *(const double *)b;
+  return x < y ? -1 : x > y;
+}
+
+static double percentile(const double *sorted, int count, double p) {
+  return count > 0 ? sorted[(int)(p * (count - 1) + 0.5)] : 0.0;
+}
+
+static void report() {
+  if (reported || !initialized)
+    return;
+  reported = true;
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  const double wall_time = seconds_between(&start_time, &now);
+  double *sorted = malloc((step_count > 0 ? step_count : 1) * sizeof(double));
+  double total = 0.0;
+  for (int i = 0; i < step_count; i++) {
+    sorted[i] = step_latencies[i];
+    total += step_latencies[i];
+  }
+  qsort(sorted, step_count, sizeof(double), compare_doubles);
+  const double mean = step_count > 0 ? total / step_count : 0.0;
+  long long calls = 0, frames = 0, bone_writes = 0;
+  for (int i = 0; i < api_count; i++)
+    calls += api_calls[i];
+  for (int i = 0; i < device_count; i++) {
+    frames += devices[i].frames;
+    bone_writes += devices[i].bone_writes;
+  }
+
+  const char *path = getenv("WEBOTS_STUB_REPORT");
+  FILE *file = path && path[0] ? fopen(path, "w") : NULL;
+  if (path && path[0] && !file)
+    fprintf(stderr, "Error: webots_stub: could not write the report '%s'.\n", path);
+  if (file) {
+    fprintf(file, "{\n  \"controller\": \"%s\",\n  \"robot\": \"%s\",\n", program_invocation_short_name,
+            self ? node_id(self) : "");
+    fprintf(file, "  \"steps\": %d,\n  \"simulated_time\": %.3f,\n  \"wall_time\": %.6f,\n", step_count,
+            time_ms / 1000.0, wall_time);
+    fprintf(file, "  \"step_latency\": {\"mean\": %.9f, \"p50\": %.9f, \"p90\": %.9f, \"p99\": %.9f, \"max\": %.9f},\n",
+            mean, percentile(sorted, step_count, 0.5), percentile(sorted, step_count, 0.9),
+            percentile(sorted, step_count, 0.99), step_count > 0 ? sorted[step_count - 1] : 0.0);
+    fprintf(file, "  \"camera_frames\": %lld,\n  \"skin_bone_writes\": %lld,\n  \"api_calls_total\": %lld,\n", frames,
+            bone_writes, calls);
+    fprintf(file, "  \"api_calls\": {");
+    for (int i = 0; i < api_count; i++)
+      fprintf(file, "%s\n    \"%s\": %lld", i ? "," : "", api_names[i], api_calls[i]);
+    fprintf(file, "\n  }\n}\n");
+    fclose(file);
+  } else {
+    fprintf(stderr, "webots_stub: %d steps, %.2f simulated s in %.2f s of wall-clock time\n", step_count,
+            time_ms / 1000.0, wall_time);
+    fprintf(stderr, "webots_stub: controller time per step [us]: mean %.1f, p50 %.1f, p99 %.1f, max %.1f\n",
+            1e6 * mean, 1e6 * percentile(sorted, step_count, 0.5), 1e6 * percentile(sorted, step_count, 0.99),
+            1e6 * (step_count > 0 ? sorted[step_count - 1] : 0.0));
+    fprintf(stderr, "webots_stub: %lld API calls (%.1f per step), %lld camera frames, %lld skin bone writes\n", calls,
+            step_count > 0 ? (double)calls / step_count : 0.0, frames, bone_writes);
+    for (int i = 0; i < api_count; i++)
+      fprintf(stderr, "webots_stub:   %-40s %lld\n", api_names[i], api_calls[i]);
+  }
+  free(sorted);
+}
+
+//***********************************//
+//          API functions            //
+//***********************************//
+
+// ----------------------------------------------------------
+// Robot
+// ----------------------------------------------------------
+
+int wb_robot_init() {
+  if (initialized)
+    return 1;
+  STUB_COUNT();
+  initialized = true;
+  clock_gettime(CLOCK_MONOTONIC, &start_time);
+  atexit(report);
+  root = new_node(NULL, "Group", NULL);
+
+  const char *world = getenv("WEBOTS_STUB_WORLD");
+  if (world && world[0]) {
+    if (!realpath(world, world_path))
+      snprintf(world_path, sizeof(world_path), "%s", world);
+    load_world(world_path);
+  }
+  for (WbNodeRef node = nodes; node; node = node->next) {
+    if (strcmp(node->type, "WorldInfo") == 0 && find_field(node, "basicTimeStep"))
+      basic_time_step = (int)find_field(node, "basicTimeStep")->values[0];
+  }
+
+  const char *robot = getenv("WEBOTS_STUB_ROBOT");
+  if (robot && robot[0])
+    self = find_node(robot);
+  else {
+    // the first robot of the world with this controller, 'nodes' being in reverse order
+    for (WbNodeRef node = nodes; node; node = node->next) {
+      if (strcmp(field_string(node, "controller"), program_invocation_short_name) == 0)
+        self = node;
+    }
+  }
+  if (!self) {
+    fprintf(stderr, "Warning: webots_stub: no robot %s in the world, running in an empty robot.\n",
+            robot && robot[0] ? robot : program_invocation_short_name);
+    self = new_node(NULL, "Robot", NULL);
+    set_string(get_field(self, "name"), robot && robot[0] ? robot : program_invocation_short_name);
+    append_node(get_field(root, "children"), self);
+  }
+
+  if (getenv("WEBOTS_STUB_DURATION"))
+    duration = atof(getenv("WEBOTS_STUB_DURATION"));
+  const char *record = getenv("WEBOTS_STUB_RECORD");
+  if (record && record[0] && !(record_file = fopen(record, "w")))
+    fprintf(stderr, "Error: webots_stub: could not create '%s'.\n", record);
+  const char *input = getenv("WEBOTS_STUB_INPUT");
+  if (input && input[0])
+    load_inputs(input);
+  apply_inputs();
+
+  fprintf(stderr, "webots_stub: %s runs %s, time step %d ms, %s\n", node_id(self), program_invocation_short_name,
+          basic_time_step, world_path[0] ? world_path : "no world");
+  clock_gettime(CLOCK_MONOTONIC, &step_return_time);
+  return 1;
+}
+
+int wb_robot_step(int step_duration) {
+  STUB_COUNT();
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  if (step_count == step_capacity) {
+    step_capacity = step_capacity ? 2 * step_capacity : 4096;
+    step_latencies = realloc(step_latencies, step_capacity * sizeof(double));
+  }
+  step_latencies[step_count++] = seconds_between(&step_return_time, &now);
+
+  if (quit_requested || (duration > 0.0 && time_ms >= duration * 1000.0)) {
+    if (record_file)
+      fflush(record_file);
+    clock_gettime(CLOCK_MONOTONIC, &step_return_time);
+    return -1;
+  }
+  time_ms += step_duration;
+  apply_inputs();
+  for (int i = 0; i < device_count; i++) {
+    Device *camera = &devices[i];
+    if (camera->type == DEVICE_CAMERA && camera->sampling_period > 0 &&
+        fmod(time_ms - camera->enable_time, camera->sampling_period) == 0.0)
+      render_camera(camera);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &step_return_time);
+  return 0;
+}
+
+void wb_robot_cleanup() {
+  STUB_COUNT();
+  if (record_file) {
+    fclose(record_file);
+    record_file = NULL;
+  }
+  report();
+  // Webots quits with the status of wb_supervisor_simulation_quit()
+  if (quit_requested)
+    exit(quit_status);
+}
+
+double wb_robot_get_time() {
+  STUB_COUNT();
+  return time_ms / 1000.0;
+}
+
+double wb_robot_get_basic_time_step() {
+  STUB_COUNT();
+  return basic_time_step;
+}
+
+const char *wb_robot_get_name() {
+  STUB_COUNT();
+  return field_string(self, "name");
+}
+
+const char *wb_robot_get_world_path() {
+  STUB_COUNT();
+  return world_path;
+}
+
+const char *wb_robot_get_custom_data() {
+  STUB_COUNT();
+  return field_string(self, "customData");
+}
+
+void wb_robot_set_custom_data(const char *data) {
+  STUB_COUNT();
+  WbFieldRef field = get_field(self, "customData");
+  set_string(field, data);
+  record_write(field, 0);
+}
+
+WbDeviceTag wb_robot_get_device(const char *name) {
+  STUB_COUNT();
+  for (int i = 0; i < device_count; i++) {
+    if (strcmp(devices[i].name, name) == 0)
+      return i + 1;
+  }
+  if (device_count == MAX_DEVICES)
+    return 0;
+  Device *device = &devices[device_count++];
+  memset(device, 0, sizeof(Device));
+  snprintf(device->name, sizeof(device->name), "%s", name);
+  device->node = find_descendant(self, name);
+  return device_count;
+}
+
+// ----------------------------------------------------------
+// Supervisor
+// ----------------------------------------------------------
+
+void wb_supervisor_simulation_quit(int status) {
+  STUB_COUNT();
+  quit_requested = true;
+  quit_status = status;
+}
+
+WbNodeRef wb_supervisor_node_get_root() {
+  STUB_COUNT();
+  return root;
+}
+
+WbNodeRef wb_supervisor_node_get_self() {
+  STUB_COUNT();
+  return self;
+}
+
+WbNodeRef wb_supervisor_node_get_from_def(const char *def) {
+  STUB_COUNT();
+  for (WbNodeRef node = nodes; node; node = node->next) {
+    if (strcmp(node->def, def) == 0)
+      return node;
+  }
+  return NULL;
+}
+
+WbNodeRef wb_supervisor_node_get_from_proto_def(WbNodeRef node, const char *def) {
+  STUB_COUNT();
+  // the internal nodes of protos are not in the world
+  (void)node;
+  (void)def;
+  return NULL;
+}
+
+// The devices of protos are not in the world, they are attached to the robot
+WbNodeRef wb_supervisor_node_get_from_device(WbDeviceTag tag) {
+  STUB_COUNT();
+  if (tag == 0 || tag > device_count)
+    return NULL;
+  return devices[tag - 1].node ? devices[tag - 1].node : self;
+}
+
+WbFieldRef wb_supervisor_node_get_field(WbNodeRef node, const char *field_name) {
+  STUB_COUNT();
+  return node ? get_field(node, field_name) : NULL;
+}
+
+const double *wb_supervisor_node_get_pose(WbNodeRef node, WbNodeRef from_node) {
+  STUB_COUNT();
+  if (!node)
+    return NULL;
+  compute_pose(node, node->pose);
+  if (from_node) {
+    // pose in the frame of 'from_node': inverse of its rigid transform times the pose
+    double from[16], relative[16];
+    compute_pose(from_node, from);
+    for (int i = 0; i < 3; i++) {
+      for (int j = 0; j < 4; j++) {
+        relative[4 * i + j] = 0.0;
+        for (int k = 0; k < 3; k++)
+          relative[4 * i + j] += from[4 * k + i] * (node->pose[4 * k + j] - (j == 3 ? from[4 * k + 3] : 0.0));
+      }
+    }
+    memcpy(node->pose, relative, 12 * sizeof(double));
+  }
+  return node->pose;
+}
+
+void wb_supervisor_node_set_velocity(WbNodeRef node, const double velocity[6]) {
+  STUB_COUNT();
+  if (node)
+    memcpy(node->velocity, velocity, sizeof(node->velocity));
+}
+
+void wb_supervisor_node_set_joint_position(WbNodeRef node, double position, int index) {
+  STUB_COUNT();
+  (void)node;
+  (void)position;
+  (void)index;
+}
+
+int wb_supervisor_field_get_count(WbFieldRef field) {
+  STUB_COUNT();
+  return field && (field->type & WB_MF) ? field->count : -1;
+}
+
+WbNodeRef wb_supervisor_field_get_mf_node(WbFieldRef field, int index) {
+  STUB_COUNT();
+  if (!field || field->type != WB_MF_NODE)
+    return NULL;
+  if (index < 0)
+    index += field->count;
+  return index >= 0 && index < field->count ? field->nodes[index] : NULL;
+}
+
+WbNodeRef wb_supervisor_field_get_sf_node(WbFieldRef field) {
+  STUB_COUNT();
+  return field && field->type == WB_SF_NODE && field->count > 0 ? field->nodes[0] : NULL;
+}
+
+bool wb_supervisor_field_get_sf_bool(WbFieldRef field) {
+  STUB_COUNT();
+  return field && field->values[0] != 0.0;
+}
+
+int wb_supervisor_field_get_sf_int32(WbFieldRef field) {
+  STUB_COUNT();
+  return field ? (int)field->values[0] : 0;
+}
+
+double wb_supervisor_field_get_sf_float(WbFieldRef field) {
+  STUB_COUNT();
+  return field ? field->values[0] : 0.0;
+}
+
+const double *wb_supervisor_field_get_sf_vec3f(WbFieldRef field) {
+  STUB_COUNT();
+  return field ? field->values : NULL;
+}
+
+const double *wb_supervisor_field_get_sf_rotation(WbFieldRef field) {
+  STUB_COUNT();
+  return field ? field->values : NULL;
+}
+
+const char *wb_supervisor_field_get_sf_string(WbFieldRef field) {
+  STUB_COUNT();
+  return field && field->string ? field->string : "";
+}
+
+void wb_supervisor_field_set_sf_bool(WbFieldRef field, bool value) {
+  STUB_COUNT();
+  if (!field)
+    return;
+  field->type = WB_SF_BOOL;
+  field->values[0] = value ? 1.0 : 0.0;
+  record_write(field, 1);
+}
+
+void wb_supervisor_field_set_sf_int32(WbFieldRef field, int value) {
+  STUB_COUNT();
+  if (!field)
+    return;
+  field->type = WB_SF_INT32;
+  field->values[0] = value;
+  record_write(field, 1);
+}
+
+void wb_supervisor_field_set_sf_float(WbFieldRef field, double value) {
+  STUB_COUNT();
+  if (!field)
+    return;
+  field->type = WB_SF_FLOAT;
+  field->values[0] = value;
+  record_write(field, 1);
+}
+
+void wb_supervisor_field_set_sf_vec3f(WbFieldRef field, const double values[3]) {
+  STUB_COUNT();
+  if (!field)
+    return;
+  field->type = WB_SF_VEC3F;
+  memcpy(field->values, values, 3 * sizeof(double));
+  record_write(field, 3);
+}
+
+void wb_supervisor_field_set_sf_rotation(WbFieldRef field, const double values[4]) {
+  STUB_COUNT();
+  if (!field)
+    return;
+  field->type = WB_SF_ROTATION;
+  memcpy(field->values, values, 4 * sizeof(double));
+  record_write(field, 4);
+}
+
+void wb_supervisor_field_set_sf_string(WbFieldRef field, const char *value) {
+  STUB_COUNT();
+  if (!field)
+    return;
+  set_string(field, value);
+  record_write(field, 0);
+}
+
+// ----------------------------------------------------------
+// Camera
+// ----------------------------------------------------------
+
+void wb_camera_enable(WbDeviceTag tag, int sampling_period) {
+  STUB_COUNT();
+  Device *camera = get_camera(tag);
+  if (!camera)
+    return;
+  camera->sampling_period = sampling_period;
+  camera->enable_time = time_ms;
+}
+
+void wb_camera_disable(WbDeviceTag tag) {
+  STUB_COUNT();
+  Device *camera = get_camera(tag);
+  if (!camera)
+    return;
+  camera->sampling_period = 0;
+  camera->has_image = false;
+}
+
+int wb_camera_get_sampling_period(WbDeviceTag tag) {
+  STUB_COUNT();
+  const Device *camera = get_camera(tag);
+  return camera ? camera->sampling_period : 0;
+}
+
+const unsigned char *wb_camera_get_image(WbDeviceTag tag) {
+  STUB_COUNT();
+  const Device *camera = get_camera(tag);
+  return camera && camera->sampling_period > 0 && camera->has_image ? camera->image : NULL;
+}
+
+int wb_camera_get_width(WbDeviceTag tag) {
+  STUB_COUNT();
+  const Device *camera = get_camera(tag);
+  return camera ? camera->width : 0;
+}
+
+int wb_camera_get_height(WbDeviceTag tag) {
+  STUB_COUNT();
+  const Device *camera = get_camera(tag);
+  return camera ? camera->height : 0;
+}
+
+double wb_camera_get_fov(WbDeviceTag tag) {
+  STUB_COUNT();
+  return get_camera(tag) ? DEFAULT_CAMERA_FOV : NAN;
+}
+
+// Images are written as binary PPM whatever the extension of the file, for the cost of the file writes
+int wb_camera_save_image(WbDeviceTag tag, const char *filename, int quality) {
+  STUB_COUNT();
+  (void)quality;
+  const Device *camera = get_camera(tag);
+  if (!camera || !camera->has_image)
+    return -1;
+  FILE *file = fopen(filename, "wb");
+  if (!file)
+    return -1;
+  fprintf(file, "P6\n%d %d\n255\n", camera->width, camera->height);
+  for (int i = 0; i < camera->width * camera->height; i++) {
+    const unsigned char rgb[3] = {camera->image[4 * i + 2], camera->image[4 * i + 1], camera->image[4 * i]};
+    fwrite(rgb, 1, 3, file);
+  }
+  return fclose(file) == 0 ? 0 : -1;
+}
+
+// ----------------------------------------------------------
+// Skin
+// ----------------------------------------------------------
+
+int wb_skin_get_bone_count(WbDeviceTag tag) {
+  STUB_COUNT();
+  const Device *skin = get_skin(tag);
+  return skin ? skin->bone_count : 0;
+}
+
+const char *wb_skin_get_bone_name(WbDeviceTag tag, int index) {
+  STUB_COUNT();
+  const Device *skin = get_skin(tag);
+  return skin && index >= 0 && index < skin->bone_count ? skin->bone_names[index] : NULL;
+}
+
+// The bones have no hierarchy: their absolute and relative poses are the same
+const double *wb_skin_get_bone_orientation(WbDeviceTag tag, int index, bool absolute) {
+  STUB_COUNT();
+  (void)absolute;
+  const Device *skin = get_skin(tag);
+  return skin && index >= 0 && index < skin->bone_count ? skin->orientations[index] : NULL;
+}
+
+const double *wb_skin_get_bone_position(WbDeviceTag tag, int index, bool absolute) {
+  STUB_COUNT();
+  (void)absolute;
+  const Device *skin = get_skin(tag);
+  return skin && index >= 0 && index < skin->bone_count ? skin->positions[index] : NULL;
+}
+
+void wb_skin_set_bone_orientation(WbDeviceTag tag, int index, const double orientation[4], bool absolute) {
+  STUB_COUNT();
+  (void)absolute;
+  Device *skin = get_skin(tag);
+  if (!skin || index < 0 || index >= skin->bone_count)
+    return;
+  memcpy(skin->orientations[index], orientation, 4 * sizeof(double));
+  skin->bone_writes++;
+}
+
+void wb_skin_set_bone_position(WbDeviceTag tag, int index, const double position[3], bool absolute) {
+  STUB_COUNT();
+  (void)absolute;
+  Device *skin = get_skin(tag);
+  if (!skin || index < 0 || index >= skin->bone_count)
+    return;
+  memcpy(skin->positions[index], position, 3 * sizeof(double));
+  skin->bone_writes++;
+}
+
+// ----------------------------------------------------------
+// LED, motor and motion
+// ----------------------------------------------------------
+
+void wb_led_set(WbDeviceTag tag, int value) {
+  STUB_COUNT();
+  (void)tag;
+  (void)value;
+}
+
+int wb_led_get(WbDeviceTag tag) {
+  STUB_COUNT();
+  (void)tag;
+  return 0;
+}
+
+void wb_motor_set_position(WbDeviceTag tag, double position) {
+  STUB_COUNT();
+  (void)tag;
+  (void)position;
+}
+
+void wb_motor_set_velocity(WbDeviceTag tag, double velocity) {
+  STUB_COUNT();
+  (void)tag;
+  (void)velocity;
+}
+
+WbMotionRef wbu_motion_new(const char *filename) {
+  STUB_COUNT();
+  FILE *file = fopen(filename, "r");
+  if (!file) {
+    fprintf(stderr, "Error: webots_stub: could not open the motion '%s'.\n", filename);
+    return NULL;
+  }
+  fclose(file);
+  return calloc(1, sizeof(struct WbMotionStructPrivate));
+}
+
+void wbu_motion_delete(WbMotionRef motion) {
+  STUB_COUNT();
+  free(motion);
+}
+
+void wbu_motion_play(WbMotionRef motion) {
+  STUB_COUNT();
+  if (motion)
+    motion->playing = true;
+}
+
+void wbu_motion_stop(WbMotionRef motion) {
+  STUB_COUNT();
+  if (motion)
+    motion->playing = false;
+}
+
+void wbu_motion_set_loop(WbMotionRef motion, bool loop) {
+  STUB_COUNT();
+  if (motion)
+    motion->loop = loop;
+}
+
+bool wbu_motion_is_over(WbMotionRef motion) {
+  STUB_COUNT();
+  return !motion || !motion->playing || !motion->loop;
+}
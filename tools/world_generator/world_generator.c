@@ -0,0 +1,110 @@
+/*
+ * Description:   Renders a concrete world file from the world template and a parameter set, instead of editing the
+ *                tracked world files in place. The parameters of a world come from its line of the parameter table,
+ *                overridden by 'NAME=value' arguments. The rendered world is placed in a scratch project named by
+ *                the FNV-1a hash of its content, which links the controllers, libraries, motions and world resources
+ *                of the real project: an identical configuration reuses the same project, and any number of runs
+ *                can load their own configuration at the same time. The path of the world file is printed on the
+ *                standard output, e.g. for 'webots --batch "$(world_generator ...)"'. The rendering and the scratch
+ *                projects are those of weref_util, shared with the collection runner.
+ */
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <weref/world_template.h>
+
+// Writes '<dir>/<name>' to 'path' of PATH_MAX bytes. Returns false if it does not fit.
+static bool join_path(char *path, const char *dir, const char *name) {
+  return snprintf(path, PATH_MAX, "%s/%s", dir, name) < PATH_MAX;
+}
+
+static void print_usage(const char *command) {
+  printf("Usage: %s [-P <project_dir>] [-t <template>] [-p <parameters>] [-o <scratch_dir>] <world> "
+         "[<NAME>=<value>...]\n",
+         command);
+  printf("Options:\n");
+  printf("  -P: project directory, containing the controllers, libraries, motions and worlds. Default is '.'.\n");
+  printf("  -t: world template. Default is '<project_dir>/worlds/templates/referee_world.wbt.in'.\n");
+  printf("  -p: parameter table. Default is '<project_dir>/worlds/templates/worlds.txt'.\n");
+  printf("  -o: directory of the rendered projects. Default is '$TMPDIR/weref_worlds'.\n");
+  printf("<world> is a line of the parameter table and the name of the rendered world file.\n");
+  printf("<NAME>=<value> overrides a parameter, e.g. 'GESTURE=full_time.bvh'.\n");
+}
+
+int main(int argc, char **argv) {
+  const char *project = ".";
+  const char *template_path = NULL;
+  const char *parameters_path = NULL;
+  const char *scratch = NULL;
+  int c;
+  while ((c = getopt(argc, argv, "P:t:p:o:")) != -1) {
+    switch (c) {
+      case 'P':
+        project = optarg;
+        break;
+      case 't':
+        template_path = optarg;
+        break;
+      case 'p':
+        parameters_path = optarg;
+        break;
+      case 'o':
+        scratch = optarg;
+        break;
+      default:
+        print_usage(argv[0]);
+        return 1;
+    }
+  }
+  if (optind == argc) {
+    print_usage(argv[0]);
+    return 1;
+  }
+  const char *world = argv[optind];
+
+  char project_dir[PATH_MAX], default_template[PATH_MAX], default_parameters[PATH_MAX], default_scratch[PATH_MAX];
+  if (!realpath(project, project_dir)) {
+    fprintf(stderr, "Error: could not resolve '%s'.\n", project);
+    return 1;
+  }
+  if (!join_path(default_template, project_dir, "worlds/templates/referee_world.wbt.in") ||
+      !join_path(default_parameters, project_dir, "worlds/templates/worlds.txt") ||
+      !join_path(default_scratch, getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp", "weref_worlds")) {
+    fprintf(stderr, "Error: the path of '%s' is too long.\n", project_dir);
+    return 1;
+  }
+
+  WerefWorldParameters parameters = weref_world_parameters_new();
+  if (!parameters || !weref_world_parameters_read(parameters, parameters_path ? parameters_path : default_parameters,
+                                                  world)) {
+    weref_world_parameters_cleanup(parameters);
+    return 1;
+  }
+  for (int i = optind + 1; i < argc; i++) {
+    const char *equal = strchr(argv[i], '=');
+    if (!equal || !weref_world_parameters_set(parameters, argv[i], equal - argv[i], equal + 1)) {
+      fprintf(stderr, "Invalid parameter `%s'.\n", argv[i]);
+      print_usage(argv[0]);
+      weref_world_parameters_cleanup(parameters);
+      return 1;
+    }
+  }
+  char *text = weref_world_template_render(template_path ? template_path : default_template, parameters);
+  weref_world_parameters_cleanup(parameters);
+  if (!text)
+    return 1;
+
+  char world_file[PATH_MAX], world_path[PATH_MAX];
+  snprintf(world_file, sizeof(world_file), "%s.wbt", world);
+  const bool created = weref_world_project_create(scratch ? scratch : default_scratch, project_dir, world_file, text,
+                                                  world_path);
+  free(text);
+  if (!created)
+    return 1;
+  printf("%s\n", world_path);
+  return 0;
+}